@@ -0,0 +1,18 @@
+#include "bench-utils.h"
+
+#include <string>
+
+#include "sgf.h"
+
+Game positionAfter(unsigned move_number)
+{
+    const std::string sgf{
+        "(;FF[4]GM[40]CA[UTF-8]SZ[30];B[po];W[qo];B[qn];W[ro];B[rn];W[pn];"
+        "B[so];W[rp];B[sp];W[oo];B[pp];W[sn];B[rq];W[qq];B[qp."
+        "qprqspsornqnpoppqp];W[rr];B[sr];W[tr];B[qr];W[rs];B[ss];W[rt];B[pq."
+        "pqqrrqqppppq];W[st];B[ts];W[us];B[tt];W[ut];B[tu];W[to];B[tn];W[sm];B["
+        "ur];W[vr];B[tq.tqurtsttsssrrqsptq];W[un];B[tm];W[um];B[tl])"};
+    SgfParser parser(sgf);
+    auto seq = parser.parseMainVar();
+    return Game(SgfSequence(seq.begin(), seq.begin() + move_number + 1), 1000);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "game.h"
+
+// position of a real 30x30 game after move_number moves (at most 39)
+Game positionAfter(unsigned move_number);
@@ -0,0 +1,211 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "bench-utils.h"
+#include "dfs.h"
+#include "game.h"
+#include "patterns.h"
+#include "safety.h"
+#include "utils.h"
+
+namespace
+{
+
+constexpr int playerO = 1;
+
+// the move made after positionAfter(38)
+constexpr const char* next_move = "tl";
+
+void setRate(benchmark::State& state, const char* name, int64_t per_iteration)
+{
+    state.counters[name] = benchmark::Counter(
+        state.iterations() * per_iteration, benchmark::Counter::kIsRate);
+}
+
+void BM_copyGame(benchmark::State& state)
+{
+    const Game game = positionAfter(39);
+    for (auto _ : state)
+    {
+        Game copy(game);
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+// Mutating primitives work on a fresh copy in each iteration, the copy is not
+// timed (pausing costs a few hundred ns, see BM_copyGame for the copy itself).
+void BM_placeDot(benchmark::State& state)
+{
+    const Game game = positionAfter(38);
+    const pti ind = coord.sgfToPti(next_move);
+    const int who = game.whoNowMoves();
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        Game copy(game);
+        state.ResumeTiming();
+        copy.placeDot(coord.x[ind], coord.y[ind], who);
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+void BM_makeMove(benchmark::State& state)
+{
+    const Game game = positionAfter(38);
+    const Move move =
+        game.extractSgfMove(next_move, game.whoNowMoves()).first;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        Game copy(game);
+        state.ResumeTiming();
+        copy.makeMove(move);
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+void BM_randomPlayout(benchmark::State& state)
+{
+    const Game game = positionAfter(39);
+    int seed = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        Game copy(game);
+        copy.seedRandomEngine(++seed);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(copy.randomPlayout());
+    }
+}
+
+void BM_findEnclosure(benchmark::State& state)
+{
+    Game game = constructGameFromSgfWithIsometry(
+        constructSgfFromGameBoard("......."
+                                  "...o..."
+                                  "..oxo.."
+                                  "...o..."
+                                  "......."
+                                  "......."
+                                  "......."),
+        0);
+    const pti point = coord.sgfToPti("dc");
+    if (game.findEnclosure(point, SimpleGame::MASK_DOT, playerO).isEmpty())
+        state.SkipWithError("no enclosure");
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            game.findEnclosure(point, SimpleGame::MASK_DOT, playerO));
+}
+
+void BM_findNonSimpleEnclosure(benchmark::State& state)
+{
+    Game game = constructGameFromSgfWithIsometry(
+        constructSgfFromGameBoard("......."
+                                  "..ooo.."
+                                  ".o.x.o."
+                                  ".ox.xo."
+                                  ".o...o."
+                                  "..ooo.."
+                                  "......."),
+        0);
+    const pti point = coord.sgfToPti("dc");
+    if (game.findNonSimpleEnclosure(point, SimpleGame::MASK_DOT, playerO)
+            .isEmpty())
+        state.SkipWithError("no enclosure");
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            game.findNonSimpleEnclosure(point, SimpleGame::MASK_DOT, playerO));
+}
+
+void BM_countTerritory(benchmark::State& state)
+{
+    const Game game = positionAfter(39);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(game.countTerritory(game.whoNowMoves()));
+}
+
+void BM_countTerritory_simple(benchmark::State& state)
+{
+    const Game game = positionAfter(39);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(
+            game.countTerritory_simple(game.whoNowMoves()));
+}
+
+void BM_checkLadder(benchmark::State& state)
+{
+    const Game game = constructGameFromSgfWithIsometry(
+        constructSgfFromGameBoard("...x..."
+                                  "..xo..."
+                                  "..x...."
+                                  "......."
+                                  "..o..o."
+                                  ".ox...."
+                                  "..oo..."),
+        0);
+    const pti where = coord.sgfToPti("df");
+    for (auto _ : state) benchmark::DoNotOptimize(game.checkLadder(2, where));
+}
+
+// args: 0 -- all margins, 1 -- only the margins touching the last move
+void BM_safetyUpdateAfterMove(benchmark::State& state)
+{
+    const Game game = positionAfter(39);
+    const SimpleGame& sg = game.getSimpleGame();
+    Safety safety;
+    safety.init(&sg);
+    const pti last = coord.sgfToPti(next_move);
+    const int what_to_update =
+        state.range(0) ? safety.getUpdateValueForMarginsContaining(last)
+                       : safety.getUpdateValueForAllMargins();
+    for (auto _ : state)
+    {
+        safety.updateAfterMove(&sg, what_to_update, last);
+        benchmark::DoNotOptimize(safety.getMoveValues().data());
+    }
+}
+
+void BM_dfsAP(benchmark::State& state)
+{
+    const Game game = positionAfter(39);
+    OnePlayerDfs dfs;
+    dfs.player = state.range(0);
+    for (auto _ : state)
+    {
+        dfs.AP(game.getSimpleGame(), coord.first, coord.last);
+        benchmark::DoNotOptimize(dfs.aps.data());
+    }
+}
+
+// all empty points of the board with a possible pattern
+void BM_pattern3GetValue(benchmark::State& state)
+{
+    const Game game = positionAfter(39);
+    std::vector<pattern3_t> patterns;
+    for (pti i = coord.first; i <= coord.last; ++i)
+        if (coord.dist[i] >= 0 and not game.isDotAt(i) and
+            Pattern3::isPatternPossible(game.readPattern3_at(i)))
+            patterns.push_back(game.readPattern3_at(i));
+    for (auto _ : state)
+        for (const auto p : patterns)
+            benchmark::DoNotOptimize(global::patt3.getValue(p, playerO));
+    setRate(state, "points/s", patterns.size());
+}
+
+}  // namespace
+
+BENCHMARK(BM_copyGame);
+BENCHMARK(BM_placeDot);
+BENCHMARK(BM_makeMove);
+BENCHMARK(BM_randomPlayout)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_findEnclosure);
+BENCHMARK(BM_findNonSimpleEnclosure);
+BENCHMARK(BM_countTerritory)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_countTerritory_simple)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_checkLadder);
+BENCHMARK(BM_safetyUpdateAfterMove)->Arg(0)->Arg(1);
+// arg: player
+BENCHMARK(BM_dfsAP)->Arg(1)->Arg(2);
+BENCHMARK(BM_pattern3GetValue);
@@ -0,0 +1,243 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "bench-utils.h"
+#include "cnn_input.h"
+#include "game.h"
+
+namespace
+{
+
+void encode(benchmark::State& state, cnn_input::Layout layout)
+{
+    const int planes = state.range(0);
+    const unsigned isometry = state.range(1);
+    const Game game = positionAfter(39);
+    std::vector<float> buffer(planes * coord.wlkx * coord.wlky);
+    for (auto _ : state)
+    {
+        cnn_input::encodePlanes(game, planes, buffer.data(), isometry, layout);
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["positions/s"] =
+        benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+void BM_encodePlanesFirst(benchmark::State& state)
+{
+    encode(state, cnn_input::Layout::PlanesFirst);
+}
+
+void BM_encodePlanesLast(benchmark::State& state)
+{
+    encode(state, cnn_input::Layout::PlanesLast);
+}
+
+// alternates between two consecutive positions, as CNN queries of one
+// search thread usually do; the baseline for any incremental encoding
+void BM_encodeAlternating(benchmark::State& state)
+{
+    const int planes = state.range(0);
+    const Game games[2] = {positionAfter(38), positionAfter(39)};
+    std::vector<float> buffer(planes * coord.wlkx * coord.wlky);
+    int which = 0;
+    for (auto _ : state)
+    {
+        cnn_input::encodePlanes(games[which], planes, buffer.data());
+        which ^= 1;
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["positions/s"] =
+        benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+// The incremental encoding that was measured against the full one and not
+// adopted: the rows of the board arrays that the planes come from are kept,
+// and only the rows that differ from the last position (or all of them, if
+// the player to move differs) are encoded again. The safety plane and the
+// threat planes do not follow the rows and are always encoded. Planes
+// first, without isometries.
+class RowCachedEncoder
+{
+   public:
+    explicit RowCachedEncoder(int planes) : planes{planes} {}
+    void encode(const Game& game, float* out);
+
+   private:
+    std::vector<const std::vector<pti>*> rowSources(const Game& game) const;
+    void encodeRow(const Game& game, int me, int x, float* out) const;
+
+    int planes;
+    int last_me{0};
+    std::vector<pti> kept;  // the rows of rowSources() of the last position
+};
+
+std::vector<const std::vector<pti>*> RowCachedEncoder::rowSources(
+    const Game& game) const
+{
+    std::vector<const std::vector<pti>*> res{&game.getSimpleGame().worm};
+    for (const auto& thr : game.threats)
+    {
+        res.push_back(&thr.is_in_terr);
+        res.push_back(&thr.is_in_encl);
+        if (planes > 7) res.push_back(&thr.is_in_border);
+        if (planes > 10)
+        {
+            res.push_back(&thr.is_in_2m_encl);
+            res.push_back(&thr.is_in_2m_miai);
+        }
+    }
+    return res;
+}
+
+void RowCachedEncoder::encodeRow(const Game& game, int me, int x,
+                                 float* out) const
+{
+    using cnn_input::detail::fillRow;
+    namespace detail = cnn_input::detail;
+    const int wy = coord.wlky;
+    const int plane_size = coord.wlkx * wy;
+    const pti first = coord.ind(x, 0);
+    auto plane = [out, plane_size, x, wy](int k)
+    { return out + k * plane_size + x * wy; };
+    auto rowOf = [first](const auto& v) { return v.data() + first; };
+    const pti* worm = rowOf(game.getSimpleGame().worm);
+    const AllThreats& thr_me = game.threats[me - 1];
+    const AllThreats& thr_opp = game.threats[2 - me];
+    fillRow(plane(0), 1, wy, detail::dotIs(worm, 0));
+    fillRow(plane(1), 1, wy, detail::dotIs(worm, me));
+    fillRow(plane(2), 1, wy, detail::dotIs(worm, 3 - me));
+    fillRow(plane(3), 1, wy, detail::isPositive(rowOf(thr_me.is_in_terr)));
+    fillRow(plane(4), 1, wy, detail::isPositive(rowOf(thr_opp.is_in_terr)));
+    fillRow(plane(5), 1, wy, detail::clipHalf(rowOf(thr_me.is_in_encl)));
+    fillRow(plane(6), 1, wy, detail::clipHalf(rowOf(thr_opp.is_in_encl)));
+    if (planes > 7)
+    {
+        fillRow(plane(7), 1, wy, detail::clipHalf(rowOf(thr_me.is_in_border)));
+        fillRow(plane(8), 1, wy,
+                detail::clipHalf(rowOf(thr_opp.is_in_border)));
+    }
+    if (planes > 10)
+    {
+        const auto* dist = rowOf(coord.dist);
+        fillRow(plane(10), 1, wy,
+                [dist](int y) { return dist[y] == 1 ? 1.0f : 0.0f; });
+        fillRow(plane(11), 1, wy, [](int) { return 1.0f; });
+        fillRow(plane(16), 1, wy,
+                detail::isPositive(rowOf(thr_me.is_in_2m_encl)));
+        fillRow(plane(17), 1, wy,
+                detail::isPositive(rowOf(thr_opp.is_in_2m_encl)));
+        const pti* miai_me = rowOf(thr_me.is_in_2m_miai);
+        const pti* miai_opp = rowOf(thr_opp.is_in_2m_miai);
+        fillRow(plane(18), 1, wy,
+                [miai_me](int y) { return miai_me[y] > 1 ? 1.0f : 0.0f; });
+        fillRow(plane(19), 1, wy,
+                [miai_opp](int y) { return miai_opp[y] > 1 ? 1.0f : 0.0f; });
+    }
+}
+
+void RowCachedEncoder::encode(const Game& game, float* out)
+{
+    const int wx = coord.wlkx;
+    const int wy = coord.wlky;
+    const int plane_size = wx * wy;
+    const int me = game.whoNowMoves();
+    const auto sources = rowSources(game);
+    const std::size_t row_size = sources.size() * wy;
+    const bool all_rows = kept.empty() or me != last_me;
+    kept.resize(row_size * wx);
+    last_me = me;
+    const SimpleGame& sg = game.getSimpleGame();
+    for (int x = 0; x < wx; ++x)
+    {
+        const pti first = coord.ind(x, 0);
+        bool changed = all_rows;
+        for (std::size_t k = 0; k < sources.size(); ++k)
+        {
+            const pti* now = sources[k]->data() + first;
+            pti* old = kept.data() + x * row_size + k * wy;
+            if (not std::equal(now, now + wy, old))
+            {
+                std::copy(now, now + wy, old);
+                changed = true;
+            }
+        }
+        if (changed) encodeRow(game, me, x, out);
+        if (planes > 7)
+            cnn_input::detail::fillRow(
+                out + 9 * plane_size + x * wy, 1, wy,
+                [&sg, first](int y) {
+                    return std::min(sg.getTotalSafetyOf(first + y), 2.0f) *
+                           0.5f;
+                });
+    }
+    if (planes > 12)
+    {
+        std::fill_n(out + 12 * plane_size, 4 * plane_size, 0.0f);
+        auto at = [out, plane_size](int k, pti p) -> float&
+        { return out[k * plane_size + coord.x[p] * coord.wlky + coord.y[p]]; };
+        for (int player = 0; player < 2; ++player)
+        {
+            const bool mine = (player + 1 == me);
+            for (auto& t : game.threats[player].threats2m)
+                if (t.min_win2 && t.isSafe())
+                    at(mine ? 14 : 15, t.where0) =
+                        1.0f - std::pow(0.75f, t.min_win2);
+            for (auto& t : game.threats[player].threats)
+                if (t.where && t.singular_dots)
+                    at(mine ? 12 : 13, t.where) =
+                        1.0f - std::pow(0.75f, t.singular_dots);
+        }
+    }
+}
+
+// as BM_encodeAlternating (or for one position, if the second argument is
+// 0), with RowCachedEncoder
+void BM_encodeIncremental(benchmark::State& state)
+{
+    const int planes = state.range(0);
+    const bool alternate = state.range(1) != 0;
+    const Game games[2] = {positionAfter(38), positionAfter(39)};
+    std::vector<float> buffer(planes * coord.wlkx * coord.wlky);
+    RowCachedEncoder encoder(planes);
+    // the same planes as the full encoding, after a change of position
+    std::vector<float> full(buffer.size());
+    for (const int k : {0, 1, 0})
+    {
+        encoder.encode(games[k], buffer.data());
+        cnn_input::encodePlanes(games[k], planes, full.data());
+        if (buffer != full)
+        {
+            state.SkipWithError("the incremental encoding differs");
+            return;
+        }
+    }
+    int which = 0;
+    for (auto _ : state)
+    {
+        encoder.encode(games[which], buffer.data());
+        if (alternate) which ^= 1;
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["positions/s"] =
+        benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+// args: planes, isometry
+BENCHMARK(BM_encodePlanesFirst)
+    ->Args({7, 0})
+    ->Args({10, 0})
+    ->Args({20, 0})
+    ->Args({20, 5});
+BENCHMARK(BM_encodePlanesLast)->Args({20, 0});
+BENCHMARK(BM_encodeAlternating)->Arg(10)->Arg(20);
+// args: planes, whether the positions alternate
+BENCHMARK(BM_encodeIncremental)->Args({20, 1})->Args({7, 0})->Args({20, 0});
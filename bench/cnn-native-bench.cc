@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "batch_norm.h"
+#include "cnn_native.h"
+
+namespace
+{
+
+constexpr int planes = 20;
+constexpr int board = 20;
+
+// hidden 3x3 convolutions with relu and a 1x1 one for the policy and the
+// value, with random weights and BatchNorms
+struct RandomNet
+{
+    std::vector<NativeCnn::Layer> layers;
+    std::vector<BatchNorm> norms;
+
+    RandomNet(int channels, int hidden)
+    {
+        std::mt19937 engine(1);
+        std::uniform_real_distribution<float> dist(-0.1f, 0.1f);
+        std::uniform_real_distribution<float> positive(0.5f, 1.5f);
+        int inch = planes;
+        for (int i = 0; i <= hidden; ++i)
+        {
+            NativeCnn::Layer layer;
+            layer.out_channels = (i < hidden) ? channels : 2;
+            layer.size = (i < hidden) ? 3 : 1;
+            layer.relu = (i < hidden);
+            layer.weights.resize(layer.out_channels * inch * layer.size *
+                                 layer.size);
+            layer.bias.resize(layer.out_channels);
+            for (auto& w : layer.weights) w = dist(engine);
+            BatchNorm bn;
+            for (int c = 0; c < layer.out_channels; ++c)
+            {
+                bn.weight.push_back(positive(engine));
+                bn.bias.push_back(dist(engine));
+                bn.running_mean.push_back(dist(engine));
+                bn.running_var.push_back(positive(engine));
+            }
+            layers.push_back(std::move(layer));
+            norms.push_back(std::move(bn));
+            inch = channels;
+        }
+    }
+};
+
+// Forward pass of one position. With the first argument 0, the BatchNorms
+// are not folded and run as a net that keeps them would: one more pass over
+// the output of every layer, here over a buffer of the same size.
+void BM_nativeForward(benchmark::State& state)
+{
+    const bool fold = state.range(0);
+    const RandomNet net(state.range(1), state.range(2));
+    auto layers = net.layers;
+    for (std::size_t i = 0; i < layers.size(); ++i)
+        if (fold)
+            foldBatchNorm(layers[i].weights, layers[i].bias, net.norms[i]);
+    NativeCnn cnn;
+    cnn.setLayers(planes, layers, true);
+    std::vector<std::vector<float>> scale, shift;
+    for (const auto& bn : net.norms)
+    {
+        scale.emplace_back();
+        shift.emplace_back();
+        for (std::size_t c = 0; c < bn.weight.size(); ++c)
+        {
+            scale.back().push_back(bn.weight[c] /
+                                   std::sqrt(bn.running_var[c] + bn.eps));
+            shift.back().push_back(bn.bias[c] -
+                                   bn.running_mean[c] * scale.back()[c]);
+        }
+    }
+    std::vector<float> activations(state.range(1) * board * board);
+    std::vector<float> input(planes * board * board);
+    std::mt19937 engine(2);
+    std::bernoulli_distribution stone(0.3);
+    for (auto& v : input) v = stone(engine);
+    std::vector<float> output(board * board + 1);
+    for (auto _ : state)
+    {
+        cnn.get_data(input.data(), board, planes, board, output.data());
+        if (not fold)
+            for (std::size_t i = 0; i < layers.size(); ++i)
+                for (std::size_t c = 0; c < scale[i].size(); ++c)
+                {
+                    float* a = activations.data() + c * board * board;
+                    for (int p = 0; p < board * board; ++p)
+                        a[p] = a[p] * scale[i][c] + shift[i][c];
+                }
+        benchmark::DoNotOptimize(output.data());
+        benchmark::DoNotOptimize(activations.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["positions/s"] =
+        benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+// args: fold, channels, hidden layers
+BENCHMARK(BM_nativeForward)
+    ->Args({0, 32, 6})
+    ->Args({1, 32, 6})
+    ->Args({0, 64, 10})
+    ->Args({1, 64, 10})
+    ->Unit(benchmark::kMicrosecond);
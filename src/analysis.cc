@@ -0,0 +1,180 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file analysis.cc -- statistics of the root
+during the search, for spectators and analysis tools.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "analysis.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+
+#include "game.h"
+#include "report.h"
+
+namespace analysis
+{
+namespace
+{
+int fd{-1};
+int interval_ms{200};
+unsigned top_n{5};
+std::function<void(const std::string &)> callback;
+int callback_interval_ms{200};
+}  // namespace
+
+std::vector<std::string> bestContinuation(const Treenode *node, unsigned depth)
+{
+    std::vector<std::string> moves;
+    for (; depth > 0; --depth)
+    {
+        node = node->getBestChild();
+        if (node == nullptr) break;
+        moves.push_back(coord.indToSgf(node->move.ind));
+    }
+    return moves;
+}
+
+std::vector<MoveInfo> snapshot(const Treenode &node, unsigned top_n,
+                               unsigned pv_depth)
+{
+    struct Stats
+    {
+        const Treenode *child;
+        int32_t visits;
+        float value;
+    };
+    std::vector<Stats> stats;
+    const Treenode *child = node.children;
+    for (; child != nullptr; ++child)
+    {
+        const int32_t playouts = child->t.playouts;
+        const float value_sum = child->t.value_sum;
+        const int32_t visits = playouts - child->prior.playouts;
+        if (visits > 0)
+            stats.push_back({child, visits, value_sum / playouts});
+        if (child->isLast()) break;
+    }
+    const auto n = std::min<std::size_t>(top_n, stats.size());
+    std::partial_sort(stats.begin(), stats.begin() + n, stats.end(),
+                      [](const Stats &a, const Stats &b)
+                      { return a.visits > b.visits; });
+    std::vector<MoveInfo> moves;
+    moves.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        MoveInfo info;
+        info.move = coord.indToSgf(stats[i].child->move.ind);
+        info.visits = stats[i].visits;
+        info.value = stats[i].value;
+        info.prior = stats[i].child->cnn_prob;
+        if (pv_depth > 0)
+        {
+            info.pv = bestContinuation(stats[i].child, pv_depth - 1);
+            info.pv.insert(info.pv.begin(), info.move);
+        }
+        moves.push_back(std::move(info));
+    }
+    return moves;
+}
+
+std::string toJson(const std::vector<MoveInfo> &moves)
+{
+    std::string json = "[";
+    for (const auto &m : moves)
+    {
+        if (json.size() > 1) json += ", ";
+        json += report::JsonObject()
+                    .add("move", m.move)
+                    .add("visits", m.visits)
+                    .add("value", m.value)
+                    .add("prior", m.prior)
+                    .add("pv", m.pv)
+                    .str();
+    }
+    return json + "]";
+}
+
+void configure(const std::string &config_file)
+{
+    std::ifstream config(config_file);
+    int new_fd = -1;
+    if (not(config >> new_fd)) return;
+    config >> interval_ms >> top_n;
+    interval_ms = std::max(interval_ms, 1);
+    if (fcntl(new_fd, F_GETFD) == -1)
+    {
+        std::cerr << "Analysis turned off: file descriptor " << new_fd
+                  << " from " << config_file << " is not open" << std::endl;
+        return;
+    }
+    fd = new_fd;
+    // a reader that went away must not kill the program
+    std::signal(SIGPIPE, SIG_IGN);
+    std::cerr << "Analysis every " << interval_ms << " ms to fd " << fd
+              << std::endl;
+}
+
+void setCallback(std::function<void(const std::string &)> new_callback,
+                 int new_interval_ms)
+{
+    callback = std::move(new_callback);
+    callback_interval_ms = std::max(new_interval_ms, 1);
+}
+
+bool isEnabled() { return fd >= 0 or callback; }
+
+int intervalMs() { return callback ? callback_interval_ms : interval_ms; }
+
+unsigned topN() { return top_n; }
+
+void publish(const std::string &line)
+{
+    if (callback)
+    {
+        callback(line);
+        return;
+    }
+    if (fd < 0) return;
+    const std::string text = line + "\n";
+    for (std::size_t done = 0; done < text.size();)
+    {
+        const auto n = ::write(fd, text.data() + done, text.size() - done);
+        if (n < 0 and errno == EINTR) continue;
+        if (n <= 0)
+        {
+            // the reader is gone; do not slow down the search any more
+            std::cerr << "Analysis turned off: writing to fd " << fd
+                      << " failed" << std::endl;
+            fd = -1;
+            return;
+        }
+        done += n;
+    }
+}
+
+}  // namespace analysis
@@ -0,0 +1,69 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file analysis.h -- statistics of the root
+during the search, for spectators and analysis tools.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct Treenode;
+
+// Live analysis: while findBestMoveMT searches, the main thread writes every
+// interval_ms a line of JSON with the best moves at the root to a file
+// descriptor given in analysis.config ("fd interval_ms top_n", e.g. "3 200 5").
+// The tree is only read: each child is read once into a snapshot, which is
+// sorted, so the search threads are not disturbed.
+namespace analysis
+{
+struct MoveInfo
+{
+    std::string move;  // sgf coordinates
+    int32_t visits{0};
+    float value{0.0f};  // for the player making the move, in [0, 1]
+    float prior{-1.0f};  // CNN probability, negative if none
+    std::vector<std::string> pv;  // starting with move
+};
+
+// moves (in sgf coordinates) of the best continuation below node
+std::vector<std::string> bestContinuation(const Treenode *node,
+                                          unsigned depth);
+// at most top_n children of node with visits, the most visited first
+std::vector<MoveInfo> snapshot(const Treenode &node, unsigned top_n,
+                               unsigned pv_depth);
+std::string toJson(const std::vector<MoveInfo> &moves);
+
+// reads the config file, if it exists, and checks the file descriptor
+void configure(const std::string &config_file);
+// Instead of the file descriptor, the lines go to callback, called by the
+// thread running the search; an empty callback turns it off again.
+void setCallback(std::function<void(const std::string &)> callback,
+                 int interval_ms);
+bool isEnabled();
+int intervalMs();
+unsigned topN();
+// writes the line (and a newline) to the file descriptor
+void publish(const std::string &line);
+}  // namespace analysis
@@ -0,0 +1,62 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file batch_norm.h -- folding of BatchNorm
+into convolutions. Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at)
+protonmail (dot) com
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "mcnn.h"
+
+// BatchNorm2d in eval mode, per channel:
+//   y = (x - running_mean) * weight / sqrt(running_var + eps) + bias
+struct BatchNorm
+{
+    std::vector<float> weight{};
+    std::vector<float> bias{};
+    std::vector<float> running_mean{};
+    std::vector<float> running_var{};
+    float eps{1e-5f};
+};
+
+// Folds bn into the convolution before it (and before its relu), given by
+// weights [out][in][size][size] and bias [out], so that the convolution alone
+// computes both. Without libtorch, so that it is tested with the rest.
+inline void foldBatchNorm(std::vector<float>& weights, std::vector<float>& bias,
+                          const BatchNorm& bn)
+{
+    const std::size_t n = bias.size();
+    if (n == 0 or weights.size() % n != 0 or bn.weight.size() != n or
+        bn.bias.size() != n or bn.running_mean.size() != n or
+        bn.running_var.size() != n)
+        throw CnnException("batch norm does not match the convolution");
+    const std::size_t per_channel = weights.size() / n;
+    for (std::size_t oc = 0; oc < n; ++oc)
+    {
+        const double scale =
+            bn.weight[oc] / std::sqrt(double{bn.running_var[oc]} + bn.eps);
+        for (std::size_t i = 0; i < per_channel; ++i)
+            weights[oc * per_channel + i] *= scale;
+        bias[oc] = (bias[oc] - double{bn.running_mean[oc]}) * scale +
+                   bn.bias[oc];
+    }
+}
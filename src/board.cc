@@ -119,9 +119,10 @@ void Coord::changeSize(int x, int y)
 {
     wlkx = x;
     wlky = y;
-    // board cannot be larger than 45x45 because of Game::lastWormNo, which
-    // allows only for 1023 worms for each player
-    assert(x >= 5 && x <= 45 && y >= 5 && y <= 45);
+    // board cannot be larger than maxx x maxy, the size of the tables here;
+    // 45x45 would be the limit of Game::lastWormNo, which allows only for
+    // 1023 worms for each player
+    assert(x >= 5 && x <= maxx && y >= 5 && y <= maxy);
     initPtTabs();
     N = -1;
     S = 1;
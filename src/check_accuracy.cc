@@ -36,7 +36,9 @@ testing NN. Copyright (C) 2021 Bartek Dyda, email: bartekdyda (at) protonmail
 
 void gatherDataFromPosition(Game& game, Move& move, unsigned move_no)
 {
-    const auto [is_cnn_available, probs] = getCnnInfo(game);
+    const auto [is_cnn_available, cnn_info] = getCnnInfo(game);
+    if (not is_cnn_available) return;
+    const auto& probs = *cnn_info;
     struct MoveAndProb
     {
         int x;
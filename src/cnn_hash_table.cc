@@ -31,29 +31,88 @@ reading NN. Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail
 
 namespace
 {
-using CnnInfo = std::vector<float>;
+struct Entry
+{
+    CnnInfo info;
+    bool speculative;
+};
+using Table = std::map<std::pair<Position, int>, Entry>;
 
-std::map<Position, CnnInfo> table;
+// The results are kept in two generations: a hit in the old one moves the
+// entry to the new one, and when the new one is full, the old one is dropped
+// and the new one takes its place. So the table keeps at most twice
+// max_generation_size entries, those used recently, over a game and across
+// the games of a server.
+Table table;
+Table old_table;
 std::mutex table_mutex;
 
 uint64_t ht_queries = 0;
 uint64_t ht_answers = 0;
+uint64_t speculative_saved = 0;
+uint64_t speculative_used = 0;
+
+void startNewGeneration()
+{
+    old_table = std::move(table);
+    table.clear();
+}
+
+Table::iterator find(const Table::key_type& key)
+{
+    if (const auto it = table.find(key); it != table.end()) return it;
+    auto node = old_table.extract(key);
+    if (node.empty()) return table.end();
+    if (table.size() >= cnn_ht::max_generation_size) startNewGeneration();
+    return table.insert(std::move(node)).position;
+}
+
 }  // namespace
 
-std::pair<bool, std::vector<float>> getCnnInfoFromHT(const Position pos)
+std::pair<bool, CnnInfo> getCnnInfoFromHT(const Position pos, int model)
 {
     std::lock_guard<std::mutex> l(table_mutex);
     ++ht_queries;
-    const auto it = table.find(pos);
-    if (it == table.end()) return {false, {}};
+    const auto it = find({pos, model});
+    if (it == table.end()) return {false, nullptr};
     ++ht_answers;
-    return {true, it->second};
+    if (it->second.speculative)
+    {
+        ++speculative_used;
+        it->second.speculative = false;
+    }
+    return {true, it->second.info};
+}
+
+bool isCnnInfoInHT(const Position pos, int model)
+{
+    std::lock_guard<std::mutex> l(table_mutex);
+    return table.contains({pos, model}) or old_table.contains({pos, model});
 }
 
-void saveCnnInfo(const Position pos, const std::vector<float>& info)
+void saveCnnInfo(const Position pos, CnnInfo info, bool speculative,
+                 int model)
 {
     std::lock_guard<std::mutex> l(table_mutex);
-    table.try_emplace(pos, info);
+    if (find({pos, model}) != table.end()) return;
+    if (table.size() >= cnn_ht::max_generation_size) startNewGeneration();
+    table.try_emplace({pos, model}, Entry{std::move(info), speculative});
+    if (speculative) ++speculative_saved;
+}
+
+void forgetCnnInfo(int model)
+{
+    std::lock_guard<std::mutex> l(table_mutex);
+    const auto of_model = [model](const auto& entry)
+    { return entry.first.second == model; };
+    std::erase_if(table, of_model);
+    std::erase_if(old_table, of_model);
+}
+
+std::size_t getCnnHtSize()
+{
+    std::lock_guard<std::mutex> l(table_mutex);
+    return table.size() + old_table.size();
 }
 
 std::pair<uint64_t, uint64_t> getCnnHtStats()
@@ -61,3 +120,9 @@ std::pair<uint64_t, uint64_t> getCnnHtStats()
     std::lock_guard<std::mutex> l(table_mutex);
     return {ht_queries, ht_answers};
 }
+
+std::pair<uint64_t, uint64_t> getSpeculativeStats()
+{
+    std::lock_guard<std::mutex> l(table_mutex);
+    return {speculative_saved, speculative_used};
+}
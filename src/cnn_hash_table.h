@@ -24,11 +24,38 @@ reading NN. Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <utility>
 #include <vector>
 
 using Position = std::pair<uint64_t, uint64_t>;
-
-std::pair<bool, std::vector<float>> getCnnInfoFromHT(const Position pos);
-void saveCnnInfo(const Position pos, const std::vector<float>& info);
+// CNN output in board layout (indexed by coord.ind), followed by the value
+// for the player to move (NaN if the net has no value head); shared between
+// the hash table and its readers, so that it is never copied after being
+// computed
+using CnnInfo = std::shared_ptr<const std::vector<float>>;
+
+namespace cnn_ht
+{
+// the table keeps at most twice that many results, the least recently used
+// are dropped
+constexpr std::size_t max_generation_size = 1 << 15;
+}  // namespace cnn_ht
+
+// Results of different models (numbered as in the router, 0 is the primary
+// one) are kept separately.
+std::pair<bool, CnnInfo> getCnnInfoFromHT(const Position pos, int model = 0);
+bool isCnnInfoInHT(const Position pos, int model = 0);
+// speculative: computed in advance by the prefetcher, counted as used when
+// read for the first time
+void saveCnnInfo(const Position pos, CnnInfo info, bool speculative = false,
+                 int model = 0);
+// removes all results of the model (e.g., of a net that was replaced)
+void forgetCnnInfo(int model);
+// number of results kept
+std::size_t getCnnHtSize();
 std::pair<uint64_t, uint64_t> getCnnHtStats();
+// returns (speculative entries saved, used)
+std::pair<uint64_t, uint64_t> getSpeculativeStats();
@@ -0,0 +1,220 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file cnn_input.h -- input planes of the
+CNN, shared by inference and extraction of training data.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "board.h"
+#include "game.h"
+
+namespace cnn_input
+{
+// Planes, from the point of view of the player to move (`me`):
+//   0-2: empty, my dot, opponent's dot,
+//   3-4: in my/opp territory,  5-6: in my/opp enclosure (0, 0.5, 1),
+//   7-8: in my/opp border (0, 0.5, 1),  9: safety of the dot (0..1),
+//   10: first line,  11: ones,
+//   12-13: where my/opp threat captures dots (1 - 0.75^dots),
+//   14-15: where0 of my/opp safe 2-move threats (1 - 0.75^min_win2),
+//   16-17: in my/opp 2-move enclosure,  18-19: my/opp 2-move miai.
+// Nets use the first 7, 10 or 20 of them.
+
+enum class Layout
+{
+    PlanesFirst,  // [plane][x][y], as the nets take it
+    PlanesLast    // [x][y][plane]
+};
+
+namespace detail
+{
+// Writes f(y) for y in [0, n) to dst[y * step]. Board arrays keep the points
+// of one x in consecutive cells, so for the usual layout the step is 1 and
+// the compiler vectorises the loop.
+template <typename F>
+inline void fillRow(float* dst, int step, int n, F f)
+{
+    if (step == 1)
+        for (int y = 0; y < n; ++y) dst[y] = f(y);
+    else
+        for (int y = 0; y < n; ++y) dst[y * step] = f(y);
+}
+
+inline auto clipHalf(const pti* a)
+{
+    return [a](int y) { return std::min<pti>(a[y], 2) * 0.5f; };
+}
+
+inline auto dotIs(const pti* worm, int who)
+{
+    return [worm, who](int y)
+    { return (worm[y] & SimpleGame::MASK_DOT) == who ? 1.0f : 0.0f; };
+}
+
+inline auto isPositive(const pti* a)
+{
+    return [a](int y) { return a[y] > 0 ? 1.0f : 0.0f; };
+}
+
+}  // namespace detail
+
+/// Writes PLANES (7, 10 or 20) input planes for game to out, every value of
+/// out is written. The point p of the board goes to the point
+/// applyIsometry(p, isometry) of the output, where bit 1 reflects x, bit 2
+/// reflects y and bit 4 swaps x and y (only for square boards).
+template <int PLANES, Layout LAYOUT = Layout::PlanesFirst>
+void encodePlanes(const Game& game, float* out, unsigned isometry = 0)
+{
+    static_assert(PLANES == 7 || PLANES == 10 || PLANES == 20);
+    const int wx = coord.wlkx;
+    const int wy = coord.wlky;
+    if ((isometry & 4) and wx != wy)
+        throw std::invalid_argument("encodePlanes: swapping x--y with " +
+                                    std::to_string(wx) + "x" +
+                                    std::to_string(wy));
+    constexpr bool planes_first = (LAYOUT == Layout::PlanesFirst);
+    const int plane_stride = planes_first ? wx * wy : 1;
+    const int x_stride = planes_first ? wy : wy * PLANES;
+    const int y_stride = planes_first ? 1 : PLANES;
+    auto outputIndex = [=](int x, int y)
+    {
+        if (isometry & 1) x = wx - 1 - x;
+        if (isometry & 2) y = wy - 1 - y;
+        if (isometry & 4) std::swap(x, y);
+        return x * x_stride + y * y_stride;
+    };
+    // output step between (x, y) and (x, y+1)
+    const int step =
+        ((isometry & 4) ? x_stride : y_stride) * ((isometry & 2) ? -1 : 1);
+
+    const int me = game.whoNowMoves();
+    const int opp = 3 - me;
+    const SimpleGame& sg = game.getSimpleGame();
+    const AllThreats& thr_me = game.threats[me - 1];
+    const AllThreats& thr_opp = game.threats[opp - 1];
+    using detail::fillRow;
+    for (int x = 0; x < wx; ++x)
+    {
+        const pti first = coord.ind(x, 0);
+        float* row = out + outputIndex(x, 0);
+        auto plane = [row, plane_stride](int k)
+        { return row + k * plane_stride; };
+        auto rowOf = [first](const auto& v) { return v.data() + first; };
+        const pti* worm = rowOf(sg.worm);
+        fillRow(plane(0), step, wy, detail::dotIs(worm, 0));
+        fillRow(plane(1), step, wy, detail::dotIs(worm, me));
+        fillRow(plane(2), step, wy, detail::dotIs(worm, opp));
+        fillRow(plane(3), step, wy,
+                detail::isPositive(rowOf(thr_me.is_in_terr)));
+        fillRow(plane(4), step, wy,
+                detail::isPositive(rowOf(thr_opp.is_in_terr)));
+        fillRow(plane(5), step, wy,
+                detail::clipHalf(rowOf(thr_me.is_in_encl)));
+        fillRow(plane(6), step, wy,
+                detail::clipHalf(rowOf(thr_opp.is_in_encl)));
+        if constexpr (PLANES > 7)
+        {
+            fillRow(plane(7), step, wy,
+                    detail::clipHalf(rowOf(thr_me.is_in_border)));
+            fillRow(plane(8), step, wy,
+                    detail::clipHalf(rowOf(thr_opp.is_in_border)));
+            // worm descriptions are in a hash map, getTotalSafetyOf looks
+            // there only for dots
+            fillRow(plane(9), step, wy,
+                    [&sg, first](int y) {
+                        return std::min(sg.getTotalSafetyOf(first + y), 2.0f) *
+                               0.5f;
+                    });
+        }
+        if constexpr (PLANES > 10)
+        {
+            const auto* dist = rowOf(coord.dist);
+            fillRow(plane(10), step, wy,
+                    [dist](int y) { return dist[y] == 1 ? 1.0f : 0.0f; });
+            fillRow(plane(11), step, wy, [](int) { return 1.0f; });
+            for (int k = 12; k < 16; ++k)
+                fillRow(plane(k), step, wy, [](int) { return 0.0f; });
+            fillRow(plane(16), step, wy,
+                    detail::isPositive(rowOf(thr_me.is_in_2m_encl)));
+            fillRow(plane(17), step, wy,
+                    detail::isPositive(rowOf(thr_opp.is_in_2m_encl)));
+            const pti* miai_me = rowOf(thr_me.is_in_2m_miai);
+            const pti* miai_opp = rowOf(thr_opp.is_in_2m_miai);
+            fillRow(plane(18), step, wy,
+                    [miai_me](int y) { return miai_me[y] > 1 ? 1.0f : 0.0f; });
+            fillRow(plane(19), step, wy,
+                    [miai_opp](int y)
+                    { return miai_opp[y] > 1 ? 1.0f : 0.0f; });
+        }
+    }
+
+    if constexpr (PLANES > 12)
+    {
+        auto at = [&](int k, pti p) -> float&
+        { return out[k * plane_stride + outputIndex(coord.x[p], coord.y[p])]; };
+        for (int player = 0; player < 2; ++player)
+        {
+            const bool mine = (player + 1 == me);
+            for (auto& t : game.threats[player].threats2m)
+                if (t.min_win2 && t.isSafe())
+                    at(mine ? 14 : 15, t.where0) =
+                        1.0f - std::pow(0.75f, t.min_win2);
+            for (auto& t : game.threats[player].threats)
+                if (t.where && t.singular_dots)
+                    at(mine ? 12 : 13, t.where) =
+                        1.0f - std::pow(0.75f, t.singular_dots);
+        }
+    }
+}
+
+/// As above, for the number of planes known at runtime.
+inline void encodePlanes(const Game& game, int planes, float* out,
+                         unsigned isometry = 0,
+                         Layout layout = Layout::PlanesFirst)
+{
+    const bool first = (layout == Layout::PlanesFirst);
+    switch (planes)
+    {
+        case 7:
+            first ? encodePlanes<7>(game, out, isometry)
+                  : encodePlanes<7, Layout::PlanesLast>(game, out, isometry);
+            break;
+        case 10:
+            first ? encodePlanes<10>(game, out, isometry)
+                  : encodePlanes<10, Layout::PlanesLast>(game, out, isometry);
+            break;
+        case 20:
+            first ? encodePlanes<20>(game, out, isometry)
+                  : encodePlanes<20, Layout::PlanesLast>(game, out, isometry);
+            break;
+        default:
+            throw std::invalid_argument("encodePlanes: unsupported planes " +
+                                        std::to_string(planes));
+    }
+}
+
+}  // namespace cnn_input
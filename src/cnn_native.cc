@@ -0,0 +1,357 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file cnn_native.cc -- CNN inference
+without libtorch. Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at)
+protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "cnn_native.h"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+// Vector abstraction for the convolution kernel: one vector holds VEC
+// consecutive points of a row.
+#if defined(__AVX512F__)
+constexpr int VEC = 16;
+using Vec = __m512;
+inline Vec vset1(float f) { return _mm512_set1_ps(f); }
+inline Vec vloadu(const float* p) { return _mm512_loadu_ps(p); }
+inline Vec vfmadd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+inline Vec vrelu(Vec a)
+{
+    // masked move rather than _mm512_max_ps, which triggers a false
+    // -Wmaybe-uninitialized in gcc 12 headers
+    return _mm512_maskz_mov_ps(
+        _mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_GT_OQ), a);
+}
+inline void vstore(float* p, Vec a, int n)
+{
+    if (n == VEC)
+        _mm512_storeu_ps(p, a);
+    else
+        _mm512_mask_storeu_ps(p, static_cast<__mmask16>((1u << n) - 1), a);
+}
+#elif defined(__AVX2__) && defined(__FMA__)
+constexpr int VEC = 8;
+using Vec = __m256;
+inline Vec vset1(float f) { return _mm256_set1_ps(f); }
+inline Vec vloadu(const float* p) { return _mm256_loadu_ps(p); }
+inline Vec vfmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+inline Vec vrelu(Vec a) { return _mm256_max_ps(a, _mm256_setzero_ps()); }
+inline void vstore(float* p, Vec a, int n)
+{
+    if (n == VEC)
+        _mm256_storeu_ps(p, a);
+    else
+    {
+        const __m256i mask = _mm256_cmpgt_epi32(
+            _mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        _mm256_maskstore_ps(p, mask, a);
+    }
+}
+#else
+constexpr int VEC = 1;
+using Vec = float;
+inline Vec vset1(float f) { return f; }
+inline Vec vloadu(const float* p) { return *p; }
+inline Vec vfmadd(Vec a, Vec b, Vec c) { return a * b + c; }
+inline Vec vrelu(Vec a) { return std::max(a, 0.0f); }
+inline void vstore(float* p, Vec a, int /*n*/) { *p = a; }
+#endif
+
+// Output channels computed together, so that every loaded input vector is
+// used OC_BLOCK times.
+constexpr int OC_BLOCK = 4;
+
+struct ConvGeometry
+{
+    int height;
+    int width;
+    int row_stride;
+    int plane_stride;
+    int margin;
+};
+
+// Computes output channels [oc0, oc0+NB) of one layer, with bias and
+// (optionally) relu fused into the store.
+template <int NB>
+void convolveBlock(const NativeCnn::Layer& layer, int oc0,
+                   const ConvGeometry& g, const float* in, float* out)
+{
+    const int k = layer.size;
+    const int kk = k * k;
+    const int shift = g.margin - k / 2;
+    const int w_oc_stride = layer.in_channels * kk;
+    const float* w_block = layer.weights.data() + oc0 * w_oc_stride;
+    for (int y = 0; y < g.height; ++y)
+    {
+        for (int x = 0; x < g.width; x += VEC)
+        {
+            Vec acc[NB];
+            for (int j = 0; j < NB; ++j) acc[j] = vset1(layer.bias[oc0 + j]);
+            const float* src = in + (y + shift) * g.row_stride + x + shift;
+            for (int ic = 0; ic < layer.in_channels; ++ic)
+            {
+                const float* src_plane = src + ic * g.plane_stride;
+                const float* w = w_block + ic * kk;
+                for (int ky = 0; ky < k; ++ky)
+                {
+                    const float* src_row = src_plane + ky * g.row_stride;
+                    const float* w_row = w + ky * k;
+                    for (int kx = 0; kx < k; ++kx)
+                    {
+                        const Vec v = vloadu(src_row + kx);
+                        for (int j = 0; j < NB; ++j)
+                            acc[j] = vfmadd(vset1(w_row[j * w_oc_stride + kx]),
+                                            v, acc[j]);
+                    }
+                }
+            }
+            const int n = std::min(VEC, g.width - x);
+            float* dst = out + oc0 * g.plane_stride +
+                         (y + g.margin) * g.row_stride + x + g.margin;
+            for (int j = 0; j < NB; ++j)
+                vstore(dst + j * g.plane_stride,
+                       layer.relu ? vrelu(acc[j]) : acc[j], n);
+        }
+    }
+}
+
+int32_t readInt(std::istream& is)
+{
+    int32_t value{};
+    is.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+}
+
+void writeInt(std::ostream& os, int32_t value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+}  // namespace
+
+bool NativeCnn::is_ready() const { return not layers.empty(); }
+
+void NativeCnn::setLayers(int in_channels_, std::vector<Layer> layers_,
+                          bool value_head_)
+{
+    int inch = in_channels_;
+    for (auto& layer : layers_)
+    {
+        layer.in_channels = inch;
+        if (layer.size <= 0 or layer.size % 2 == 0 or layer.out_channels <= 0)
+            throw CnnException("native cnn: unsupported layer");
+        if (layer.weights.size() != static_cast<std::size_t>(
+                                        layer.out_channels * inch *
+                                        layer.size * layer.size) or
+            layer.bias.size() != static_cast<std::size_t>(layer.out_channels))
+            throw CnnException("native cnn: wrong number of weights");
+        inch = layer.out_channels;
+    }
+    if (value_head_ and (layers_.empty() or layers_.back().out_channels < 2))
+        throw CnnException("native cnn: value head needs 2 output channels");
+    in_channels = in_channels_;
+    layers = std::move(layers_);
+    value_head = value_head_;
+    height = width = 0;  // workspace to be planned
+}
+
+void NativeCnn::load(const std::string& /*model_file*/,
+                     const std::string& weights_file, int default_size)
+{
+    std::ifstream is(weights_file, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    is.read(magic, sizeof(magic));
+    if (not is or std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        throw CnnException("native cnn: wrong file " + weights_file);
+    const auto version = readInt(is);
+    if (version != 1 and version != VERSION)
+        throw CnnException("native cnn: unsupported version " +
+                           std::to_string(version));
+    const int inch = readInt(is);
+    const int n_layers = readInt(is);
+    const bool with_value = (version >= 2) and readInt(is) != 0;
+    if (not is or inch <= 0 or n_layers <= 0 or n_layers > 1000)
+        throw CnnException("native cnn: corrupted file " + weights_file);
+    std::vector<Layer> new_layers(n_layers);
+    int prev_channels = inch;
+    for (auto& layer : new_layers)
+    {
+        layer.out_channels = readInt(is);
+        layer.size = readInt(is);
+        layer.relu = readInt(is) != 0;
+        if (not is or layer.out_channels <= 0 or layer.out_channels > 4096 or
+            layer.size <= 0 or layer.size > 15)
+            throw CnnException("native cnn: corrupted file " + weights_file);
+        layer.weights.resize(layer.out_channels * prev_channels * layer.size *
+                             layer.size);
+        layer.bias.resize(layer.out_channels);
+        is.read(reinterpret_cast<char*>(layer.weights.data()),
+                layer.weights.size() * sizeof(float));
+        is.read(reinterpret_cast<char*>(layer.bias.data()),
+                layer.bias.size() * sizeof(float));
+        if (not is)
+            throw CnnException("native cnn: truncated file " + weights_file);
+        prev_channels = layer.out_channels;
+    }
+    setLayers(inch, std::move(new_layers), with_value);
+    plan(default_size, default_size);
+    std::cerr << "Native cnn: " << layers.size() << " layers, " << in_channels
+              << " planes, value head " << value_head << ", vector width "
+              << VEC << std::endl;
+}
+
+void NativeCnn::save(const std::string& weights_file, int in_channels,
+                     const std::vector<Layer>& layers, bool value_head)
+{
+    std::ofstream os(weights_file, std::ios::binary);
+    os.write(MAGIC, sizeof(MAGIC));
+    writeInt(os, VERSION);
+    writeInt(os, in_channels);
+    writeInt(os, layers.size());
+    writeInt(os, value_head);
+    for (const auto& layer : layers)
+    {
+        writeInt(os, layer.out_channels);
+        writeInt(os, layer.size);
+        writeInt(os, layer.relu);
+        os.write(reinterpret_cast<const char*>(layer.weights.data()),
+                 layer.weights.size() * sizeof(float));
+        os.write(reinterpret_cast<const char*>(layer.bias.data()),
+                 layer.bias.size() * sizeof(float));
+    }
+    if (not os) throw CnnException("native cnn: cannot write " + weights_file);
+}
+
+void NativeCnn::init(int /*size*/, const std::string& model_file,
+                     const std::string& weights_file, int default_size)
+{
+    if (not is_ready()) load(model_file, weights_file, default_size);
+}
+
+void NativeCnn::plan(int size, int psize)
+{
+    height = size;
+    width = psize;
+    margin = 0;
+    int channels = in_channels;
+    for (const auto& layer : layers)
+    {
+        margin = std::max(margin, layer.size / 2);
+        channels = std::max(channels, layer.out_channels);
+    }
+    row_stride = width + 2 * margin;
+    plane_stride = (height + 2 * margin) * row_stride;
+    // vector loads at the end of the last row may read up to VEC-1 floats
+    // past the last plane
+    const std::size_t buffer_size = channels * plane_stride + VEC;
+    buffer_a.assign(buffer_size, 0.0f);
+    buffer_b.assign(buffer_size, 0.0f);
+}
+
+void NativeCnn::convolve(const Layer& layer, int out_channels, const float* in,
+                         float* out) const
+{
+    const ConvGeometry g{height, width, row_stride, plane_stride, margin};
+    int oc0 = 0;
+    for (; oc0 + OC_BLOCK <= out_channels; oc0 += OC_BLOCK)
+        convolveBlock<OC_BLOCK>(layer, oc0, g, in, out);
+    switch (out_channels - oc0)
+    {
+        case 3:
+            convolveBlock<3>(layer, oc0, g, in, out);
+            break;
+        case 2:
+            convolveBlock<2>(layer, oc0, g, in, out);
+            break;
+        case 1:
+            convolveBlock<1>(layer, oc0, g, in, out);
+            break;
+    }
+}
+
+void NativeCnn::get_data(float* data, int size, int planes, int psize,
+                         float* output)
+{
+    if (planes != in_channels)
+        throw CnnException("native cnn: wrong number of planes");
+    if (size != height or psize != width) plan(size, psize);
+    // margins of both buffers stay zero, only the interiors are written
+    for (int p = 0; p < planes; ++p)
+        for (int y = 0; y < height; ++y)
+            std::copy_n(data + (p * height + y) * width, width,
+                        buffer_a.data() + p * plane_stride +
+                            (y + margin) * row_stride + margin);
+    float* in = buffer_a.data();
+    float* out = buffer_b.data();
+    for (std::size_t i = 0; i < layers.size(); ++i)
+    {
+        // only the first channel of the last layer is the policy, the
+        // second one the value
+        const int out_channels = (i + 1 == layers.size())
+                                     ? (value_head ? 2 : 1)
+                                     : layers[i].out_channels;
+        convolve(layers[i], out_channels, in, out);
+        std::swap(in, out);
+    }
+    float max_value = in[margin * row_stride + margin];
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+            max_value =
+                std::max(max_value, in[(y + margin) * row_stride + x + margin]);
+    float sum = 0.0f;
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+        {
+            const float e = std::exp(
+                in[(y + margin) * row_stride + x + margin] - max_value);
+            output[y * width + x] = e;
+            sum += e;
+        }
+    for (int i = 0; i < height * width; ++i) output[i] /= sum;
+    output[height * width] = std::nanf("");
+    if (value_head)
+    {
+        float value_sum = 0.0f;
+        for (int y = 0; y < height; ++y)
+        {
+            const float* row =
+                in + plane_stride + (y + margin) * row_stride + margin;
+            for (int x = 0; x < width; ++x) value_sum += row[x];
+        }
+        output[height * width] = std::tanh(value_sum / (height * width));
+    }
+}
+
+std::unique_ptr<CnnProxy> buildNative()
+{
+    return std::make_unique<NativeCnn>();
+}
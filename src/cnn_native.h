@@ -0,0 +1,93 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file cnn_native.h -- CNN inference
+without libtorch. Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at)
+protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mcnn.h"
+
+// Inference of the policy nets (stacks of convolutions with BatchNorm already
+// folded in and optional relu) with hand-vectorised direct convolutions.
+// Selected by the "native:" prefix of the model line in cnn.config, the
+// weights line then names a file converted by torch2native.
+//
+// Weights file, all values 32-bit little endian:
+//   "KRNW", version, input planes, number of layers,
+//   (version 2) value head (0/1),
+//   then for each layer: output channels, kernel size, relu (0/1),
+//   weights [out][in][size][size], bias [out].
+// Channel 0 of the last layer is the policy; with the value head, the value
+// is tanh of the mean of channel 1.
+class NativeCnn : public CnnProxy
+{
+   public:
+    struct Layer
+    {
+        int in_channels{};
+        int out_channels{};
+        int size{};
+        bool relu{};
+        std::vector<float> weights{};
+        std::vector<float> bias{};
+    };
+    static constexpr char MAGIC[4] = {'K', 'R', 'N', 'W'};
+    static constexpr int32_t VERSION = 2;
+
+    bool is_ready() const override;
+    void load(const std::string& model_file, const std::string& weights_file,
+              int default_size) override;
+    void init(int size, const std::string& model_file,
+              const std::string& weights_file, int default_size) override;
+    void get_data(float* data, int size, int planes, int psize,
+                  float* output) override;
+    bool has_value() const override { return value_head; }
+
+    void setLayers(int in_channels, std::vector<Layer> layers,
+                   bool value_head = false);
+    static void save(const std::string& weights_file, int in_channels,
+                     const std::vector<Layer>& layers, bool value_head = false);
+
+   private:
+    void plan(int size, int psize);
+    void convolve(const Layer& layer, int out_channels, const float* in,
+                  float* out) const;
+
+    int in_channels{};
+    std::vector<Layer> layers{};
+    bool value_head{false};
+    // workspace, planned for the board size: activations are kept with a
+    // zero margin of width `margin`, so convolutions need no bounds checks
+    int height{};
+    int width{};
+    int margin{};
+    int row_stride{};
+    int plane_stride{};
+    std::vector<float> buffer_a{};
+    std::vector<float> buffer_b{};
+};
+
+std::unique_ptr<CnnProxy> buildNative();
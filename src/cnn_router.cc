@@ -0,0 +1,116 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file cnn_router.cc -- choice of the CNN
+model for a query.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "cnn_router.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+CnnRouter::CnnRouter(std::vector<Model> models)
+{
+    if (models.empty())
+        throw std::invalid_argument("CnnRouter: no models");
+    states.reserve(models.size());
+    for (auto& m : models)
+    {
+        m.workers = std::max(m.workers, 1);
+        const double cost = m.cost_micros;
+        states.push_back(State{std::move(m), cost, 0});
+    }
+}
+
+double CnnRouter::expectedLatencyLocked(const State& s) const
+{
+    // queries before us that do not have a worker yet
+    const int waiting = std::max(0, s.in_flight + 1 - s.model.workers);
+    return s.cost * (1.0 + static_cast<double>(waiting) / s.model.workers);
+}
+
+int CnnRouter::choose(int depth, std::optional<double> micros_left) const
+{
+    std::lock_guard<std::mutex> l(mutex);
+    int fallback = -1;
+    int chosen = -1;
+    for (int i = 0; i < size(); ++i)
+    {
+        const State& s = states[i];
+        if (s.model.max_depth >= 0 and depth > s.model.max_depth) continue;
+        fallback = i;
+        if (chosen >= 0) continue;
+        const double latency = expectedLatencyLocked(s);
+        if (micros_left and latency > *micros_left) continue;
+        if (latency > max_queue_factor * s.cost) continue;
+        chosen = i;
+    }
+    if (chosen >= 0) return chosen;
+    return fallback >= 0 ? fallback : size() - 1;
+}
+
+void CnnRouter::started(int model)
+{
+    std::lock_guard<std::mutex> l(mutex);
+    ++states.at(model).in_flight;
+}
+
+void CnnRouter::finished(int model, std::optional<double> micros)
+{
+    std::lock_guard<std::mutex> l(mutex);
+    State& s = states.at(model);
+    --s.in_flight;
+    if (micros)
+    {
+        s.cost = (s.cost > 0.0)
+                     ? (1.0 - ema_weight) * s.cost + ema_weight * *micros
+                     : *micros;
+    }
+}
+
+double CnnRouter::costEstimate(int model) const
+{
+    std::lock_guard<std::mutex> l(mutex);
+    return states.at(model).cost;
+}
+
+double CnnRouter::expectedLatency(int model) const
+{
+    std::lock_guard<std::mutex> l(mutex);
+    return expectedLatencyLocked(states.at(model));
+}
+
+int CnnRouter::inFlight(int model) const
+{
+    std::lock_guard<std::mutex> l(mutex);
+    return states.at(model).in_flight;
+}
+
+void CnnRouter::setWorkers(int model, int workers)
+{
+    std::lock_guard<std::mutex> l(mutex);
+    states.at(model).model.workers = std::max(workers, 1);
+}
+
+const std::string& CnnRouter::name(int model) const
+{
+    return states.at(model).model.name;
+}
@@ -0,0 +1,80 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file cnn_router.h -- choice of the CNN
+model for a query.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Chooses which of the CNN models answers a query. Models are given in the
+// order of preference (usually the strongest and most expensive first); the
+// last one is the fallback. A model is used for a query if
+//  - the depth of the node is at most its max_depth (negative: any depth),
+//  - its expected latency, i.e., the forward time (exponential moving average
+//    of the measured times) increased by the wait for a free worker, fits
+//    in the time left to the deadline, if there is one,
+//  - the expected latency is at most max_queue_factor times the forward
+//    time, so that under load queries go to a cheaper model instead of
+//    queueing behind the big one.
+// If no model qualifies, the last one allowed by depth is used.
+class CnnRouter
+{
+   public:
+    struct Model
+    {
+        std::string name{};
+        int max_depth{-1};
+        double cost_micros{0.0};  // initial estimate of the forward time
+        int workers{1};
+    };
+    static constexpr double ema_weight = 0.1;
+    static constexpr double max_queue_factor = 2.0;
+
+    explicit CnnRouter(std::vector<Model> models);
+    int choose(int depth, std::optional<double> micros_left = {}) const;
+    // started/finished bracket each query sent to the model, micros is the
+    // measured forward time or empty if the query failed
+    void started(int model);
+    void finished(int model, std::optional<double> micros);
+    double costEstimate(int model) const;
+    double expectedLatency(int model) const;
+    int inFlight(int model) const;
+    void setWorkers(int model, int workers);
+    int size() const { return static_cast<int>(states.size()); }
+    const std::string& name(int model) const;
+
+   private:
+    struct State
+    {
+        Model model;
+        double cost;
+        int in_flight;
+    };
+    double expectedLatencyLocked(const State& s) const;
+
+    mutable std::mutex mutex;
+    std::vector<State> states;
+};
@@ -26,21 +26,36 @@ protonmail (dot) com
 
 #include <semaphore.h>
 #include <sys/mman.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <condition_variable>
+#include <csignal>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <fstream>
+#include <future>
+#include <iomanip>
 #include <iostream>
 #include <mutex>
+#include <new>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 //#include "torch/mtorch.h"
+#include "cnn_native.h"
+#include "latency_histogram.h"
 #include "mcnn.h"
+#include "trace.h"
 
 namespace
 {
@@ -51,16 +66,36 @@ void* create_shared_memory(size_t size)
     return mmap(NULL, size, protection, visibility, -1, 0);
 }
 
-template <typename T>
-std::size_t sizeOfVec(const std::vector<T>& v)
-{
-    return v.size() * sizeof(T);
-}
-
 std::mutex caffe_mutex;
 bool is_parent{true};
 // bool madeQuiet = false;
 
+// sem_wait with a time limit, false on timeout
+bool waitFor(sem_t* sem, int timeout_ms)
+{
+    timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        ++deadline.tv_sec;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (sem_timedwait(sem, &deadline) != 0)
+    {
+        if (errno != EINTR) return false;
+    }
+    return true;
+}
+
+double microsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
 }  // namespace
 
 void* add(void* ptr, std::size_t arg)
@@ -90,6 +125,11 @@ class SharedMemWithSemaphores
     {
         mem = create_shared_memory(size + sizeof(sem_t) * n_sem +
                                    sizeof(uint32_t));
+        initSemaphores();
+    }
+
+    void initSemaphores()
+    {
         const int shared = 1;
         const unsigned value = 0;
         for (int n = 0; n < n_sem; ++n)
@@ -99,15 +139,23 @@ class SharedMemWithSemaphores
         }
     }
 
-    void sendJob(uint32_t datav, const void* data, size_t s, void* incoming,
-                 size_t si)
+    // only when no process waits on them, i.e., the worker is dead
+    void resetSemaphores()
+    {
+        for (int n = 0; n < n_sem; ++n) sem_destroy(getSemaphore(n));
+        initSemaphores();
+    }
+
+    // Data starts with a status word (wlkx on the way to the worker, success
+    // flag on the way back), followed by the payload: input planes, which the
+    // worker overwrites with output probabilities. Returns false if the
+    // worker did not answer in timeout_ms.
+    bool runJob(uint32_t datav, int timeout_ms)
     {
         getControlWord() = 0;
-        memcpy(getData(), &datav, sizeof(datav));
-        memcpy(add(getData(), sizeof(datav)), data, s);
+        getStatusWord() = datav;
         sem_post(getSemaphore(0));
-        sem_wait(getSemaphore(1));
-        memcpy(incoming, getData(), si);
+        return waitFor(getSemaphore(1), timeout_ms);
     }
 
     sem_t* getSemaphore(int n) { return static_cast<sem_t*>(mem) + n; }
@@ -121,6 +169,11 @@ class SharedMemWithSemaphores
         return *static_cast<uint32_t*>(static_cast<void*>(
             static_cast<char*>(mem) + sizeof(sem_t) * n_sem));
     }
+    uint32_t& getStatusWord() { return *static_cast<uint32_t*>(getData()); }
+    float* getPayload()
+    {
+        return static_cast<float*>(add(getData(), sizeof(uint32_t)));
+    }
 
     ~SharedMemWithSemaphores()
     {
@@ -129,7 +182,9 @@ class SharedMemWithSemaphores
             std::cerr << "Killing... " << mem << std::endl;
             getControlWord() = 1;
             sem_post(getSemaphore(0));
-            sem_wait(getSemaphore(1));
+            // the worker may be dead or busy with a job that timed out
+            constexpr int exit_timeout_ms = 1000;
+            waitFor(getSemaphore(1), exit_timeout_ms);
             sem_destroy(getSemaphore(1));
             sem_destroy(getSemaphore(0));
             munmap(mem, size + sizeof(sem_t) * n_sem + sizeof(uint32_t));
@@ -149,22 +204,56 @@ class WorkersPool : public WorkersPoolBase
     WorkersPool(const WorkersPool&) = delete;
     WorkersPool operator=(WorkersPool&&) = delete;
     WorkersPool operator=(const WorkersPool&) = delete;
-    ~WorkersPool() override = default;
+    ~WorkersPool() override;
 
-    void doWork(uint32_t datav, const void* data, size_t s, void* incoming,
-                size_t si);
+    bool doWork(uint32_t datav, const InputWriter& write_input,
+                const OutputReader& read_output);
     int getCount() const { return count; }
     int getPlanes() const override { return planes; }
-    std::pair<bool, std::vector<float>> getCnnInfo(std::vector<float>& input,
-                                                   uint32_t wlkx) override;
+    int getWorkers() const override
+    {
+        return std::max(1, count + int(use_this_thread));
+    }
+    bool getCnnInfo(const InputWriter& write_input,
+                    const OutputReader& read_output, uint32_t wlkx) override;
+    std::optional<bool> tryGetCnnInfo(const InputWriter& write_input,
+                                      const OutputReader& read_output,
+                                      uint32_t wlkx) override;
+    bool warmUp(const InputWriter& write_input,
+                const OutputReader& read_output, uint32_t wlkx) override;
+    void shareWithForks() override;
+    void printStats(std::ostream& os) const override;
 
    private:
+    struct WorkerStats
+    {
+        LatencyHistogram queue_wait{};
+        LatencyHistogram forward{};
+        LatencyHistogram copy{};
+        std::atomic<uint64_t> failures{0};
+        std::atomic<uint64_t> timeouts{0};
+        std::atomic<uint64_t> respawns{0};
+    };
+
     void child_worker(void* data);
     void worker(int number, SharedMemWithSemaphores& sh);
     bool setupWorkers(int n, std::size_t memory_needed);
     int findWorker();
+    int takeSharedWorker(bool wait);
+    std::size_t sharedFreeSize() const
+    {
+        return sizeof(sem_t) + count * sizeof(std::atomic<int>);
+    }
     void releaseWorker(int which);
+    bool runOnWorker(int which, uint32_t datav, const InputWriter& write_input,
+                     const OutputReader& read_output);
+    bool ensureAlive(int which);
+    void requestRespawn(int which, bool reaped);
+    void supervise();
+    bool respawn(int which, bool reaped);
     void initialiseCnn(const uint32_t wlkx);
+    static void printRow(std::ostream& os, const std::string& name,
+                         const WorkerStats& st);
 
     std::mutex jobs_mutex;
     std::condition_variable cv;
@@ -172,16 +261,42 @@ class WorkersPool : public WorkersPoolBase
     std::vector<int> is_free;
     int how_many_free;
     int count{0};
+    // workers not given up after a failed respawn
+    std::atomic<int> alive{0};
     std::vector<pid_t> pids;
     std::vector<SharedMemWithSemaphores> mems;
+    std::vector<std::unique_ptr<WorkerStats>> stats;
+    WorkerStats this_thread_stats{};
+    // 1 while a worker has not answered since it was (re)started, its first
+    // query loads the net and gets the longer timeout; accessed only by the
+    // thread that holds the worker
+    std::vector<char> cold;
+    int timeout_ms{DEFAULT_TIMEOUT_MS};
+    // workers to start again by the supervisor thread, the only one that
+    // forks after the setup, and whether they are already reaped; guarded
+    // by jobs_mutex
+    std::vector<std::pair<int, bool>> to_respawn;
+    bool stop_supervisor{false};
+    std::condition_variable supervisor_cv;
+    std::thread supervisor;
+    // Set by shareWithForks(): the number of free workers and which ones are
+    // free, in memory shared with the processes forked afterwards, used
+    // instead of how_many_free and is_free. The supervisor runs only in this
+    // process, so a worker that fails in a forked one is never released.
+    sem_t* shared_free_count{nullptr};
+    std::atomic<int>* shared_is_free{nullptr};
 
     std::unique_ptr<CnnProxy> cnn{nullptr};
     bool use_this_thread{false};
+    bool use_native{false};
     int planes = 10;
     std::string config_file;
     std::string model_file_name{};
     std::string weights_file_name{};
+    std::string cnn_options{};
     constexpr static int DEFAULT_CNN_BOARD_SIZE = 20;
+    constexpr static int DEFAULT_TIMEOUT_MS = 5000;
+    constexpr static int LOAD_TIMEOUT_MS = 30000;
 };
 
 bool WorkersPool::setupWorkers(int n, std::size_t memory_needed)
@@ -215,9 +330,30 @@ bool WorkersPool::setupWorkers(int n, std::size_t memory_needed)
     is_free.resize(count);
     std::fill(is_free.begin(), is_free.end(), 1);
     how_many_free = count;
+    alive = count;
+    cold.assign(count, 1);
+    for (int i = 0; i < count; ++i)
+        stats.push_back(std::make_unique<WorkerStats>());
+    supervisor = std::thread([this] { supervise(); });
     return true;
 }
 
+WorkersPool::~WorkersPool()
+{
+    if (shared_free_count != nullptr)
+    {
+        sem_destroy(shared_free_count);
+        munmap(shared_free_count, sharedFreeSize());
+    }
+    if (not supervisor.joinable()) return;
+    {
+        std::lock_guard<std::mutex> l(jobs_mutex);
+        stop_supervisor = true;
+    }
+    supervisor_cv.notify_one();
+    supervisor.join();
+}
+
 int WorkersPool::findWorker()
 {
     int taken = -1;
@@ -231,8 +367,30 @@ int WorkersPool::findWorker()
     return taken;
 }
 
+// -1 if no worker is free in time (or at once, if not wait)
+int WorkersPool::takeSharedWorker(bool wait)
+{
+    if (wait ? not waitFor(shared_free_count, LOAD_TIMEOUT_MS)
+             : sem_trywait(shared_free_count) != 0)
+        return -1;
+    for (int i = 0; i < count; ++i)
+    {
+        int expected = 1;
+        if (shared_is_free[i].compare_exchange_strong(expected, 0)) return i;
+    }
+    // not reached, the semaphore counts the free workers
+    sem_post(shared_free_count);
+    return -1;
+}
+
 void WorkersPool::releaseWorker(int which)
 {
+    if (shared_free_count != nullptr)
+    {
+        shared_is_free[which] = 1;
+        sem_post(shared_free_count);
+        return;
+    }
     {
         std::lock_guard<std::mutex> l(jobs_mutex);
         is_free.at(which) = 1;
@@ -241,17 +399,146 @@ void WorkersPool::releaseWorker(int which)
     cv.notify_one();
 }
 
-void WorkersPool::doWork(uint32_t datav, const void* data, size_t s,
-                         void* incoming, size_t si)
+bool WorkersPool::doWork(uint32_t datav, const InputWriter& write_input,
+                         const OutputReader& read_output)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::optional<trace::Span> wait_span{std::in_place, "pool wait"};
+    int taken = -1;
+    if (shared_free_count != nullptr)
+    {
+        taken = takeSharedWorker(true);
+        if (taken == -1) return false;
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(jobs_mutex);
+        if (how_many_free == 0)
+            cv.wait(lock, [&]() { return how_many_free > 0 or alive == 0; });
+        if (alive == 0) return false;
+        taken = findWorker();
+    }
+    wait_span.reset();
+    if (taken == -1) throw std::runtime_error("do Work");
+    stats.at(taken)->queue_wait.add(microsSince(start));
+    return runOnWorker(taken, datav, write_input, read_output);
+}
+
+// Watchdog: a worker that died (e.g., crashed in the net) or does not
+// answer in time is handed, still taken, to the supervisor thread, which
+// kills it if needed and starts it again, and only then releases it. The
+// query fails and the caller falls back, in the end to the heuristic priors.
+// A worker that cannot be started again is not released, so it is never
+// chosen again.
+bool WorkersPool::ensureAlive(int which)
+{
+    int status = 0;
+    if (waitpid(pids.at(which), &status, WNOHANG) != pids.at(which))
+        return true;
+    std::cerr << "CNN worker #" << which << " (" << config_file
+              << ") died, status " << status << std::endl;
+    requestRespawn(which, true);
+    return false;
+}
+
+void WorkersPool::requestRespawn(int which, bool reaped)
+{
+    {
+        std::lock_guard<std::mutex> l(jobs_mutex);
+        to_respawn.emplace_back(which, reaped);
+    }
+    supervisor_cv.notify_one();
+}
+
+void WorkersPool::supervise()
 {
     std::unique_lock<std::mutex> lock(jobs_mutex);
-    if (how_many_free == 0) cv.wait(lock, [&]() { return how_many_free; });
-    int taken = findWorker();
+    for (;;)
+    {
+        supervisor_cv.wait(
+            lock, [this] { return stop_supervisor or not to_respawn.empty(); });
+        if (stop_supervisor) return;
+        const auto [which, reaped] = to_respawn.back();
+        to_respawn.pop_back();
+        lock.unlock();
+        if (respawn(which, reaped)) releaseWorker(which);
+        lock.lock();
+    }
+}
 
-    lock.unlock();
-    if (taken == -1) throw std::runtime_error("do Work");
-    mems.at(taken).sendJob(datav, data, s, incoming, si);
+bool WorkersPool::respawn(int which, bool reaped)
+{
+    if (not reaped)
+    {
+        kill(pids.at(which), SIGKILL);
+        waitpid(pids.at(which), nullptr, 0);
+    }
+    auto& sh = mems.at(which);
+    sh.resetSemaphores();
+    const pid_t id = fork();
+    if (id == 0)
+    {
+        is_parent = false;
+        worker(which, sh);
+    }
+    if (id == -1)
+    {
+        std::cerr << "CNN worker #" << which << " (" << config_file
+                  << ") could not be started again" << std::endl;
+        {
+            std::lock_guard<std::mutex> l(jobs_mutex);
+            --alive;
+        }
+        cv.notify_all();
+        return false;
+    }
+    pids.at(which) = id;
+    cold.at(which) = 1;
+    ++stats.at(which)->respawns;
+    return true;
+}
+
+bool WorkersPool::runOnWorker(int taken, uint32_t datav,
+                              const InputWriter& write_input,
+                              const OutputReader& read_output)
+{
+    auto& sh = mems.at(taken);
+    auto& st = *stats.at(taken);
+    if (not ensureAlive(taken)) return false;
+    const auto start = std::chrono::steady_clock::now();
+    {
+        const trace::Span span("pool send");
+        write_input(sh.getPayload());
+    }
+    double copy_micros = microsSince(start);
+    const auto job_start = std::chrono::steady_clock::now();
+    std::optional<trace::Span> job_span{std::in_place, "pool forward wait"};
+    if (not sh.runJob(datav, cold.at(taken)
+                                 ? std::max(timeout_ms, LOAD_TIMEOUT_MS)
+                                 : timeout_ms))
+    {
+        ++st.timeouts;
+        std::cerr << "CNN worker #" << taken << " (" << config_file
+                  << ") timed out, starting it again" << std::endl;
+        requestRespawn(taken, false);
+        return false;
+    }
+    job_span.reset();
+    const bool success = sh.getStatusWord() != 0;
+    if (success)
+    {
+        if (not cold.at(taken)) st.forward.add(microsSince(job_start));
+        cold.at(taken) = 0;
+        const auto read_start = std::chrono::steady_clock::now();
+        const trace::Span span("pool read");
+        read_output(sh.getPayload());
+        copy_micros += microsSince(read_start);
+        st.copy.add(copy_micros);
+    }
+    else
+        ++st.failures;
     releaseWorker(taken);
+    return success;
 }
 
 void WorkersPool::worker(int number, SharedMemWithSemaphores& sh)
@@ -269,16 +556,28 @@ void WorkersPool::worker(int number, SharedMemWithSemaphores& sh)
         sem_post(sh.getSemaphore(1));
     }
     std::cerr << "Bye from child #" << number << std::endl;
-    exit(0);
+    // no static destructors and atexit handlers of the parent, whose threads
+    // do not exist here
+    _exit(0);
 }
 
 void WorkersPool::initialiseCnn(const uint32_t wlkx)
 {
     if (cnn == nullptr)
     {
-        std::cerr << "Initialise " << wlkx << "x" << wlkx << " with torch"
-                  << std::endl;
-        cnn = buildTorch();
+        std::cerr << "Initialise " << wlkx << "x" << wlkx << " with "
+                  << (use_native ? "native" : "torch") << std::endl;
+        if (use_native)
+            cnn = buildNative();
+        else
+        {
+#ifdef KROPLA_NO_TORCH
+            throw CnnException("kropla built without torch, use native:");
+#else
+            cnn = buildTorch();
+#endif
+        }
+        cnn->set_options(cnn_options);
     }
     try
     {
@@ -299,16 +598,9 @@ try
 {
     const uint32_t wlkx = *static_cast<uint32_t*>(data);
     initialiseCnn(wlkx);
-    float* datafl = static_cast<float*>(add(data, sizeof(uint32_t)));
-    auto debug_time = std::chrono::high_resolution_clock::now();
-    auto res = cnn->get_data(datafl, wlkx, planes, wlkx);
-    std::cerr << "Forward time, child worker [micros]: "
-              << std::chrono::duration_cast<std::chrono::microseconds>(
-                     std::chrono::high_resolution_clock::now() - debug_time)
-                     .count()
-              << "  config: " << config_file << std::endl;
+    float* payload = static_cast<float*>(add(data, sizeof(uint32_t)));
+    cnn->get_data(payload, wlkx, planes, wlkx, payload);
     static_cast<uint32_t*>(data)[0] = true;
-    memcpy(data, static_cast<void*>(res.data()), sizeOfVec(res));
 }
 catch (const CnnException& exc)
 {
@@ -329,13 +621,42 @@ WorkersPool::WorkersPool(const std::string& config_file, int wlkx,
         if (std::getline(t, number_of_planes))
             if (std::getline(t, model_file_name))
                 if (std::getline(t, weights_file_name))
-                    std::getline(t, n_workers_str);
+                    if (std::getline(t, n_workers_str))
+                        std::getline(t, cnn_options);
         const std::string torch_id = "torch:";
         if (model_file_name.substr(0, torch_id.length()) == torch_id)
         {
             model_file_name = model_file_name.substr(torch_id.length());
         }
-        planes = std::stoi(number_of_planes);
+        // options for the pool itself are taken out, the rest goes to the net
+        {
+            std::istringstream is(cnn_options);
+            std::string rest{};
+            const std::string timeout_id = "timeout_ms=";
+            for (std::string s; is >> s;)
+            {
+                if (s.starts_with(timeout_id))
+                    timeout_ms = std::max(
+                        1, std::atoi(s.c_str() + timeout_id.length()));
+                else
+                    rest += (rest.empty() ? "" : " ") + s;
+            }
+            cnn_options = rest;
+        }
+        const std::string native_id = "native:";
+        if (model_file_name.substr(0, native_id.length()) == native_id)
+        {
+            model_file_name = model_file_name.substr(native_id.length());
+            use_native = true;
+        }
+        try
+        {
+            planes = std::stoi(number_of_planes);
+        }
+        catch (const std::logic_error&)
+        {
+            throw std::runtime_error("no number of planes in " + config_file);
+        }
         if (planes != 7 and planes != 10 and planes != 20)
         {
             std::cerr << "Unsupported number of planes (" << planes
@@ -374,16 +695,10 @@ WorkersPool::WorkersPool(const std::string& config_file, int wlkx,
     }
 }
 
-std::pair<bool, std::vector<float>> WorkersPool::getCnnInfo(
-    std::vector<float>& input, uint32_t wlkx)
+bool WorkersPool::getCnnInfo(const InputWriter& write_input,
+                             const OutputReader& read_output, uint32_t wlkx)
 try
 {
-    if (input.empty())
-    {
-        std::cerr << "No input for cnn" << std::endl;
-        return {false, {}};
-    }
-
     std::unique_lock<std::mutex> lock{caffe_mutex, std::defer_lock};
     bool acquired_lock = false;
     if (use_this_thread)
@@ -400,26 +715,132 @@ try
     }
     if (acquired_lock)
     {
-        auto debug_time = std::chrono::high_resolution_clock::now();
-        auto res = cnn->get_data(input.data(), wlkx, planes, wlkx);
+        const trace::Span span("forward in this thread");
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<float> buffer(std::size_t(planes) * wlkx * wlkx);
+        write_input(buffer.data());
+        double copy_micros = microsSince(start);
+        const auto forward_start = std::chrono::steady_clock::now();
+        cnn->get_data(buffer.data(), wlkx, planes, wlkx, buffer.data());
         lock.unlock();
-        std::cerr << "Forward time, this thread [micros]: "
-                  << std::chrono::duration_cast<std::chrono::microseconds>(
-                         std::chrono::high_resolution_clock::now() - debug_time)
-                         .count()
-                  << "  config: " << config_file << std::endl;
-        return {true, res};
+        this_thread_stats.forward.add(microsSince(forward_start));
+        const auto read_start = std::chrono::steady_clock::now();
+        read_output(buffer.data());
+        copy_micros += microsSince(read_start);
+        this_thread_stats.copy.add(copy_micros);
+        return true;
     }
     // use worker
-    std::vector<float> res(wlkx * wlkx, 0.0f);
-    doWork(wlkx, static_cast<void*>(input.data()), sizeOfVec(input),
-           static_cast<void*>(res.data()), sizeOfVec(res));
-    return {true, res};
+    return doWork(wlkx, write_input, read_output);
 }
 catch (const CnnException& exc)
 {
     std::cerr << "Failed to load cnn" << std::endl;
-    return {false, {}};
+    return false;
+}
+
+std::optional<bool> WorkersPool::tryGetCnnInfo(const InputWriter& write_input,
+                                               const OutputReader& read_output,
+                                               uint32_t wlkx)
+{
+    const int keep_free = (count > 1) ? 1 : 0;
+    int taken = -1;
+    if (shared_free_count != nullptr)
+    {
+        int free_now = 0;
+        sem_getvalue(shared_free_count, &free_now);
+        if (free_now <= keep_free) return std::nullopt;
+        taken = takeSharedWorker(false);
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        if (how_many_free <= keep_free) return std::nullopt;
+        taken = findWorker();
+    }
+    if (taken == -1) return std::nullopt;
+    return runOnWorker(taken, wlkx, write_input, read_output);
+}
+
+bool WorkersPool::warmUp(const InputWriter& write_input,
+                         const OutputReader& read_output, uint32_t wlkx)
+{
+    std::vector<int> taken;
+    if (shared_free_count != nullptr)
+    {
+        for (int w; (w = takeSharedWorker(false)) != -1;) taken.push_back(w);
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        while (how_many_free > 0) taken.push_back(findWorker());
+    }
+    bool success = not taken.empty() or (cnn and cnn->is_ready());
+    std::vector<std::future<bool>> results;
+    results.reserve(taken.size());
+    for (const int which : taken)
+        results.push_back(std::async(
+            std::launch::async, [this, which, wlkx, &write_input, &read_output]
+            { return runOnWorker(which, wlkx, write_input, read_output); }));
+    for (auto& r : results) success = r.get() and success;
+    return success;
+}
+
+void WorkersPool::shareWithForks()
+{
+    static_assert(std::atomic<int>::is_always_lock_free);
+    std::lock_guard<std::mutex> lock(jobs_mutex);
+    if (shared_free_count != nullptr or count == 0) return;
+    void* mem = create_shared_memory(sharedFreeSize());
+    if (mem == MAP_FAILED)
+        throw std::runtime_error("Error sharing the CNN workers");
+    auto* free_count = static_cast<sem_t*>(mem);
+    if (sem_init(free_count, 1, how_many_free) < 0)
+    {
+        munmap(mem, sharedFreeSize());
+        throw std::runtime_error("Error creating semaphore");
+    }
+    shared_is_free = reinterpret_cast<std::atomic<int>*>(free_count + 1);
+    for (int i = 0; i < count; ++i)
+        new (shared_is_free + i) std::atomic<int>(is_free[i]);
+    shared_free_count = free_count;
+}
+
+void WorkersPool::printRow(std::ostream& os, const std::string& name,
+                           const WorkerStats& st)
+{
+    const auto p50_p99 = [&os](const LatencyHistogram& h)
+    {
+        os << std::setw(9) << h.percentile(0.5) << std::setw(9)
+           << h.percentile(0.99);
+    };
+    os << std::setw(6) << name << std::setw(9) << st.forward.count();
+    p50_p99(st.queue_wait);
+    p50_p99(st.forward);
+    p50_p99(st.copy);
+    os << std::setw(6) << st.failures << std::setw(6) << st.timeouts
+       << std::setw(6) << st.respawns << "\n";
+}
+
+void WorkersPool::printStats(std::ostream& os) const
+{
+    os << "CNN pool " << config_file << ", " << alive << "/" << count
+       << " workers alive, times in micros (upper bounds):\n";
+    os << std::setw(6) << "worker" << std::setw(9) << "jobs";
+    for (const char* h : {"wait p50", "p99", "fwd p50", "p99", "copy p50",
+                          "p99"})
+        os << std::setw(9) << h;
+    os << std::setw(6) << "fail" << std::setw(6) << "tmout" << std::setw(6)
+       << "respn" << "\n";
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << std::fixed << std::setprecision(0);
+    if (use_this_thread) printRow(os, "this", this_thread_stats);
+    for (int i = 0; i < static_cast<int>(stats.size()); ++i)
+        printRow(os, "#" + std::to_string(i), *stats[i]);
+    os.flags(flags);
+    os.precision(precision);
+    os << std::flush;
 }
 
 std::unique_ptr<WorkersPoolBase> buildWorkerPool(const std::string& config_file,
@@ -26,17 +26,47 @@ protonmail (dot) com
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
-#include <vector>
+#include <optional>
+#include <ostream>
+#include <string>
 
 namespace workers
 {
+// InputWriter fills planes*wlkx*wlkx floats of input, OutputReader reads
+// wlkx*wlkx probabilities; both get pointers into the buffer used by the
+// network (for child workers, the shared memory), so that nothing is copied.
+using InputWriter = std::function<void(float* input)>;
+using OutputReader = std::function<void(const float* output)>;
+
 class WorkersPoolBase
 {
    public:
-    virtual std::pair<bool, std::vector<float>> getCnnInfo(
-        std::vector<float>& input, uint32_t wlkx) = 0;
+    virtual bool getCnnInfo(const InputWriter& write_input,
+                            const OutputReader& read_output,
+                            uint32_t wlkx) = 0;
+    // Low priority query: runs only if a worker is idle and, when there are
+    // more workers, another one stays idle for normal queries; otherwise
+    // returns std::nullopt at once.
+    virtual std::optional<bool> tryGetCnnInfo(const InputWriter& write_input,
+                                              const OutputReader& read_output,
+                                              uint32_t wlkx) = 0;
+    // Runs the query on all workers at once, so that each of them loads the
+    // net; returns true if all succeeded. read_output must be thread safe.
+    virtual bool warmUp(const InputWriter& write_input,
+                        const OutputReader& read_output, uint32_t wlkx) = 0;
+    // Lets the processes forked after it use the workers too, taking them
+    // from one list of free workers with this process; called while no
+    // query runs. Only this process starts the workers again.
+    virtual void shareWithForks() = 0;
     virtual int getPlanes() const = 0;
+    // number of queries that may run at the same time
+    virtual int getWorkers() const = 0;
+    // per worker: p50 and p99 of the wait for a free worker, of the forward
+    // time and of the time to copy the input and output, and the counts of
+    // failed, timed out and restarted queries
+    virtual void printStats(std::ostream& os) const = 0;
     virtual ~WorkersPoolBase() = default;
 };
 
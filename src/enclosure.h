@@ -74,6 +74,11 @@ struct Enclosure
     bool checkIfRedundant(pti p1) const;
     std::string show() const;
     std::string toSgfString() const;
+    template <class Archive>
+    void serialize(Archive &ar)
+    {
+        ar(interior, border);
+    }
 };
 
 extern Enclosure empty_enclosure;
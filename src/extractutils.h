@@ -34,6 +34,7 @@ Dyda, email: bartekdyda (at) protonmail (dot) com
 #include <string>
 
 //#include "allpattgen.h"
+#include "cnn_input.h"
 #include "game.h"
 #include "gzip.hpp"
 #include "patterns.h"
@@ -387,92 +388,8 @@ void gatherDataFromPosition(CompressedDataCont& compressed_data,
         Datum<CompressedDataCont::moves_used_v, CompressedDataCont::planes_v,
               CompressedDataCont::bsizex_v, CompressedDataCont::bsizey_v>
             datum;
-        auto& data = datum.boards;  // collector.getCurrentArray();
-        for (int x = 0; x < compressed_data.bsizex_v; ++x)
-            for (int y = 0; y < compressed_data.bsizey_v; ++y)
-            {
-                int p_orig = coord.ind(x, y);
-                int p = applyIsometryInverse(p_orig, isometry);
-                int on_move = game.whoNowMoves();
-                int opponent = 3 - on_move;
-                data[0][x][y] = (game.whoseDotMarginAt(p) == 0) ? 1.0f : 0.0f;
-                data[1][x][y] =
-                    (game.whoseDotMarginAt(p) == on_move) ? 1.0f : 0.0f;
-                data[2][x][y] =
-                    (game.whoseDotMarginAt(p) == opponent) ? 1.0f : 0.0f;
-                data[3][x][y] = game.isInTerr(p, on_move) > 0 ? 1.0f : 0.0f;
-                data[4][x][y] = game.isInTerr(p, opponent) > 0 ? 1.0f : 0.0f;
-                data[5][x][y] =
-                    std::min<pti>(game.isInEncl(p, on_move), 2) * 0.5f;
-                data[6][x][y] =
-                    std::min<pti>(game.isInEncl(p, opponent), 2) * 0.5f;
-                if (compressed_data.planes_v > 7)
-                {
-                    data[7][x][y] =
-                        std::min<pti>(game.isInBorder(p, on_move), 2) * 0.5f;
-                    data[8][x][y] =
-                        std::min<pti>(game.isInBorder(p, opponent), 2) * 0.5f;
-                    data[9][x][y] =
-                        std::min(game.getTotalSafetyOf(p), 2.0f) * 0.5f;
-                    if (compressed_data.planes_v > 10)
-                    {
-                        data[10][x][y] = (coord.dist[p] == 1) ? 1 : 0;
-                        //	data[11][x][y] = (coord.dist[p] == 4) ? 1 : 0;
-                        data[11][x][y] = 1;
-                        data[12][x][y] =
-                            0;  // where for thr such that opp_dots>0
-                        data[13][x][y] =
-                            0;  // where for thr such that opp_dots>0
-                        data[14][x][y] = 0;  // where0 for thr2 such that
-                                             // minwin2 > 0 and isSafe
-                        data[15][x][y] = 0;  // where0 for thr2 such that
-                                             // minwin2 > 0 and isSafe
-                        data[16][x][y] =
-                            (game.threats[on_move - 1].is_in_2m_encl[p] > 0)
-                                ? 1.0f
-                                : 0.0f;
-                        data[17][x][y] =
-                            (game.threats[opponent - 1].is_in_2m_encl[p] > 0)
-                                ? 1.0f
-                                : 0.0f;
-                        data[18][x][y] =
-                            (game.threats[on_move - 1].is_in_2m_miai[p] > 1)
-                                ? 1.0f
-                                : 0.0f;
-                        data[19][x][y] =
-                            (game.threats[opponent - 1].is_in_2m_miai[p] > 1)
-                                ? 1.0f
-                                : 0.0f;
-                    }
-                }
-            }
-        for (int player = 0; player < 2; ++player)
-        {
-            int which2 = (player + 1 == game.whoNowMoves()) ? 14 : 15;
-            if (which2 < compressed_data.planes_v)
-            {
-                for (auto& t : game.threats[player].threats2m)
-                {
-                    if (t.min_win2 && t.isSafe())
-                    {
-                        data[which2][coord.x[t.where0]][coord.y[t.where0]] =
-                            1.0f - std::pow(0.75f, t.min_win2);
-                    }
-                }
-            }
-            int which = (player + 1 == game.whoNowMoves()) ? 12 : 13;
-            if (which < compressed_data.planes_v)
-            {
-                for (auto& t : game.threats[player].threats)
-                {
-                    if (t.where && t.singular_dots)
-                    {
-                        data[which][coord.x[t.where]][coord.y[t.where]] =
-                            1.0f - std::pow(0.75f, t.singular_dots);
-                    }
-                }
-            }
-        }
+        cnn_input::encodePlanes<CompressedDataCont::planes_v>(
+            game, datum.boards.origin(), isometry);
 
         for (int m = 0; m < compressed_data.moves_used_v; ++m)
         {
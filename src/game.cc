@@ -26,16 +26,21 @@
 #include <cassert>
 #include <cmath>
 #include <cstdlib>  // abs()
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <list>  // ?
 #include <map>
 #include <memory>  // unique pointer
+#include <mutex>
+#include <optional>
 #include <queue>
 #include <set>
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 //#include <exception>
 #include <cctype>  // iswhite()
@@ -48,8 +53,11 @@
 #include "enclosure.h"
 #include "game.h"
 #include "group_neighbours.h"
+#include "logger.h"
 #include "montecarlo.h"
 #include "patterns.h"
+#include "playout_board.h"
+#include "profiler.h"
 #include "sgf.h"
 #include "threats.h"
 
@@ -58,16 +66,14 @@ Coord coord(15, 15);
 std::chrono::high_resolution_clock::time_point start_time =
     std::chrono::high_resolution_clock::now();  // to measure time, value only
                                                 // to use auto
-long long debug_nanos = 0;
-long long debug_nanos2 = 0;
-long long debug_nanos3 = 0;
 int debug_previous_count = 0;
 thread_local std::default_random_engine Game::engine;
 thread_local std::stringstream Game::out;
 
 namespace global
 {
-const Pattern3 patt3(global::program_path + "patterns.bin", 0);
+// read from program_path by the first Game, when the path is known
+Pattern3 patt3;
 const Pattern3 patt3_symm(
     {// hane pattern - enclosing hane
      "XOX"
@@ -377,12 +383,14 @@ Treenode &Treenode::operator=(const Treenode &other)
 {
     parent = other.parent;
     children = other.children.load();
+    game_ptr = other.game_ptr.load();
     t = other.t;
     amaf = other.amaf;
     prior = other.prior;
     move = other.move;
     flags = other.flags;
     cnn_prob = other.cnn_prob;
+    cnn_value = other.cnn_value.load();
     return *this;
 }
 
@@ -821,23 +829,27 @@ SgfTree Game::sgf_tree;
 Game::Game(SgfSequence seq, int max_moves, bool must_surround)
     : must_surround{must_surround}
 {
+    // retried by the next Game if it throws
+    static std::once_flag patterns_read;
+    std::call_once(patterns_read,
+                   []
+                   {
+                       global::patt3.readFromFile(global::program_path +
+                                                  "patterns.bin");
+                       global::patt3.setEmptyValue(0);
+                   });
     global::komi = 0;
     global::komi_ratchet = 10000;
     auto sz_pos = seq[0].findProp("SZ");
     std::string sz = (sz_pos != seq[0].props.end()) ? sz_pos->second[0] : "";
-    if (sz.find(':') == std::string::npos)
-    {
-        if (sz != "")
-        {
-            int x = stoi(sz);
-            coord.changeSize(x, x);
-        }
-    }
-    else
-    {
-        std::string::size_type i = sz.find(':');
-        int x = stoi(sz.substr(0, i));
-        int y = stoi(sz.substr(i + 1));
+    if (sz != "")
+    {
+        const std::string::size_type i = sz.find(':');
+        const int x = stoi(sz.substr(0, i));
+        const int y = (i == std::string::npos) ? x : stoi(sz.substr(i + 1));
+        // checked here, as the SGF may come from a client; Coord only asserts
+        if (x < 5 or y < 5 or x > Coord::maxx or y > Coord::maxy)
+            throw std::runtime_error("unsupported board size " + sz);
         coord.changeSize(x, y);
     }
 #ifdef DEBUG_SGF
@@ -1004,6 +1016,7 @@ std::vector<pti> Game::findThreats_preDot(pti ind, int who)
 // Each possible threat is a pair of pti's, first denote a point where to play,
 // second gives a code which neighbours may go inside.
 {
+    KROPLA_PROFILE_SCOPE(threats_pre_dot);
     std::vector<pti> possible_threats;
     Threat *smallest_terr = nullptr;
     unsigned int smallest_size = coord.maxSize;
@@ -1165,8 +1178,6 @@ std::vector<pti> Game::findThreats_preDot(pti ind, int who)
     // the new dot
     if (top >= 2)
     {
-        auto debug_time = std::chrono::high_resolution_clock::now();
-
         std::array<pti, 4> unique_groups = {0, 0, 0, 0};
         int ug = sg.getConnectsAt(ind, who).getUniqueGroups(unique_groups);
         if (ug >= 2)
@@ -1218,11 +1229,6 @@ std::vector<pti> Game::findThreats_preDot(pti ind, int who)
                 }
             }
         }
-
-        debug_nanos +=
-            std::chrono::duration_cast<std::chrono::nanoseconds>(
-                std::chrono::high_resolution_clock::now() - debug_time)
-                .count();
     }
     // check neighbours of [ind]
     for (int i = 0; i < 8; i++)
@@ -1419,6 +1425,7 @@ std::vector<pti> Game::findThreats2moves_preDot(pti ind, int who)
 // (The order is so that we may then pop_back two points, count and points to
 // enclose).
 {
+    KROPLA_PROFILE_SCOPE(threats2m_pre_dot);
     if (not threats[who - 1].isActiveThreats2m()) return {};
     std::vector<pti> possible_threats;
     // find groups in the neighbourhood
@@ -1502,8 +1509,6 @@ std::vector<pti> Game::findThreats2moves_preDot(pti ind, int who)
     // check 2 dots, the first close to ind, the second close to the first
     if (top >= 1 and top <= 3)
     {
-        auto debug_time = std::chrono::high_resolution_clock::now();
-
         // std::cerr << "ind = " << coord.showPt(ind) << std::endl;
         for (int i = 0; i < 8; i++)
         {
@@ -1672,11 +1677,6 @@ std::vector<pti> Game::findThreats2moves_preDot(pti ind, int who)
                 }
             }
         }
-
-        debug_nanos3 +=
-            std::chrono::duration_cast<std::chrono::nanoseconds>(
-                std::chrono::high_resolution_clock::now() - debug_time)
-                .count();
     }
 
     SmallMultimap<7, 7> pairs_pointCloseToInd_groupIdThatItTouches{};
@@ -1974,6 +1974,7 @@ void Game::checkThreat_terr(Threat *thr, pti p, int who,
 
 void Game::checkThreats_postDot(std::vector<pti> &newthr, pti ind, int who)
 {
+    KROPLA_PROFILE_SCOPE(threats_post_dot);
     assert(who == 1 || who == 2);
     /*
     // check our old threats  -- already in preDot
@@ -2199,13 +2200,10 @@ int Game::addThreat2moves(pti ind0, pti ind1, int who, Enclosure &&encl)
                                             isSafeFor(ind1, who), who, t);
 }
 
-int debug_allt2m = 0, debug_sing_smallt2m = 0, debug_sing_larget2m = 0,
-    debug_skippedt2m = 0;
-int debug_n = 0, debug_N = 0;
-
 void Game::checkThreats2moves_postDot(std::vector<pti> &newthr, pti ind,
                                       int who)
 {
+    KROPLA_PROFILE_SCOPE(threats2m_post_dot);
     if (not threats[who - 1].isActiveThreats2m()) return;
     // check our old threats
     for (auto &t2 : threats[who - 1].threats2m)
@@ -2311,16 +2309,10 @@ void Game::checkThreats2moves_postDot(std::vector<pti> &newthr, pti ind,
     // remove opponents threats that need to put dot at [ind] or marked as to be
     // removed
 
-    auto debug_time = std::chrono::high_resolution_clock::now();
-
     threats[2 - who].removeMarkedAndAtPoint2moves(ind);
     // remove our marked threats
     threats[who - 1].removeMarked2moves();
 
-    debug_nanos2 += std::chrono::duration_cast<std::chrono::nanoseconds>(
-                        std::chrono::high_resolution_clock::now() - debug_time)
-                        .count();
-
     // check new
     while (!newthr.empty())
     {
@@ -2337,7 +2329,7 @@ void Game::checkThreats2moves_postDot(std::vector<pti> &newthr, pti ind,
             CleanupOneVar<pti> worm_where_cleanup1(
                 &sg.worm[ind1], who);  //  sg.worm[ind1] = who;  with restored
                                        //  old value (0) by destructor
-            debug_allt2m++;
+            KROPLA_PROFILE_COUNT(threats2m_checked, 1);
             assert(!newthr.empty());
             int count = newthr.back();
             newthr.pop_back();
@@ -2349,7 +2341,7 @@ void Game::checkThreats2moves_postDot(std::vector<pti> &newthr, pti ind,
                  (isInEncl(ind0, who) > 0 || isInTerr(ind0, who) > 0)))
             {
                 newthr.resize(newthr.size() - count);
-                debug_skippedt2m++;
+                KROPLA_PROFILE_COUNT(threats2m_skipped, 1);
                 continue;
             }
 
@@ -2388,8 +2380,8 @@ void Game::checkThreats2moves_postDot(std::vector<pti> &newthr, pti ind,
                 //   which should have been found before move L.
                 // First pass: check for simple enclosures, maybe we can find
                 // one.
-                debug_n++;
-                debug_N += count;
+                KROPLA_PROFILE_COUNT(threats2m_encl_searches, 1);
+                KROPLA_PROFILE_COUNT(threats2m_encl_points, count);
                 // bool was_one = false;
                 for (int i = count; i > 0; --i)
                 {
@@ -2402,7 +2394,7 @@ void Game::checkThreats2moves_postDot(std::vector<pti> &newthr, pti ind,
                     {
                         addThreat2moves(ind0, ind1, who, std::move(encl));
                         // was_one = true;
-                        debug_sing_smallt2m++;
+                        KROPLA_PROFILE_COUNT(threats2m_small_singular, 1);
                         goto one_found;
                     }
                 }
@@ -2418,7 +2410,7 @@ void Game::checkThreats2moves_postDot(std::vector<pti> &newthr, pti ind,
                     {
                         addThreat2moves(ind0, ind1, who, std::move(encl));
                         // was_one = true;
-                        debug_sing_larget2m++;
+                        KROPLA_PROFILE_COUNT(threats2m_large_singular, 1);
                         goto one_found;
                     }
                 }
@@ -3577,8 +3569,11 @@ int Game::checkBorderOneSide(pti ind, pti viter, pti vnorm, int who) const
                       // second edge
 }
 
-void Game::rollout(Treenode *node, int /*depth*/)
+void Game::rollout(Treenode *node, int /*depth*/, real_t cnn_value,
+                   real_t cnn_weight,
+                   const std::function<void()> &before_backup)
 {
+    KROPLA_PROFILE_SCOPE(playout);
     // experiment: add loses to amaf inside opp enclosures; first remember empty
     // points
     // TODO: at this point we already do not know all empty points, there could
@@ -3594,16 +3589,40 @@ void Game::rollout(Treenode *node, int /*depth*/)
     }
     // we are at leaf, playout...
     auto nmoves = sg.getHistory().size();
-    real_t v = randomPlayout();
+    const bool use_cnn_value = (cnn_value >= 0 and cnn_weight > 0);
+    // a playout on the playout board leaves this Game at the leaf
+    std::optional<PlayoutBoard> board;
+    real_t v;
+    if (use_cnn_value and cnn_weight >= 1)
+    {
+        v = cnn_value;
+    }
+    else if (PlayoutBoard::isEnabled())
+    {
+        board.emplace(*this);
+        v = board->randomPlayout(engine);
+    }
+    else
+    {
+        v = randomPlayout();
+    }
+    if (use_cnn_value and cnn_weight < 1)
+        v = (1 - cnn_weight) * v + cnn_weight * cnn_value;
+    const History &history = board ? board->getHistory() : sg.getHistory();
+    auto marginAt = [&](pti p)
+    { return board ? board->whoseDotMarginAt(p) : whoseDotMarginAt(p); };
     auto lastWho = node->move.who;
-    // auto endmoves = std::min(sg.getHistory().size(), nmoves + 50);
-    auto endmoves = sg.getHistory().size();
+    // auto endmoves = std::min(history.size(), nmoves + 50);
+    auto endmoves = history.size();
     const int distance_rave = 3;
     const int distance_rave_TERR = 8;
     const int amaf_ENCL_BORDER = 16;
     const int distance_rave_SHIFT = 5;
     const int distance_rave_MASK = 7;
-    sg.updateGoodReplies(lastWho, v);
+    if (board)
+        board->updateGoodReplies(lastWho, v);
+    else
+        sg.updateGoodReplies(lastWho, v);
     {
         int distance_rave_threshhold = (endmoves - nmoves + 2) / distance_rave;
         int distance_rave_current = distance_rave_threshhold / 2;
@@ -3611,35 +3630,35 @@ void Game::rollout(Treenode *node, int /*depth*/)
         for (auto i = nmoves; i < endmoves; i++)
         {
             lastWho ^= 3;
-            amafboard[sg.getHistory().get(i)] =
+            amafboard[history.get(i)] =
                 lastWho | (distance_rave_weight << distance_rave_SHIFT) |
-                (sg.getHistory().isInTerrWithAtari(i) ? distance_rave_TERR
-                                                      : 0) |
-                (sg.getHistory().isInEnclBorder(i) ? amaf_ENCL_BORDER : 0);
+                (history.isInTerrWithAtari(i) ? distance_rave_TERR : 0) |
+                (history.isInEnclBorder(i) ? amaf_ENCL_BORDER : 0);
             if (--distance_rave_current == 0)
             {
                 distance_rave_current = distance_rave_threshhold;
                 if (distance_rave_weight > 1) --distance_rave_weight;
             }
-            assert(coord.dist[sg.getHistory().get(i)] >= 1 ||
-                   (whoseDotMarginAt(sg.getHistory().get(i)) == lastWho));
+            assert(coord.dist[history.get(i)] >= 1 ||
+                   (marginAt(history.get(i)) == lastWho));
         }
         // experiment: add loses to amaf inside opp enclosures
         for (auto i = coord.first; i <= coord.last; i++)
         {
             if (amafboard[i] == amaf_empty)
             {
-                int who = whoseDotMarginAt(i);
+                int who = marginAt(i);
                 if (who == 0)
                 {
                     // here add inside territories, it's important when playouts
                     // stop playing before the end
-                    if (threats[0].is_in_terr[i] > 0)
+                    if (board)
+                        who = board->whosePoolAt(i);
+                    else if (threats[0].is_in_terr[i] > 0)
                         who = 1;
                     else if (threats[1].is_in_terr[i] > 0)
                         who = 2;
-                    else
-                        who = -1;  // dame!
+                    if (who == 0) who = -1;  // dame!
                 }
                 if (who)
                 {
@@ -3654,6 +3673,7 @@ void Game::rollout(Treenode *node, int /*depth*/)
         }
     }
     // save playout outcome to t and amaf statistics
+    if (before_backup) before_backup();
     for (;;)
     {
         auto move_ind = node->move.ind;
@@ -3964,6 +3984,7 @@ void Game::placeDot(int x, int y, int who)
 // places a dot of who at (x,y),
 // TODO: if rules:must-surround, then also makes necessary enclosures
 {
+    KROPLA_PROFILE_SCOPE(place_dot);
     const pti ind = coord.ind(x, y);
     assert(sg.worm[ind] == 0);
     recalculate_list.clear();
@@ -4024,9 +4045,13 @@ void Game::placeDot(int x, int y, int who)
 void Game::show() const
 {
     //  std::cerr << coord.showBoard(sg.worm);  // sg.worm.data()); ?
-    std::cerr << coord.showColouredBoardWithDots(sg.worm);
-    std::cerr << "Score: " << sg.score[0].show() << "; " << sg.score[1].show()
-              << std::endl;
+    std::cerr << showString() << std::endl;
+}
+
+std::string Game::showString() const
+{
+    return coord.showColouredBoardWithDots(sg.worm) +
+           "Score: " + sg.score[0].show() + "; " + sg.score[1].show();
 }
 
 void Game::show(const std::vector<pti> &moves) const
@@ -5054,8 +5079,8 @@ void Game::makeEnclosure(const Enclosure &encl, bool remove_it_from_threats)
             pti nb = p + coord.nb8[i];
             if (nb == coord.ind(18, 16))
             {
-                std::cout << "Being at (18,16), stack[nb]==" << stack[nb]
-                          << std::endl;
+                KROPLA_LOG(debug)
+                    << "Being at (18,16), stack[nb]==" << stack[nb];
             }
             if (stack[nb] == 0)
             {
@@ -5093,6 +5118,7 @@ void Game::makeEnclosure(const Enclosure &encl, bool remove_it_from_threats)
 
 std::pair<int, int> Game::countTerritory(int now_moves) const
 {
+    KROPLA_PROFILE_SCOPE(scoring);
     const int ct_B = 1;
     const int ct_W = 2;
     const int ct_NOT_TERR_B = 4;
@@ -5253,6 +5279,7 @@ std::pair<int, int> Game::countTerritory(int now_moves) const
 /// not intersect.
 std::pair<int, int> Game::countTerritory_simple(int now_moves) const
 {
+    KROPLA_PROFILE_SCOPE(scoring);
     // count points ignoring pools that are included in bigger pools
     std::set<pti> marks;
     int delta_score[4] = {0, 0, 0, 0};  // dots of 0,1, terr of 0,1
@@ -5661,6 +5688,284 @@ void Game::makeMoveWithPointsToEnclose(
     }
 }
 
+/********************************************************************************************************
+  Undo journal: the fields of the state of the game are listed in the order of
+serialize(), entering the classes and the arrays, which have the same shape in
+every game, so that the fields of two games can be compared one by one. A
+field is a value, a vector, a map, a list or a pointer.
+*********************************************************************************************************/
+namespace
+{
+struct Field;
+
+class FieldLister
+{
+   public:
+    std::vector<Field> fields;
+    template <class... T>
+    void operator()(T &...values)
+    {
+        (add(values), ...);
+    }
+
+   private:
+    template <class T>
+    void add(T &value);
+};
+
+template <class T>
+concept Serializable = requires(T &t, FieldLister &ar) { t.serialize(ar); };
+
+template <class T>
+struct IsVector : std::false_type
+{
+};
+template <class T, class A>
+struct IsVector<std::vector<T, A>> : std::true_type
+{
+};
+
+template <class T>
+struct IsUnorderedMap : std::false_type
+{
+};
+template <class K, class V, class H, class E, class A>
+struct IsUnorderedMap<std::unordered_map<K, V, H, E, A>> : std::true_type
+{
+};
+
+template <class T>
+struct IsSharedPtr : std::false_type
+{
+};
+template <class T>
+struct IsSharedPtr<std::shared_ptr<T>> : std::true_type
+{
+};
+
+template <class T>
+struct IsStdArray : std::false_type
+{
+};
+template <class T, std::size_t N>
+struct IsStdArray<std::array<T, N>> : std::true_type
+{
+};
+
+using Changes = std::vector<Game::UndoJournal::Change>;
+
+struct Field
+{
+    void *ptr;
+    bool (*equal)(const void *a, const void *b);
+    // adds to changes how to write the value of *before back to the field
+    // number index, whose value is *live now, if they differ
+    void (*record)(const void *live, void *before, std::size_t index,
+                   Changes &changes);
+};
+
+template <class T>
+bool equalValues(const T &a, const T &b);
+
+template <class T>
+bool equalFields(const void *a, const void *b)
+{
+    return equalValues(*static_cast<const T *>(a), *static_cast<const T *>(b));
+}
+
+template <class T>
+void recordChange(const void *live, void *before, std::size_t index,
+                  Changes &changes);
+
+template <class T>
+void FieldLister::add(T &value)
+{
+    if constexpr (std::is_trivially_copyable_v<T> or IsVector<T>::value or
+                  IsUnorderedMap<T>::value or IsSharedPtr<T>::value)
+    {
+        fields.push_back({&value, &equalFields<T>, &recordChange<T>});
+    }
+    else if constexpr (std::is_array_v<T> or IsStdArray<T>::value)
+    {
+        for (auto &v : value) add(v);
+    }
+    else if constexpr (Serializable<T>)
+        value.serialize(*this);
+    else
+        fields.push_back({&value, &equalFields<T>, &recordChange<T>});
+}
+
+// the fields of a const object; serialize() is not const, as it is also used
+// to load
+template <class T>
+std::vector<Field> listFields(const T &object)
+{
+    FieldLister lister;
+    const_cast<T &>(object).serialize(lister);
+    return lister.fields;
+}
+
+template <class T>
+bool equalValues(const T &a, const T &b)
+{
+    if constexpr (std::is_trivially_copyable_v<T>)
+        return std::memcmp(&a, &b, sizeof(T)) == 0;
+    else if constexpr (IsSharedPtr<T>::value)
+        return a == b or (a and b and equalValues(*a, *b));
+    else if constexpr (IsUnorderedMap<T>::value)
+    {
+        if (a.size() != b.size()) return false;
+        for (const auto &[key, value] : a)
+        {
+            const auto it = b.find(key);
+            if (it == b.end() or not equalValues(value, it->second))
+                return false;
+        }
+        return true;
+    }
+    else if constexpr (Serializable<T>)
+    {
+        const auto fa = listFields(a);
+        const auto fb = listFields(b);
+        for (std::size_t i = 0; i < fa.size(); ++i)
+            if (not fa[i].equal(fa[i].ptr, fb[i].ptr)) return false;
+        return true;
+    }
+    else  // vectors, lists, arrays and the small vectors of WormDescr
+        return std::equal(std::begin(a), std::end(a), std::begin(b),
+                          std::end(b), [](const auto &x, const auto &y)
+                          { return equalValues(x, y); });
+}
+
+// Vectors keep their changed cells and maps their changed entries; other
+// fields are kept whole if they changed. The old values are moved out of
+// *before.
+template <class T>
+void recordChange(const void *live, void *before, std::size_t index,
+                  Changes &changes)
+{
+    const T &now = *static_cast<const T *>(live);
+    T &old = *static_cast<T *>(before);
+    if constexpr (IsVector<T>::value)
+    {
+        std::vector<std::pair<std::size_t, typename T::value_type>> cells;
+        for (std::size_t i = 0; i < old.size(); ++i)
+            if (i >= now.size() or not equalValues(now[i], old[i]))
+                cells.emplace_back(i, std::move(old[i]));
+        if (cells.empty() and now.size() == old.size()) return;
+        changes.push_back({index, [size = old.size(), cells = std::move(cells)](
+                                      void *p)
+                           {
+                               T &v = *static_cast<T *>(p);
+                               v.resize(size);
+                               for (const auto &[i, value] : cells)
+                                   v[i] = value;
+                           }});
+    }
+    else if constexpr (IsUnorderedMap<T>::value)
+    {
+        std::vector<typename T::key_type> added;
+        std::vector<std::pair<typename T::key_type, typename T::mapped_type>>
+            entries;
+        for (const auto &[key, value] : old)
+        {
+            const auto it = now.find(key);
+            if (it == now.end() or not equalValues(it->second, value))
+                entries.emplace_back(key, value);
+        }
+        for (const auto &entry : now)
+            if (not old.contains(entry.first)) added.push_back(entry.first);
+        if (added.empty() and entries.empty()) return;
+        changes.push_back({index, [added = std::move(added),
+                                   entries = std::move(entries)](void *p)
+                           {
+                               T &m = *static_cast<T *>(p);
+                               for (const auto &key : added) m.erase(key);
+                               // the values may be not assignable
+                               for (const auto &[key, value] : entries)
+                               {
+                                   m.erase(key);
+                                   m.emplace(key, value);
+                               }
+                           }});
+    }
+    else if constexpr (std::is_trivially_copyable_v<T>)
+    {
+        if (equalValues(now, old)) return;
+        std::array<unsigned char, sizeof(T)> bytes;
+        std::memcpy(bytes.data(), &old, sizeof(T));
+        changes.push_back({index, [bytes](void *p)
+                           { std::memcpy(p, bytes.data(), sizeof(T)); }});
+    }
+    else
+    {
+        if (equalValues(now, old)) return;
+        const auto value = std::make_shared<const T>(std::move(old));
+        changes.push_back(
+            {index, [value](void *p) { *static_cast<T *>(p) = *value; }});
+    }
+}
+}  // namespace
+
+void Game::makeSgfMoveWithUndo(const std::string &m, int who)
+{
+    makeWithUndo([&] { makeSgfMove(m, who); });
+}
+
+void Game::makeMoveWithUndo(const Move &m)
+{
+    makeWithUndo([&] { makeMove(m); });
+}
+
+// The state before the move is copied only to find what the move changes:
+// the journal keeps just that.
+void Game::makeWithUndo(const std::function<void()> &make)
+{
+    Game before = *this;
+    Changes changes;
+    const auto findChanges = [&]
+    {
+        const auto now_fields = listFields(*this);
+        const auto old_fields = listFields(before);
+        for (std::size_t i = 0; i < now_fields.size(); ++i)
+            now_fields[i].record(now_fields[i].ptr, old_fields[i].ptr, i,
+                                 changes);
+    };
+    try
+    {
+        make();
+    }
+    catch (...)
+    {
+        findChanges();
+        undoChanges(changes);
+        throw;
+    }
+    findChanges();
+    undo_journal.moves.push_back(std::move(changes));
+    if (undo_journal.moves.size() > max_undo_depth)
+        undo_journal.moves.pop_front();
+}
+
+void Game::undoChanges(const std::vector<UndoJournal::Change> &changes)
+{
+    const auto fields = listFields(*this);
+    for (const auto &change : changes) change.restore(fields[change.field].ptr);
+}
+
+bool Game::unmakeMove()
+{
+    if (undo_journal.moves.empty()) return false;
+    undoChanges(undo_journal.moves.back());
+    undo_journal.moves.pop_back();
+    return true;
+}
+
+bool Game::hasSameStateAs(const Game &other) const
+{
+    return equalValues(*this, other);
+}
+
 pti Game::isInTerr(pti ind, int who) const
 {
     return threats[who - 1].is_in_terr[ind];
@@ -6369,6 +6674,7 @@ Move Game::getRandomEncl(Move &m)
 /// This function selects enclosures using Game:::chooseRandomEncl().
 Move Game::chooseAtariMove(int who, pti forbidden_place)
 {
+    KROPLA_PROFILE_SCOPE(atari_move);
     krb::SmallVector<pti, 16>::allocator_type::arena_type arena_urgent;
     krb::SmallVector<pti, 16> urgent{arena_urgent};  //, non_urgent;
     for (auto &t : threats[who - 1].threats)
@@ -6484,6 +6790,7 @@ Move Game::chooseAtariMove(int who, pti forbidden_place)
 /// This function selects enclosures using Game:::chooseRandomEncl().
 Move Game::chooseAtariResponse(pti lastMove, int who, pti forbidden_place)
 {
+    KROPLA_PROFILE_SCOPE(atari_response);
     krb::SmallVector<pti, 16>::allocator_type::arena_type arena_urgent;
     krb::SmallVector<pti, 16> urgent{arena_urgent};
     for (auto &t : threats[2 - who].threats)
@@ -6577,6 +6884,7 @@ Move Game::chooseAtariResponse(pti lastMove, int who, pti forbidden_place)
 /// This function selects enclosures using Game:::chooseRandomEncl().
 Move Game::chooseSoftSafetyResponse(int who, pti forbidden_place)
 {
+    KROPLA_PROFILE_SCOPE(soft_safety_response);
     auto responses = sg.safety_soft.getCurrentlyAddedSugg();
     return selectMoveRandomlyFrom(responses[who - 1], who, forbidden_place);
 }
@@ -6584,6 +6892,7 @@ Move Game::chooseSoftSafetyResponse(int who, pti forbidden_place)
 /// This function selects enclosures using Game:::chooseRandomEncl().
 Move Game::chooseSoftSafetyContinuation(int who, pti forbidden_place)
 {
+    KROPLA_PROFILE_SCOPE(soft_safety_continuation);
     auto responses = sg.safety_soft.getPreviouslyAddedSugg();
     return selectMoveRandomlyFrom(responses[who - 1], who, forbidden_place);
 }
@@ -6626,6 +6935,7 @@ Move Game::selectMoveRandomlyFrom(const std::vector<pti> &moves, int who,
 Move Game::choosePattern3Move(pti move0, pti move1, int who,
                               pti forbidden_place)
 {
+    KROPLA_PROFILE_SCOPE(pattern3);
     Move move;
     move.who = who;
     typedef std::pair<pti, pattern3_val> MoveValue;
@@ -6827,6 +7137,7 @@ std::vector<pti> Game::getSafetyMoves(int /*who*/, pti forbidden_place)
 
 Move Game::chooseSafetyMove(int who, pti forbidden_place)
 {
+    KROPLA_PROFILE_SCOPE(safety_move);
     Move move;
     move.who = who;
     const auto stack = getSafetyMoves(who, forbidden_place);
@@ -6938,6 +7249,7 @@ std::vector<pti> Game::getGoodTerrMoves(int who) const
 /// Chooses any move using possible_moves.
 Move Game::chooseAnyMove_pm(int who, pti /*forbidden_place*/)
 {
+    KROPLA_PROFILE_SCOPE(any_move);
     Move move;
     move.who = who;
     assert(checkPossibleMovesCorrectness());
@@ -7037,6 +7349,7 @@ Move Game::chooseAnyMove_pm(int who, pti /*forbidden_place*/)
 /// Chooses interesting_move.
 Move Game::chooseInterestingMove(int who, pti forbidden_place)
 {
+    KROPLA_PROFILE_SCOPE(interesting_move);
     Move move;
     move.who = who;
     int which_list = InterestingMovesConsts::LIST_0;
@@ -7060,6 +7373,7 @@ Move Game::chooseInterestingMove(int who, pti forbidden_place)
 
 Move Game::chooseLastGoodReply(int who, pti forbidden_place)
 {
+    KROPLA_PROFILE_SCOPE(last_good_reply);
     Move move;
     move.who = who;
     move.ind = sg.getHistory().getLastGoodReplyFor(who);
@@ -7097,6 +7411,7 @@ std::pair<pti, pti> Game::checkLadderToFindBadOrGoodMoves() const
 // ladder), otherwise, current player should play forced_move and then the other
 // not at forbidden
 {
+    KROPLA_PROFILE_SCOPE(ladder_check);
     int opponent = 3 - sg.nowMoves;
     uint16_t last_move_no = sg.getHistory().size();
     const int min_value_threshold = 3;
@@ -7176,24 +7491,24 @@ real_t Game::randomPlayout()
                     makeMove(getRandomEncl(forced_move));
                     if (not isInEncl(next_def, 3 - sg.nowMoves))
                         forbidden_place = next_def;
-                    std::cout
+                    KROPLA_LOG(debug)
                         << "-*-*-* Working ladder defended at "
                         << coord.showPt(sg.getHistory().getLast())
                         << ", forced move: " << coord.showPt(forced_move.ind)
                         << ", forbidden: " << coord.showPt(forbidden_place)
-                        << '\n';
-                    show();
+                        << '\n'
+                        << showString();
                     continue;
                 }
                 if (status == ESC_WINS and not isInEncl(next_att, sg.nowMoves))
                 {
                     forbidden_place = next_att;
-                    std::cout
+                    KROPLA_LOG(debug)
                         << "-*-*-*%^%^ Non-working ladder defended at "
                         << coord.showPt(sg.getHistory().getLast())
                         << ", forbidden: " << coord.showPt(forbidden_place)
-                        << '\n';
-                    show();
+                        << '\n'
+                        << showString();
                 }
             }
         }
@@ -7391,22 +7706,7 @@ real_t Game::randomPlayout()
     }
     // std::cerr << std::endl;
     auto [res, res_small] = countTerritory_simple(sg.nowMoves);
-    real_t win_value;
-    if (res == 0)
-    {
-        const real_t scale = 0.04;
-        win_value = 0.5 + scale * res_small;
-    }
-    else
-    {
-        int range = (coord.wlkx + coord.wlky) / 2;
-        const real_t scale = 0.04;
-        real_t scaled_score =
-            scale * std::max(std::min(real_t(res + 0.5 * res_small) / range,
-                                      real_t(1.0)),
-                             real_t(-1.0));
-        win_value = (res > 0) * (1 - 2 * scale) + scale + scaled_score;
-    }
+    const real_t win_value = winValueOfScore(res, res_small);
 #ifdef DEBUG_SGF
     sgf_tree.addComment(std::string("res=") + std::to_string(res) +
                         std::string(" v=") + std::to_string(win_value));
@@ -7415,6 +7715,21 @@ real_t Game::randomPlayout()
     return win_value;
 }
 
+real_t Game::winValueOfScore(int res, int res_small)
+{
+    const real_t scale = 0.04;
+    if (res == 0)
+    {
+        return 0.5 + scale * res_small;
+    }
+    int range = (coord.wlkx + coord.wlky) / 2;
+    real_t scaled_score =
+        scale * std::max(std::min(real_t(res + 0.5 * res_small) / range,
+                                  real_t(1.0)),
+                         real_t(-1.0));
+    return (res > 0) * (1 - 2 * scale) + scale + scaled_score;
+}
+
 /// This function checks if p is an interesting move, because of a change of its
 /// pattern3_value or atari.
 int Game::checkInterestingMove(pti p) const
@@ -26,8 +26,11 @@
 
 #include <atomic>
 #include <chrono>
+#include <deque>
+#include <functional>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <random>
 #include <set>
@@ -95,6 +98,10 @@ struct Treenode
     Move move;
     uint32_t flags{0};
     float cnn_prob{-1.0};
+    // value of the position after move from the value head of the CNN, for
+    // player 1 in [0, 1] as playout results, set with the priors of the
+    // children; negative if not evaluated or the net has no value head
+    std::atomic<float> cnn_value{-1.0f};
     std::mutex children_mutex;
     static const uint32_t LAST_CHILD = 0x10000;
     static const uint32_t IS_DAME = 0x20000;
@@ -154,6 +161,7 @@ class TreenodeAllocator
     Treenode* getLastBlockWithoutResetting() const;
     void copyPrevious();
     static int getSize(Treenode* ch);
+    std::size_t capacity() const { return pools.size() * pool_size; }
 };
 
 /********************************************************************************************************
@@ -195,6 +203,11 @@ class PossibleMoves
 
     void generate();
     void changeMove(pti p, int new_type);
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(mtype, lists, left, top, right, bottom);
+    }
 };
 
 /********************************************************************************************************
@@ -229,6 +242,11 @@ class InterestingMoves
     void generate();
     void changeMove(pti p, int new_type);
     int classOfMove(pti p) const;
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(mtype, lists);
+    }
 };
 
 class Game
@@ -259,6 +277,32 @@ class Game
     static const int COEFF_NONURGENT = 1;
     bool must_surround{false};
     uint64_t zobrist{0};
+
+   public:
+    // What the last moves made with undo changed (the latest at the back):
+    // for each field of serialize() that a move changed, a function writing
+    // back its old value, which keeps only the changed cells of vectors and
+    // entries of maps. It is not copied with the game, so that the copies
+    // made by the search do not pay for it.
+    struct UndoJournal
+    {
+        struct Change
+        {
+            std::size_t field;  // number in the order of serialize()
+            std::function<void(void*)> restore;
+        };
+        UndoJournal() = default;
+        UndoJournal(const UndoJournal&) {}
+        UndoJournal& operator=(const UndoJournal&)
+        {
+            moves.clear();
+            return *this;
+        }
+        std::deque<std::vector<Change>> moves;
+    };
+
+   private:
+    UndoJournal undo_journal;
     // for debugging:
     static thread_local std::stringstream out;
 
@@ -294,6 +338,9 @@ class Game
         const SmallMultiset<pti, 4>& connected_groups, pti ind, int who) const;
     void checkThreat_encl(Threat* thr, int who);
     bool checkIfThreat_encl_isUnnecessary(Threat* thr, pti ind, int who) const;
+    // calls make() and journals what it changed, see makeMoveWithUndo()
+    void makeWithUndo(const std::function<void()>& make);
+    void undoChanges(const std::vector<UndoJournal::Change>& changes);
     void checkThreat_terr(Threat* thr, pti p, int who,
                           std::vector<int8_t>* done = nullptr);
     void checkThreats_postDot(std::vector<pti>& newthr, pti ind, int who);
@@ -363,6 +410,17 @@ class Game
     void makeMove(const Move& m);
     void makeMoveWithPointsToEnclose(
         const Move& m, const std::vector<std::string>& to_enclose);
+    // at most that many last moves may be unmade
+    static constexpr std::size_t max_undo_depth = 128;
+    // As makeSgfMove and makeMove, but what the move changes is journaled for
+    // unmakeMove(). If the move throws, the game is left as it was.
+    void makeSgfMoveWithUndo(const std::string& m, int who);
+    void makeMoveWithUndo(const Move& m);
+    // Takes back the last move made with undo, writing back only what it
+    // changed. Returns false if there is no such move (e.g., it was more than
+    // max_undo_depth moves ago, or the game was copied or assigned since).
+    bool unmakeMove();
+    std::size_t undoDepth() const { return undo_journal.moves.size(); }
     bool isDotAt(pti ind) const { return sg.isDotAt(ind); }
     int whoseDotMarginAt(pti ind) const { return sg.whoseDotMarginAt(ind); }
     int whoseDotAt(pti ind) const { return sg.whoseDotAt(ind); }
@@ -432,7 +490,15 @@ class Game
     Move getLastMove() const;
     Move getLastButOneMove() const;
     real_t randomPlayout();
-    void rollout(Treenode* node, int depth);
+    // the value for player 1 of the final score of a playout
+    static real_t winValueOfScore(int res, int res_small);
+    // cnn_value (negative if unknown) is mixed into the playout result with
+    // weight cnn_weight; the playout is skipped if the weight is >= 1;
+    // before_backup, if given, is called before the result is added to the
+    // statistics of node and its ancestors
+    void rollout(Treenode* node, int depth, real_t cnn_value = -1.0,
+                 real_t cnn_weight = 0.0,
+                 const std::function<void()>& before_backup = {});
 
     std::default_random_engine& getRandomEngine();
 
@@ -456,6 +522,8 @@ class Game
         return threats[who];
     }
     void show() const;
+    // the board with dots and the score, as show() prints it
+    std::string showString() const;
     void show(const std::vector<pti>& moves) const;
     void showSvg(const std::string& filename,
                  const std::vector<pti>& tab) const;
@@ -464,7 +532,19 @@ class Game
 
     std::string showDescr(pti p) const { return sg.descr.at(p).show(); }
 
+    // The state of the game, for snapshot::save() and load() and for the undo
+    // journal. The buffers of generateListOfMoves() are not part of it.
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(sg, threats, possible_moves, interesting_moves, pattern3_value,
+           pattern3_at, update_soft_safety, dame_moves_so_far, must_surround,
+           zobrist);
+    }
+
     // debug/test functions
+    // whether the states (the fields of serialize()) are equal
+    bool hasSameStateAs(const Game& other) const;
     const std::vector<std::shared_ptr<Enclosure>>& getMlEnclMoves() const;
     const std::vector<ThrInfo>& getMlPriorities() const;
     const std::vector<uint64_t>& getMlEnclZobrists() const;
@@ -475,7 +555,7 @@ class Game
 
 namespace global
 {
-extern const Pattern3 patt3;
+extern Pattern3 patt3;  // from patterns.bin in program_path
 extern const Pattern3 patt3_symm;
 extern int komi;  // added to terr points of white (i.e. > 0 -> good for white),
                   // komi=2 -> 1 dot
@@ -483,12 +563,6 @@ extern int komi_ratchet;
 extern std::string program_path;
 }  // namespace global
 
-extern int debug_allt2m, debug_sing_smallt2m, debug_sing_larget2m,
-    debug_skippedt2m;
-extern int debug_n, debug_N;
-extern long long debug_nanos;
-extern long long debug_nanos2;
-extern long long debug_nanos3;
 extern int debug_previous_count;
 
 extern std::chrono::high_resolution_clock::time_point start_time;
@@ -30,27 +30,185 @@
 
 #include "get_cnn_prob.h"
 
+#include <unistd.h>
+
 #include "cnn_hash_table.h"
+#include "cnn_input.h"
+#include "cnn_router.h"
 #include "cnn_workers.h"
+#include "logger.h"
+#include "profiler.h"
+#include "trace.h"
 
 //#include "board.h"
 
-#include <boost/multi_array.hpp>
+#include <algorithm>
+#include <atomic>
 #include <chrono>  // chrono::high_resolution_clock, only to measure elapsed time
 #include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <mutex>
+#include <span>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <tuple>
+
+void writeInputForCnn(const Game& game, int planes, float* input);
+CnnInfo convertToBoard(const float* res);
 
 namespace
 {
-using Array3dim = boost::multi_array<float, 3>;
-using Array3dimRef = boost::multi_array_ref<float, 3>;
-int planes{0};
-std::unique_ptr<workers::WorkersPoolBase> workers_pool = nullptr;
-int planes2{0};
-std::unique_ptr<workers::WorkersPoolBase> workers_pool2 = nullptr;
+// Deleted only by the process that made it. A process forked afterwards
+// (a job of kropla_regress) has a copy without its threads, so it could
+// neither stop them nor destroy the condition variables they wait on.
+template <typename T>
+std::shared_ptr<T> ownedByThisProcess(T* object)
+{
+    return std::shared_ptr<T>(object,
+                              [owner = getpid()](T* p)
+                              {
+                                  if (getpid() == owner) delete p;
+                              });
+}
+
+struct CnnModel
+{
+    std::shared_ptr<workers::WorkersPoolBase> pool;
+    int planes;
+    // key of the results in the hash table, new for every loaded net, so
+    // that results of a replaced net are never served
+    int ht_key;
+};
+using CnnModels = std::vector<CnnModel>;
+// in the order of the router, (*models)[0] is the primary one; reloadCnn
+// replaces all of them at once, queries keep the set they started with, so
+// old workers exit after their last query
+std::atomic<std::shared_ptr<const CnnModels>> models{nullptr};
+std::unique_ptr<CnnRouter> router = nullptr;
+std::atomic<bool> reload_requested{false};
+// steady clock time in microseconds, 0 when there is no deadline
+std::atomic<int64_t> deadline_micros{0};
+
+int64_t nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// Speculatively evaluates, with the primary CNN, the positions after the
+/// most probable moves of freshly expanded nodes, so that their own
+/// expansion later finds the result in the hash table. Runs in its own
+/// thread and uses the workers only when some are idle.
+class Prefetcher
+{
+   public:
+    explicit Prefetcher(int top_k)
+        : top_k{top_k}, thread{[this] { run(); }}
+    {
+    }
+    ~Prefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> l(mutex);
+            stop = true;
+        }
+        cv.notify_one();
+        thread.join();
+    }
+    void enqueue(const Game& game, const Treenode* children);
+
+   private:
+    struct Job
+    {
+        std::shared_ptr<const Game> parent;
+        Move move;
+    };
+    void run();
+
+    // older jobs are for positions that the search has probably left
+    static constexpr std::size_t max_jobs = 64;
+    const int top_k;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop{false};
+    std::thread thread;
+};
+
+void Prefetcher::enqueue(const Game& game, const Treenode* children)
+{
+    std::vector<const Treenode*> best;
+    for (auto* ch = children; true; ++ch)
+    {
+        if (not ch->isDame() and ch->cnn_prob > 0.0f) best.push_back(ch);
+        if (ch->isLast()) break;
+    }
+    const auto k = std::min<std::size_t>(top_k, best.size());
+    if (k == 0) return;
+    std::partial_sort(best.begin(), best.begin() + k, best.end(),
+                      [](const Treenode* a, const Treenode* b)
+                      { return a->cnn_prob > b->cnn_prob; });
+    auto parent = std::make_shared<const Game>(game);
+    {
+        std::lock_guard<std::mutex> l(mutex);
+        // the best move goes last, as jobs are taken from the back
+        for (auto i = k; i-- > 0;) jobs.push_back(Job{parent, best[i]->move});
+        while (jobs.size() > max_jobs) jobs.pop_front();
+    }
+    cv.notify_one();
+}
+
+void Prefetcher::run()
+{
+    trace::setThreadName("cnn prefetch");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        cv.wait(lock, [this] { return stop or not jobs.empty(); });
+        if (stop) return;
+        Job job = std::move(jobs.back());
+        jobs.pop_back();
+        lock.unlock();
+        Game game = *job.parent;
+        job.parent.reset();
+        game.makeMove(job.move);
+        const auto pos = Position{game.getHistory().size(), game.getZobrist()};
+        const auto current = models.load();
+        const CnnModel& model = current->front();
+        while (not isCnnInfoInHT(pos, model.ht_key))
+        {
+            CnnInfo res{};
+            const auto success = model.pool->tryGetCnnInfo(
+                [&game, &model](float* input)
+                { writeInputForCnn(game, model.planes, input); },
+                [&res](const float* output) { res = convertToBoard(output); },
+                coord.wlkx);
+            if (success)
+            {
+                if (*success)
+                    saveCnnInfo(pos, std::move(res), true, model.ht_key);
+                break;
+            }
+            // all workers busy with normal queries
+            std::unique_lock<std::mutex> l(mutex);
+            if (cv.wait_for(l, std::chrono::milliseconds(1),
+                            [this] { return stop; }))
+                return;
+        }
+        lock.lock();
+    }
+}
+
+// declared after the pools, so that it is destroyed before them
+std::shared_ptr<Prefetcher> prefetcher = nullptr;
 
 }  // namespace
 
@@ -59,165 +217,306 @@ namespace global
 extern std::string program_path;
 }  // namespace global
 
-void initialiseCnn()
+namespace
 {
-    // not thread safe
-    static bool workers_active = false;
-    if (not workers_active)
+/// Reads cnnrouter.config, a line per model in the order of preference:
+///   <config file> <max depth, -1 for any> [<initial forward time in ms>]
+/// Without it, cnn.config is used up to depth 4 and cnn2.config deeper.
+std::vector<CnnRouter::Model> readRouterConfig()
+{
+    std::vector<CnnRouter::Model> result;
+    std::ifstream config(global::program_path + "cnnrouter.config");
+    std::string line;
+    while (std::getline(config, line))
     {
-        constexpr int max_planes = 20;
-        const std::size_t memory_needed =
-            coord.maxSize * sizeof(float) * max_planes + sizeof(uint32_t);
-        const bool use_this_thread = false;
-        workers_pool = workers::buildWorkerPool(
-            global::program_path + "cnn.config", memory_needed, coord.wlkx,
-            use_this_thread);
-        planes = workers_pool->getPlanes();
-        workers_pool2 = workers::buildWorkerPool(
-            global::program_path + "cnn2.config", memory_needed, coord.wlkx,
-            use_this_thread);
-        planes2 = workers_pool2->getPlanes();
-        workers_active = true;
+        std::istringstream in(line);
+        CnnRouter::Model model;
+        double cost_ms = 0.0;
+        if (not(in >> model.name >> model.max_depth)) continue;
+        if (in >> cost_ms) model.cost_micros = 1000.0 * cost_ms;
+        result.push_back(model);
+    }
+    if (result.empty())
+    {
+        constexpr int max_depth_for_primary_cnn = 4;
+        result.push_back(CnnRouter::Model{"cnn.config",
+                                          max_depth_for_primary_cnn});
+        result.push_back(CnnRouter::Model{"cnn2.config", -1});
     }
+    return result;
+}
+
+constexpr int max_planes = 20;
+
+std::shared_ptr<workers::WorkersPoolBase> buildPool(
+    const std::string& config_file)
+{
+    const std::size_t memory_needed =
+        coord.maxSize * sizeof(float) * max_planes + sizeof(uint32_t);
+    const bool use_this_thread = false;
+    return ownedByThisProcess(
+        workers::buildWorkerPool(global::program_path + config_file,
+                                 memory_needed, coord.wlkx, use_this_thread)
+            .release());
 }
 
-std::vector<float> getInputForCnn(const Game& game, int planes)
+/// Sends an empty position to every worker of pool, so that they all load
+/// the net, and checks that the answers are probabilities.
+bool verifyPool(workers::WorkersPoolBase& pool)
 {
-    if (coord.wlkx != coord.wlky)
-    {
-        return {};
-    }
-    std::vector<float> res(planes * coord.wlkx * coord.wlky);
-    Array3dimRef data{res.data(),
-                      boost::extents[planes][coord.wlkx][coord.wlky]};
-    for (int x = 0; x < coord.wlkx; ++x)
-        for (int y = 0; y < coord.wlky; ++y)
+    const int planes = pool.getPlanes();
+    const int points = coord.wlkx * coord.wlkx;
+    std::atomic<bool> valid{true};
+    const bool success = pool.warmUp(
+        [planes, points](float* input)
+        { std::fill_n(input, planes * points, 0.0f); },
+        [points, &valid](const float* output)
         {
-            int p = coord.ind(x, y);
-            int on_move = game.whoNowMoves();
-            int opponent = 3 - on_move;
-            data[0][x][y] = (game.whoseDotMarginAt(p) == 0) ? 1.0f : 0.0f;
-            data[1][x][y] = (game.whoseDotMarginAt(p) == on_move) ? 1.0f : 0.0f;
-            data[2][x][y] =
-                (game.whoseDotMarginAt(p) == opponent) ? 1.0f : 0.0f;
-            data[3][x][y] = game.isInTerr(p, on_move) > 0 ? 1.0f : 0.0f;
-            data[4][x][y] = game.isInTerr(p, opponent) > 0 ? 1.0f : 0.0f;
-            data[5][x][y] = std::min<pti>(game.isInEncl(p, on_move), 2) * 0.5f;
-            data[6][x][y] = std::min<pti>(game.isInEncl(p, opponent), 2) * 0.5f;
-            if (planes == 7) continue;
-            data[7][x][y] =
-                std::min<pti>(game.isInBorder(p, on_move), 2) * 0.5f;
-            data[8][x][y] =
-                std::min<pti>(game.isInBorder(p, opponent), 2) * 0.5f;
-            data[9][x][y] = std::min(game.getTotalSafetyOf(p), 2.0f) * 0.5f;
-            if (planes == 10) continue;
-            //	data[10][x][y] = (coord.dist[p] == 1) ? 1 : 0;
-            //	data[11][x][y] = (coord.dist[p] == 4) ? 1 : 0;
-            data[10][x][y] = (coord.dist[p] == 1) ? 1 : 0;
-            //	data[11][x][y] = (coord.dist[p] == 4) ? 1 : 0;
-            data[11][x][y] = 1;
-            data[12][x][y] = 0;  // where for thr such that opp_dots>0
-            data[13][x][y] = 0;  // where for thr such that opp_dots>0
-            data[14][x][y] =
-                0;  // where0 for thr2 such that minwin2 > 0 and isSafe
-            data[15][x][y] =
-                0;  // where0 for thr2 such that minwin2 > 0 and isSafe
-            data[16][x][y] =
-                (game.threats[on_move - 1].is_in_2m_encl[p] > 0) ? 1.0f : 0.0f;
-            data[17][x][y] =
-                (game.threats[opponent - 1].is_in_2m_encl[p] > 0) ? 1.0f : 0.0f;
-            data[18][x][y] =
-                (game.threats[on_move - 1].is_in_2m_miai[p] > 1) ? 1.0f : 0.0f;
-            data[19][x][y] =
-                (game.threats[opponent - 1].is_in_2m_miai[p] > 1) ? 1.0f : 0.0f;
-        }
+            float sum = 0.0f;
+            for (int i = 0; i < points; ++i)
+            {
+                if (not(output[i] >= 0.0f)) valid = false;
+                sum += output[i];
+            }
+            if (not(std::abs(sum - 1.0f) < 1e-3f)) valid = false;
+        },
+        coord.wlkx);
+    return success and valid;
+}
+
+std::optional<double> microsToDeadline()
+{
+    const int64_t deadline = deadline_micros;
+    if (deadline == 0) return std::nullopt;
+    return std::max<double>(0.0, deadline - nowMicros());
+}
+
+}  // namespace
 
-    if (planes > 12)
+void initialiseCnn()
+{
+    // not thread safe
+    static bool workers_active = false;
+    if (workers_active and reload_requested.exchange(false)) reloadCnn();
+    if (not workers_active)
     {
-        for (int player = 0; player < 2; ++player)
+        auto specs = readRouterConfig();
+        CnnModels initial;
+        std::vector<CnnRouter::Model> loaded;
+        for (auto& spec : specs)
         {
-            int which2 = (player + 1 == game.whoNowMoves()) ? 14 : 15;
-            if (which2 < planes)
+            std::shared_ptr<workers::WorkersPoolBase> pool;
+            try
             {
-                for (auto& t : game.threats[player].threats2m)
-                {
-                    if (t.min_win2 && t.isSafe())
-                    {
-                        data[which2][coord.x[t.where0]][coord.y[t.where0]] =
-                            1.0f - std::pow(0.75f, t.min_win2);
-                    }
-                }
+                pool = buildPool(spec.name);
             }
-            int which = (player + 1 == game.whoNowMoves()) ? 12 : 13;
-            if (which < planes)
+            catch (const std::exception& e)
             {
-                for (auto& t : game.threats[player].threats)
-                {
-                    if (t.where && t.singular_dots)
-                    {
-                        data[which][coord.x[t.where]][coord.y[t.where]] =
-                            1.0f - std::pow(0.75f, t.singular_dots);
-                    }
-                }
+                std::cerr << "CNN model " << spec.name
+                          << " skipped: " << e.what() << std::endl;
+                continue;
             }
+            spec.workers = pool->getWorkers();
+            const int pool_planes = pool->getPlanes();
+            const int ht_key = initial.size();
+            initial.push_back(CnnModel{std::move(pool), pool_planes, ht_key});
+            std::cerr << "CNN model " << initial.size() - 1 << ": "
+                      << spec.name << ", max depth " << spec.max_depth
+                      << ", workers " << spec.workers << std::endl;
+            loaded.push_back(std::move(spec));
         }
+        // without any model the search uses the playouts only
+        if (loaded.empty())
+            std::cerr << "No CNN model loaded, using playouts" << std::endl;
+        else
+            router = std::make_unique<CnnRouter>(std::move(loaded));
+        models = std::make_shared<const CnnModels>(std::move(initial));
+        // reloaded at the start of the next search
+        std::signal(SIGHUP, [](int) { reload_requested = true; });
+        // file with the number of children to prefetch, default 3
+        const auto prefetch_config =
+            global::program_path + "cnnprefetch.config";
+        if (router and std::filesystem::exists(prefetch_config) and
+            coord.wlkx == coord.wlky)
+        {
+            int top_k = 3;
+            std::ifstream(prefetch_config) >> top_k;
+            std::cerr << "CNN prefetch of top " << top_k << " children"
+                      << std::endl;
+            if (top_k > 0)
+                prefetcher = ownedByThisProcess(new Prefetcher(top_k));
+        }
+        workers_active = true;
     }
-    return res;
 }
 
-std::vector<float> convertToBoard(const std::vector<float>& res)
+/// Writes planes*wlkx*wlky floats of CNN input (layout [plane][x][y]) to
+/// input, which is usually the shared memory of a CNN worker. Every value is
+/// written, so the buffer need not be cleared.
+void writeInputForCnn(const Game& game, int planes, float* input)
 {
-    std::vector<float> probs(coord.getSize(), 0.0f);
+    cnn_input::encodePlanes(game, planes, input);
+}
+
+CnnInfo convertToBoard(const float* res)
+{
+    auto probs =
+        std::make_shared<std::vector<float>>(coord.getSize() + 1, 0.0f);
     for (int x = 0; x < coord.wlkx; ++x)
     {
         for (int y = 0; y < coord.wlky; ++y)
         {
-            probs[coord.ind(x, y)] = res[x * coord.wlky + y];
+            (*probs)[coord.ind(x, y)] = res[x * coord.wlky + y];
         }
     }
+    probs->back() = res[coord.wlkx * coord.wlky];
     return probs;
 }
 
-std::pair<bool, std::vector<float>> getCnnInfo(Game& game,
-                                               bool use_secondary_cnn)
+namespace
 {
-    std::pair<bool, std::vector<float>> fromHT{false, {}};
-    if (not use_secondary_cnn)
+/// Value from the CnnInfo of game, for player 1 in [0, 1] as playout
+/// results, or -1 if there is none.
+float valueForPlayer1(const Game& game, const CnnInfo& info)
+{
+    if (info->size() <= static_cast<std::size_t>(coord.getSize())) return -1.0f;
+    const float value = info->back();
+    if (std::isnan(value)) return -1.0f;
+    const float for_mover = 0.5f * (std::clamp(value, -1.0f, 1.0f) + 1.0f);
+    return game.whoNowMoves() == 1 ? for_mover : 1.0f - for_mover;
+}
+
+}  // namespace
+
+void setCnnDeadline(int msec)
+{
+    deadline_micros = (msec > 0) ? nowMicros() + 1000 * int64_t(msec) : 0;
+}
+
+namespace
+{
+std::pair<bool, CnnInfo> getCnnInfoFromModel(Game& game, int model,
+                                             const CnnModel& current)
+{
+    const auto pos = Position{game.getHistory().size(), game.getZobrist()};
+    auto fromHT = getCnnInfoFromHT(pos, current.ht_key);
+    if (fromHT.first)
     {
-        auto pos = Position{game.getHistory().size(), game.getZobrist()};
-        fromHT = getCnnInfoFromHT(pos);
-        if (fromHT.first)
+        KROPLA_LOG(debug) << "in HT !!!!!!!!!!!!!!!!!!!!!";
+        return fromHT;
+    }
+    else
+        KROPLA_LOG(debug) << "not in HT";
+    const int used_planes = current.planes;
+    CnnInfo res{};
+    // forward time, without the wait for a free worker
+    int64_t start = 0;
+    KROPLA_PROFILE_SCOPE(cnn_wait);
+    router->started(model);
+    const bool success = current.pool->getCnnInfo(
+        [&game, used_planes, &start](float* input)
         {
-            std::cerr << "in HT !!!!!!!!!!!!!!!!!!!!!" << std::endl;
-            return fromHT;
+            start = nowMicros();
+            writeInputForCnn(game, used_planes, input);
+        },
+        [&res](const float* output) { res = convertToBoard(output); },
+        coord.wlkx);
+    router->finished(model, success ? std::optional<double>(nowMicros() - start)
+                                    : std::nullopt);
+    if (not success) return {false, nullptr};
+    saveCnnInfo(pos, res, false, current.ht_key);
+    return {success, std::move(res)};
+}
+
+}  // namespace
+
+std::pair<bool, CnnInfo> getCnnInfo(Game& game, int depth)
+{
+    if (coord.wlkx != coord.wlky or not router)
+    {
+        return {false, nullptr};
+    }
+    const auto current = models.load();
+    // a failed model gives way to the next ones
+    for (int model = router->choose(depth, microsToDeadline());
+         model < router->size(); ++model)
+    {
+        auto result = getCnnInfoFromModel(game, model, (*current)[model]);
+        if (result.first) return result;
+    }
+    return {false, nullptr};
+}
+
+bool reloadCnn()
+{
+    static std::mutex reload_mutex;
+    static int generation = 0;
+    std::lock_guard<std::mutex> l(reload_mutex);
+    const auto old_models = models.load();
+    if (not old_models) return false;
+    const int n = old_models->size();
+    CnnModels fresh;
+    for (int model = 0; model < n; ++model)
+    {
+        std::cerr << "Reloading CNN model " << model << " ("
+                  << router->name(model) << ")" << std::endl;
+        std::shared_ptr<workers::WorkersPoolBase> pool;
+        try
+        {
+            pool = buildPool(router->name(model));
         }
-        else
-            std::cerr << "not in HT" << std::endl;
+        catch (const std::exception& e)
+        {
+            std::cerr << "Reloading model " << model << " failed: " << e.what()
+                      << ", keeping the old nets" << std::endl;
+            return false;
+        }
+        if (not verifyPool(*pool))
+        {
+            std::cerr << "New net of model " << model
+                      << " failed the test query, keeping the old nets"
+                      << std::endl;
+            return false;
+        }
+        const int pool_planes = pool->getPlanes();
+        const int ht_key = (generation + 1) * n + model;
+        fresh.push_back(CnnModel{std::move(pool), pool_planes, ht_key});
     }
-    auto input = getInputForCnn(game, use_secondary_cnn ? planes2 : planes);
-    auto [success, res] = (use_secondary_cnn ? workers_pool2 : workers_pool)
-                              ->getCnnInfo(input, coord.wlkx);
-    if (not success) return {false, {}};
-    res = convertToBoard(res);
-    if (not use_secondary_cnn)
+    ++generation;
+    models = std::make_shared<const CnnModels>(std::move(fresh));
+    const auto current = models.load();
+    for (int model = 0; model < n; ++model)
     {
-        auto pos = Position{game.getHistory().size(), game.getZobrist()};
-        saveCnnInfo(pos, res);
+        router->setWorkers(model, (*current)[model].pool->getWorkers());
+        forgetCnnInfo((*old_models)[model].ht_key);
     }
-    return {success, std::move(res)};
+    std::cerr << "CNN models reloaded" << std::endl;
+    return true;
+}
+
+bool shareCnnWithForks()
+{
+    initialiseCnn();
+    bool success = true;
+    for (const auto& model : *models.load())
+    {
+        success = verifyPool(*model.pool) and success;
+        model.pool->shareWithForks();
+    }
+    return success;
 }
 
 void updatePriors(Game& game, Treenode* children, int depth)
 {
     if (children == nullptr) return;
-    const int max_depth_for_primary_cnn = 4;
 
-    std::cerr << "Trying to update priors for " << game.getZobrist() << " "
-              << children->parent->showParents() << " -> ";
-    const auto [is_cnn_available, probs] =
-        getCnnInfo(game, depth > max_depth_for_primary_cnn);
+    KROPLA_LOG(debug) << "Trying to update priors for " << game.getZobrist()
+                      << " " << children->parent->showParents() << " -> ";
+    const auto [is_cnn_available, cnn_info] = getCnnInfo(game, depth);
 
     if (not is_cnn_available) return;
+    children->parent->cnn_value = valueForPlayer1(game, cnn_info);
+    const std::span<const float> probs{*cnn_info};
     float max = 0.0f;
     for (auto* ch = children; true; ++ch)
     {
@@ -229,7 +528,7 @@ void updatePriors(Game& game, Treenode* children, int depth)
     }
     if (max == 0.0f)
     {
-        std::cerr << "Max is 0.0f, CNN does not work?" << std::endl;
+        KROPLA_LOG(warning) << "Max is 0.0f, CNN does not work?";
         return;
     }
     const float prior_max = 150.0f / std::sqrt(std::sqrt(max));
@@ -255,12 +554,28 @@ void updatePriors(Game& game, Treenode* children, int depth)
             ch->prior.value_sum = ch->prior.value_sum.load() + value;
             if (show_this)
             {
-                std::cerr << "   " << ch->show() << "  --> " << value
-                          << "  (max: " << prior_max << ")" << std::endl;
+                KROPLA_LOG(debug) << "   " << ch->show() << "  --> " << value
+                                  << "  (max: " << prior_max << ")";
             }
         }
         if (ch->isLast()) break;
     }
+    // children are evaluated with the primary CNN
+    if (prefetcher and router->choose(depth + 1) == 0)
+        prefetcher->enqueue(game, children);
+}
+
+void printCnnPoolStats(std::ostream& os)
+{
+    const auto current = models.load();
+    if (not current) return;
+    for (std::size_t model = 0; model < current->size(); ++model)
+    {
+        if (router and static_cast<int>(model) < router->size())
+            os << "CNN model " << model << " (" << router->name(model)
+               << "):\n";
+        (*current)[model].pool->printStats(os);
+    }
 }
 
 void printCnnStats()
@@ -268,9 +583,28 @@ void printCnnStats()
     const auto [ht_queries, ht_answers] = getCnnHtStats();
     std::cerr << "Queries of large CNN: " << ht_queries
               << ", from that those read from HT: " << ht_answers << std::endl;
-    const auto filename = "htstats.txt";
-    std::fstream file(
-        filename, std::fstream::out | std::fstream::app | std::fstream::ate);
-    file << "Queries of large CNN: " << ht_queries
-         << ", from that those read from HT: " << ht_answers << std::endl;
+    for (int model = 0; router and model < router->size(); ++model)
+    {
+        std::cerr << "CNN model " << model << " (" << router->name(model)
+                  << "): forward time estimate [micros] "
+                  << router->costEstimate(model) << std::endl;
+    }
+    if (prefetcher)
+    {
+        const auto [saved, used] = getSpeculativeStats();
+        std::cerr << "Speculative CNN results: " << saved << ", used: " << used
+                  << ", wasted (so far): " << saved - used << std::endl;
+    }
+}
+
+CnnStats getCnnStats()
+{
+    CnnStats stats;
+    std::tie(stats.ht_queries, stats.ht_answers) = getCnnHtStats();
+    if (prefetcher)
+    {
+        std::tie(stats.speculative_saved, stats.speculative_used) =
+            getSpeculativeStats();
+    }
+    return stats;
 }
@@ -24,13 +24,41 @@
 
 #pragma once
 
+#include <cstdint>
+#include <ostream>
 #include <utility>
 #include <vector>
 
+#include "cnn_hash_table.h"
 #include "game.h"
 
+// also runs the reload requested by SIGHUP
 void initialiseCnn();
-std::pair<bool, std::vector<float>> getCnnInfo(Game& game,
-                                               bool use_secondary_cnn = false);
+// Loads the models again from their config files into new workers, checks
+// them with a test query and then switches all queries to them; the old
+// workers exit after their last query. Keeps the old models and returns
+// false if a new one fails.
+bool reloadCnn();
+// Initialises the models and loads the nets into all their workers, which
+// the processes forked afterwards then share with this one, instead of
+// starting their own. Returns false if a test query of a model failed.
+bool shareCnnWithForks();
+// the model is chosen by the router for a node at depth (0: the root)
+std::pair<bool, CnnInfo> getCnnInfo(Game& game, int depth = 0);
+// time for the current move, the router avoids models that would answer
+// later; msec <= 0 means no limit
+void setCnnDeadline(int msec);
+// also sets cnn_value of the parent of children, if the net has a value head
 void updatePriors(Game& game, Treenode* children, int depth);
 void printCnnStats();
+// since the start of the program
+struct CnnStats
+{
+    uint64_t ht_queries{0};
+    uint64_t ht_answers{0};  // answered from the hash table
+    uint64_t speculative_saved{0};
+    uint64_t speculative_used{0};
+};
+CnnStats getCnnStats();
+// latency histograms and health of the workers of all models
+void printCnnPoolStats(std::ostream& os);
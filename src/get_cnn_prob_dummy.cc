@@ -25,12 +25,17 @@
 #include "get_cnn_prob.h"
 
 void initialiseCnn() {}
+bool reloadCnn() { return false; }
+bool shareCnnWithForks() { return true; }
 
-std::pair<bool, std::vector<float>> getCnnInfo(Game& /*game*/,
-                                               bool /*use_secondary_cnn*/)
+std::pair<bool, CnnInfo> getCnnInfo(Game& /*game*/, int /*depth*/)
 {
-    return {false, {}};
+    return {false, nullptr};
 }
 
+void setCnnDeadline(int /*msec*/) {}
+
 void updatePriors(Game& /*game*/, Treenode* /*children*/, int /*depth*/) {}
 void printCnnStats() {}
+CnnStats getCnnStats() { return {}; }
+void printCnnPoolStats(std::ostream& /*os*/) {}
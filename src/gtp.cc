@@ -0,0 +1,418 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file gtp.cc -- a GTP-like line protocol
+that keeps the game and the search tree between moves.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "gtp.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include "analysis.h"
+#include "get_cnn_prob.h"
+#include "sgf.h"
+#include "snapshot.h"
+
+namespace
+{
+const std::vector<std::string> known_commands{
+    "protocol_version", "name",     "version",   "list_commands",
+    "known_command",    "quit",     "boardsize", "clear_board",
+    "play",             "undo",     "genmove",   "time_left",
+    "set_komi",         "komi",     "analyze",   "showboard",
+    "save_snapshot",    "load_snapshot"};
+const std::vector<std::string> search_commands{"genmove", "analyze"};
+const std::vector<std::string> local_commands{
+    "protocol_version", "name",      "version",  "list_commands",
+    "known_command",    "quit",      "play",     "time_left",
+    "showboard"};
+
+// the words of line, without the numeric id, which is put into id
+std::vector<std::string> splitLine(const std::string &line, std::string &id)
+{
+    std::istringstream in(line);
+    std::vector<std::string> words;
+    for (std::string w; in >> w;) words.push_back(w);
+    if (not words.empty() and
+        std::all_of(words[0].begin(), words[0].end(),
+                    [](unsigned char c) { return std::isdigit(c); }))
+    {
+        id = words[0];
+        words.erase(words.begin());
+    }
+    return words;
+}
+
+bool isCommandIn(const std::string &line,
+                 const std::vector<std::string> &commands)
+{
+    std::string id;
+    const auto words = splitLine(line, id);
+    return not words.empty() and std::find(commands.begin(), commands.end(),
+                                           words[0]) != commands.end();
+}
+
+// held by the commands which set the global state, until they are done
+std::mutex global_state_mutex;
+
+// komi is kept, although the constructor of Game resets it
+Game gameFromSgf(const std::string &sgf)
+{
+    const int komi = global::komi;
+    SgfParser parser(sgf);
+    auto seq = parser.parseMainVar();
+    Game game(seq, std::numeric_limits<int>::max());
+    global::komi = komi;
+    return game;
+}
+
+int parseColour(const std::string &s)
+{
+    std::string lower = s;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (lower == "b" or lower == "black") return 1;
+    if (lower == "w" or lower == "white") return 2;
+    throw std::runtime_error("invalid colour " + s);
+}
+
+int parseInt(const std::string &s)
+{
+    std::size_t used = 0;
+    int value = 0;
+    try
+    {
+        value = std::stoi(s, &used);
+    }
+    catch (const std::logic_error &)
+    {
+        used = 0;
+    }
+    if (used == 0 or used != s.size())
+        throw std::runtime_error("invalid number " + s);
+    return value;
+}
+
+// the move inside ;B[...] returned by the search
+std::string moveOfSgfNode(const std::string &node)
+{
+    const auto l = node.find('[');
+    const auto r = node.rfind(']');
+    if (l == std::string::npos or r == std::string::npos or r <= l + 1)
+        return {};
+    return node.substr(l + 1, r - l - 1);
+}
+
+}  // namespace
+
+GtpEngine::GtpEngine(const std::string &sgf, int threads, int iter_count,
+                     int msec, int komi)
+    : initial_sgf{sgf},
+      game{gameFromSgf(sgf)},
+      threads{std::max(threads, 1)},
+      iter_count{iter_count},
+      msec{msec}
+{
+    mc.setKeepTree(true);
+    saveGlobalState();
+    // not the komi of the engine which executed the last command
+    this->komi = komi;
+}
+
+void GtpEngine::setPosition(const std::string &sgf)
+{
+    const std::lock_guard<std::mutex> lock(global_state_mutex);
+    restoreGlobalState();
+    try
+    {
+        game = gameFromSgf(sgf);
+    }
+    catch (...)
+    {
+        restoreGlobalState();
+        throw;
+    }
+    initial_sgf = sgf;
+    mc.clearTree();
+    loaded_snapshot.clear();
+    moves.clear();
+    saveGlobalState();
+}
+
+bool GtpEngine::isSearch(const std::string &line)
+{
+    return isCommandIn(line, search_commands);
+}
+
+bool GtpEngine::isLocal(const std::string &line)
+{
+    return isCommandIn(line, local_commands);
+}
+
+bool GtpEngine::hasBoardSizeSet() const
+{
+    return coord.wlkx == width and coord.wlky == height;
+}
+
+std::string GtpEngine::execute(const std::string &line)
+{
+    std::string id;
+    auto words = splitLine(line, id);
+    if (words.empty()) return {};
+    const std::string command = words[0];
+    words.erase(words.begin());
+    // the coordinate tables of a local command are not changed meanwhile,
+    // as the commands which change them wait for the search to end
+    const bool local = isLocal(command) and hasBoardSizeSet();
+    std::unique_lock<std::mutex> lock(global_state_mutex, std::defer_lock);
+    if (not local)
+    {
+        lock.lock();
+        restoreGlobalState();
+    }
+    std::string response;
+    try
+    {
+        response = "=" + id + " " + run(command, words) + "\n\n";
+    }
+    catch (const std::exception &e)
+    {
+        response = "?" + id + " " + e.what() + "\n\n";
+    }
+    if (not local) saveGlobalState();
+    return response;
+}
+
+std::string GtpEngine::run(const std::string &command,
+                           const std::vector<std::string> &args)
+{
+    if (command == "protocol_version") return "2";
+    if (command == "name") return "kropla";
+    if (command == "version") return "";
+    if (command == "list_commands")
+    {
+        std::string res;
+        for (const auto &c : known_commands)
+            res += (res.empty() ? "" : "\n") + c;
+        return res;
+    }
+    if (command == "known_command")
+    {
+        if (args.empty()) throw std::runtime_error("missing command");
+        return std::find(known_commands.begin(), known_commands.end(),
+                         args[0]) != known_commands.end()
+                   ? "true"
+                   : "false";
+    }
+    if (command == "quit")
+    {
+        quit = true;
+        return "";
+    }
+    if (command == "boardsize")
+    {
+        if (args.empty()) throw std::runtime_error("missing size");
+        const int x = parseInt(args[0]);
+        const int y = args.size() > 1 ? parseInt(args[1]) : x;
+        if (x < 5 or y < 5 or x > Coord::maxx or y > Coord::maxy)
+            throw std::runtime_error("unacceptable size");
+        const std::string size =
+            x == y ? std::to_string(x)
+                   : std::to_string(x) + ":" + std::to_string(y);
+        initial_sgf = "(;FF[4]GM[40]CA[UTF-8]AP[kropla]SZ[" + size + "])";
+        clearBoard();
+        return "";
+    }
+    if (command == "clear_board")
+    {
+        clearBoard();
+        return "";
+    }
+    if (command == "play") return play(args);
+    if (command == "undo") return undo();
+    if (command == "genmove") return genmove(args);
+    if (command == "time_left")
+    {
+        if (args.size() < 2) throw std::runtime_error("missing time");
+        const int who = parseColour(args[0]);
+        // in int64_t, as seconds above 2^31/1000 would overflow
+        const int64_t left_msec = 1000 * int64_t(parseInt(args[1]));
+        time_left_msec[who - 1] = int(std::clamp<int64_t>(
+            left_msec, 0, std::numeric_limits<int>::max()));
+        time_left_moves[who - 1] = args.size() > 2 ? parseInt(args[2]) : 0;
+        return "";
+    }
+    if (command == "set_komi" or command == "komi")
+    {
+        if (args.empty()) throw std::runtime_error("missing komi");
+        double komi = 0.0;
+        try
+        {
+            komi = std::stod(args[0]);
+        }
+        catch (const std::logic_error &)
+        {
+            throw std::runtime_error("invalid komi " + args[0]);
+        }
+        global::komi = static_cast<int>(std::lround(komi));
+        return "";
+    }
+    if (command == "analyze") return analyze(args);
+    if (command == "showboard") return "\n" + game.showString();
+    if (command == "save_snapshot")
+    {
+        if (args.empty()) throw std::runtime_error("missing file");
+        snapshot::saveToFile(game, args[0]);
+        return "";
+    }
+    if (command == "load_snapshot") return loadSnapshot(args);
+    throw std::runtime_error("unknown command");
+}
+
+std::string GtpEngine::play(const std::vector<std::string> &args)
+{
+    if (args.empty()) throw std::runtime_error("missing move");
+    const int who =
+        args.size() > 1 ? parseColour(args[0]) : game.whoNowMoves();
+    const std::string &move = args.back();
+    if (move.size() < 2 or not coord.isOnBoardSgf(move.substr(0, 2)))
+        throw std::runtime_error("invalid move " + move);
+    try
+    {
+        game.makeSgfMoveWithUndo(move, who);
+    }
+    catch (const std::exception &)
+    {
+        throw std::runtime_error("illegal move " + move);
+    }
+    moves.emplace_back(who, move);
+    return "";
+}
+
+std::string GtpEngine::undo()
+{
+    if (moves.empty()) throw std::runtime_error("cannot undo");
+    moves.pop_back();
+    if (game.unmakeMove()) return "";
+    // the move is older than the undo journal of the game
+    game = loaded_snapshot.empty() ? gameFromSgf(initial_sgf)
+                                   : snapshot::load(loaded_snapshot);
+    for (const auto &[who, move] : moves) game.makeSgfMoveWithUndo(move, who);
+    return "";
+}
+
+std::string GtpEngine::genmove(const std::vector<std::string> &args)
+{
+    const int who = game.whoNowMoves();
+    if (not args.empty() and parseColour(args[0]) != who)
+        throw std::runtime_error("it is not the move of " + args[0]);
+    constexpr float exponent = 2.0f;
+    start_time = std::chrono::high_resolution_clock::now();
+    const auto best =
+        iter_count < 0
+            ? mc.findBestMoveUsingCNNonly(game, exponent)
+            : mc.findBestMoveMT(game, threads, iter_count, thinkingMsec(who));
+    printCnnStats();
+    const std::string move = moveOfSgfNode(best);
+    if (move.empty()) throw std::runtime_error("no move");
+    game.makeSgfMoveWithUndo(move, who);
+    moves.emplace_back(who, move);
+    if (time_left_moves[who - 1] > 0) --time_left_moves[who - 1];
+    return move;
+}
+
+std::string GtpEngine::analyze(const std::vector<std::string> &args)
+{
+    const int analyze_msec =
+        args.empty() ? (msec > 0 ? msec : 1000) : parseInt(args[0]);
+    start_time = std::chrono::high_resolution_clock::now();
+    mc.findBestMoveMT(game, threads, std::numeric_limits<int>::max(),
+                      std::max(analyze_msec, 1));
+    return analysis::toJson(
+        analysis::snapshot(montec::root, analysis::topN(), 15));
+}
+
+std::string GtpEngine::loadSnapshot(const std::vector<std::string> &args)
+{
+    if (args.empty()) throw std::runtime_error("missing file");
+    game = snapshot::loadFromFile(args[0]);
+    loaded_snapshot = snapshot::save(game);
+    mc.clearTree();
+    moves.clear();
+    return "";
+}
+
+void GtpEngine::clearBoard()
+{
+    mc.clearTree();
+    loaded_snapshot.clear();
+    moves.clear();
+    game = gameFromSgf(initial_sgf);
+}
+
+void GtpEngine::saveGlobalState()
+{
+    width = coord.wlkx;
+    height = coord.wlky;
+    komi = global::komi;
+    komi_ratchet = global::komi_ratchet;
+}
+
+void GtpEngine::restoreGlobalState() const
+{
+    if (coord.wlkx != width or coord.wlky != height)
+        coord.changeSize(width, height);
+    global::komi = komi;
+    global::komi_ratchet = komi_ratchet;
+}
+
+// msec for genmove of who: the limit from the command line, shortened to a
+// share of the time left on the clock of who, if it is known
+int GtpEngine::thinkingMsec(int who) const
+{
+    const int left_msec = time_left_msec[who - 1];
+    if (left_msec < 0) return msec;
+    constexpr int default_moves_left = 30;
+    const int left_moves = time_left_moves[who - 1];
+    const int moves_left = left_moves > 0 ? left_moves : default_moves_left;
+    const int share = std::max(left_msec / moves_left, 1);
+    return msec > 0 ? std::min(msec, share) : share;
+}
+
+void play_gtp(const std::string &sgf, int threads, int iter_count, int msec)
+{
+    GtpEngine engine(sgf, threads, iter_count, msec, global::komi);
+    std::string line;
+    while (not engine.hasQuit() and std::getline(std::cin, line))
+    {
+        const auto response = engine.execute(line);
+        if (not response.empty()) std::cout << response << std::flush;
+    }
+}
@@ -0,0 +1,118 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file gtp.h -- a GTP-like line protocol
+that keeps the game and the search tree between moves.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "game.h"
+#include "montecarlo.h"
+
+// Engine for the protocol of "kropla gtp". Commands, one per line, optionally
+// preceded by a numeric id, as in GTP:
+//   protocol_version, name, version, list_commands, known_command <cmd>,
+//   quit, boardsize <w> [<h>], clear_board, play [<colour>] <move>, undo,
+//   genmove [<colour>], time_left <colour> <seconds> [<moves>],
+//   set_komi <komi> (or komi <komi>), analyze [<msec>], showboard,
+//   save_snapshot <file>, load_snapshot <file> (see snapshot.h).
+// Moves are in sgf coordinates, with enclosures as in the sgf, e.g. "cd" or
+// "cd.bcccdcdbbc". Responses are "= <result>" or "? <error>", followed by an
+// empty line. Moves are applied to the game as they come, and the search tree
+// is kept, so that the next search starts from what was found before.
+// Engines do not search concurrently: the search state is global. The
+// commands which change the global state (see isLocal) are serialised by a
+// lock held until they are done, searches included.
+class GtpEngine
+{
+   public:
+    // sgf gives the board and the position for clear_board, komi the komi
+    // until set_komi. Engines are made while no other engine executes a
+    // command, as the board of sgf is set in coord.
+    GtpEngine(const std::string &sgf, int threads, int iter_count, int msec,
+              int komi = 0);
+    std::string execute(const std::string &line);
+    bool hasQuit() const { return quit; }
+    const Game &getGame() const { return game; }
+    // as if the engine was created with sgf
+    void setPosition(const std::string &sgf);
+    // of genmove
+    void setLimits(int new_iter_count, int new_msec)
+    {
+        iter_count = new_iter_count;
+        msec = new_msec;
+    }
+    // whether the command of line searches (genmove, analyze)
+    static bool isSearch(const std::string &line);
+    // Whether the command of line is local: if the board size of the engine
+    // is set, it reads no global state but the coordinate tables and changes
+    // none, and takes no lock, so that it may be executed while another
+    // engine of the same board size searches (play, showboard, time_left and
+    // the commands about the engine).
+    static bool isLocal(const std::string &line);
+    bool hasBoardSizeSet() const;
+    // The board size (coord) and komi are global; each engine keeps its own
+    // and sets them while it executes a command, so that several engines
+    // may live in one process. Called outside execute() only while no other
+    // engine executes a command.
+    void restoreGlobalState() const;
+    // nodes of the search tree kept for the next search
+    std::size_t keptNodes() const { return mc.keptNodes(); }
+    void dropTree() { mc.clearTree(); }
+
+   private:
+    std::string run(const std::string &command,
+                    const std::vector<std::string> &args);
+    std::string play(const std::vector<std::string> &args);
+    std::string undo();
+    std::string genmove(const std::vector<std::string> &args);
+    std::string analyze(const std::vector<std::string> &args);
+    std::string loadSnapshot(const std::vector<std::string> &args);
+    void clearBoard();
+    int thinkingMsec(int who) const;
+    void saveGlobalState();
+
+    std::string initial_sgf;
+    Game game;
+    // the position loaded by load_snapshot, empty if initial_sgf is used
+    std::string loaded_snapshot;
+    // moves played since the initial position: who, move
+    std::vector<std::pair<int, std::string>> moves;
+    MonteCarlo mc;
+    int threads;
+    int iter_count;
+    int msec;
+    // clocks of player 1 and 2 from time_left
+    std::array<int, 2> time_left_msec{-1, -1};  // negative if not known
+    std::array<int, 2> time_left_moves{0, 0};
+    bool quit{false};
+    int width, height;
+    int komi, komi_ratchet;
+};
+
+// reads commands from stdin and writes responses to stdout until quit
+void play_gtp(const std::string &sgf, int threads, int iter_count, int msec);
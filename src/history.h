@@ -54,6 +54,11 @@ class History
     pti getLastGoodReplyFor(int who) const;
 
     void updateGoodReplies(int lastWho, float abs_value);
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(history);
+    }
 
    private:
     std::vector<u32> history;
@@ -0,0 +1,375 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file kropla_bench.cc -- end-to-end search
+benchmark over a set of sgf positions.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "game.h"
+#include "logger.h"
+#include "montecarlo.h"
+#include "profiler.h"
+#include "sgf.h"
+
+namespace
+{
+struct Options
+{
+    std::string corpus{"testowe-sgf"};
+    std::vector<std::string> files{};
+    std::vector<int> moves{20, 40};
+    int iters{1000};
+    int msec{500};
+    int threads{2};
+    uint64_t seed{1};
+    MonteCarlo::Determinism determinism{MonteCarlo::Determinism::off};
+    int limit{10};
+    std::string out{};
+    bool verbose{false};
+};
+
+struct Search
+{
+    std::string file;
+    int move_number;
+    std::string mode;
+    double load_s;
+    double search_s;
+    int64_t iterations;
+    int64_t playouts;
+    int64_t expansions;
+    int64_t cnn_calls;
+    // summed over threads, by the profiler if it is compiled in
+    double expand_thread_s;
+    double playout_thread_s;
+    long peak_rss_kb;
+    std::string best_move;
+};
+
+class NullBuffer : public std::streambuf
+{
+   protected:
+    int overflow(int c) override { return c; }
+};
+
+void usage()
+{
+    std::cerr << R"raws(Usage:
+  kropla_bench [options] [sgf files]
+    runs searches in positions from the sgf files (or the corpus directory) and
+    writes the results as JSON to stdout.
+  --corpus DIR    take sgf files from DIR (default testowe-sgf), sorted by name
+  --limit N       at most N files from the corpus (default 10, 0: all)
+  --moves LIST    comma separated move numbers of the positions (default 20,40)
+  --iters N       search with N iterations (default 1000, 0: skip)
+  --msec N        search for N milliseconds (default 500, 0: skip)
+  --threads N     search threads (default 2)
+  --seed N        seed of the simulations (default 1)
+  --deterministic the searches with --iters make exactly N iterations, each one
+                  with its own seed, so that every run does the same work
+  --lockstep      as --deterministic, and the threads back up their results in
+                  a fixed order, so that the searches are reproducible
+  --out FILE      write JSON to FILE instead of stdout
+  --verbose       keep the logs of the search on stderr
+)raws";
+}
+
+std::vector<int> parseList(const std::string& s)
+{
+    std::vector<int> res;
+    std::stringstream ss(s);
+    for (std::string item; std::getline(ss, item, ',');)
+        if (not item.empty()) res.push_back(std::stoi(item));
+    return res;
+}
+
+Options parseArgs(int argc, char* argv[])
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        const auto value = [&]() -> std::string
+        {
+            if (i + 1 >= argc)
+                throw std::invalid_argument("missing value of " + arg);
+            return argv[++i];
+        };
+        if (arg == "--corpus")
+            opt.corpus = value();
+        else if (arg == "--limit")
+            opt.limit = std::stoi(value());
+        else if (arg == "--moves")
+            opt.moves = parseList(value());
+        else if (arg == "--iters")
+            opt.iters = std::stoi(value());
+        else if (arg == "--msec")
+            opt.msec = std::stoi(value());
+        else if (arg == "--threads")
+            opt.threads = std::max(1, std::stoi(value()));
+        else if (arg == "--seed")
+            opt.seed = std::stoull(value());
+        else if (arg == "--deterministic")
+            opt.determinism = MonteCarlo::Determinism::node_count;
+        else if (arg == "--lockstep")
+            opt.determinism = MonteCarlo::Determinism::lockstep;
+        else if (arg == "--out")
+            opt.out = value();
+        else if (arg == "--verbose")
+            opt.verbose = true;
+        else if (arg.starts_with("--"))
+            throw std::invalid_argument("unknown option " + arg);
+        else
+            opt.files.push_back(arg);
+    }
+    if (opt.files.empty())
+    {
+        for (const auto& entry :
+             std::filesystem::directory_iterator(opt.corpus))
+            if (entry.path().extension() == ".sgf")
+                opt.files.push_back(entry.path().string());
+        std::sort(opt.files.begin(), opt.files.end());
+        if (opt.limit > 0 and static_cast<int>(opt.files.size()) > opt.limit)
+            opt.files.resize(opt.limit);
+    }
+    return opt;
+}
+
+const char* determinismName(MonteCarlo::Determinism determinism)
+{
+    switch (determinism)
+    {
+        case MonteCarlo::Determinism::node_count:
+            return "node_count";
+        case MonteCarlo::Determinism::lockstep:
+            return "lockstep";
+        default:
+            return "off";
+    }
+}
+
+long peakRssKb()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;  // kilobytes on Linux
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+}
+
+std::string readFile(const std::string& name)
+{
+    std::ifstream t(name);
+    if (not t) throw std::runtime_error("cannot read " + name);
+    std::stringstream buffer;
+    buffer << t.rdbuf();
+    return buffer.str();
+}
+
+std::string jsonString(const std::string& s)
+{
+    std::string res = "\"";
+    for (const char c : s)
+    {
+        if (c == '"' or c == '\\') res += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) res += c;
+    }
+    return res + "\"";
+}
+
+Search runSearch(const Options& opt, const std::string& file,
+                 const SgfSequence& seq, int move_number, bool fixed_time)
+{
+    Search res{};
+    res.file = file;
+    res.move_number = move_number;
+    res.mode = fixed_time ? "time" : "iters";
+    const auto load_start = std::chrono::steady_clock::now();
+    Game game(seq, move_number);
+    res.load_s = secondsSince(load_start);
+
+    MonteCarlo mc;
+    mc.setSeed(opt.seed);
+    // a deterministic search would ignore the time limit
+    if (not fixed_time) mc.setDeterminism(opt.determinism);
+    const auto search_start = std::chrono::steady_clock::now();
+    res.best_move =
+        fixed_time ? mc.findBestMoveMT(game, opt.threads,
+                                       std::numeric_limits<int>::max(),
+                                       opt.msec)
+                   : mc.findBestMoveMT(game, opt.threads, opt.iters, 0);
+    res.search_s = secondsSince(search_start);
+    res.iterations = montec::iterations;
+    res.playouts = montec::playouts;
+    res.expansions = montec::generateMovesCount;
+    res.cnn_calls = montec::cnnReads;
+    const auto profile = prof::collect();
+    res.expand_thread_s =
+        profile.nanos[static_cast<int>(prof::Phase::expand)] * 1e-9;
+    res.playout_thread_s =
+        profile.nanos[static_cast<int>(prof::Phase::playout)] * 1e-9;
+    res.peak_rss_kb = peakRssKb();
+    return res;
+}
+
+void writeJson(std::ostream& os, const Options& opt,
+               const std::vector<Search>& searches, double total_s)
+{
+    const auto perSecond = [](double n, double s) { return s > 0 ? n / s : 0; };
+    os << "{\n  \"config\": {\"threads\": " << opt.threads
+       << ", \"iters\": " << opt.iters << ", \"msec\": " << opt.msec
+       << ", \"seed\": " << opt.seed << ", \"determinism\": \""
+       << determinismName(opt.determinism)
+       << "\", \"files\": " << opt.files.size()
+       << ", \"optimized\": "
+#ifdef __OPTIMIZE__
+       << "true"
+#else
+       << "false"
+#endif
+       << ", \"ndebug\": "
+#ifdef NDEBUG
+       << "true"
+#else
+       << "false"
+#endif
+       << "},\n  \"searches\": [";
+    int64_t iterations = 0, playouts = 0;
+    double search_s = 0;
+    for (std::size_t i = 0; i < searches.size(); ++i)
+    {
+        const auto& r = searches[i];
+        iterations += r.iterations;
+        playouts += r.playouts;
+        search_s += r.search_s;
+        os << (i ? ",\n" : "\n") << "    {\"file\": " << jsonString(r.file)
+           << ", \"move\": " << r.move_number << ", \"mode\": \"" << r.mode
+           << "\", \"best\": " << jsonString(r.best_move)
+           << ", \"iterations\": " << r.iterations
+           << ", \"iter_per_s\": " << perSecond(r.iterations, r.search_s)
+           << ", \"playouts\": " << r.playouts
+           << ", \"playouts_per_s\": " << perSecond(r.playouts, r.search_s)
+           << ", \"expansions\": " << r.expansions
+           << ", \"cnn_calls\": " << r.cnn_calls
+           << ", \"peak_rss_kb\": " << r.peak_rss_kb
+           << ", \"phases_s\": {\"load\": " << r.load_s
+           << ", \"search\": " << r.search_s;
+        if (prof::enabled)
+            os << ", \"expand_threads\": " << r.expand_thread_s
+               << ", \"playout_threads\": " << r.playout_thread_s;
+        os << "}}";
+    }
+    os << "\n  ],\n  \"total\": {\"searches\": " << searches.size()
+       << ", \"iterations\": " << iterations
+       << ", \"iter_per_s\": " << perSecond(iterations, search_s)
+       << ", \"playouts\": " << playouts
+       << ", \"playouts_per_s\": " << perSecond(playouts, search_s)
+       << ", \"search_s\": " << search_s << ", \"wall_s\": " << total_s
+       << ", \"peak_rss_kb\": " << peakRssKb() << "}\n}" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+try
+{
+    auto getDirectory = [](const std::string& s)
+    { return s.substr(0, s.find_last_of('/') + 1); };
+    global::program_path = getDirectory(argv[0]);
+    if (argc > 1 and (std::string(argv[1]) == "-h" or
+                      std::string(argv[1]) == "--help"))
+    {
+        usage();
+        return 0;
+    }
+    const Options opt = parseArgs(argc, argv);
+    if (opt.files.empty()) throw std::invalid_argument("no sgf files");
+
+    // the search logs a lot, also to stdout; keep only our progress lines
+    // and the JSON
+    // (the logger writes straight to stderr)
+    if (not opt.verbose) logger::setLevel(logger::Level::error);
+    auto* const cout_buf = std::cout.rdbuf();
+    auto* const cerr_buf = std::cerr.rdbuf();
+    NullBuffer discarded;
+    const auto quiet = [&](bool on)
+    {
+        if (opt.verbose) return;
+        std::cout.rdbuf(on ? &discarded : cout_buf);
+        std::cerr.rdbuf(on ? &discarded : cerr_buf);
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<Search> searches;
+    for (const auto& file : opt.files)
+    {
+        SgfParser parser(readFile(file));
+        const auto seq = parser.parseMainVar();
+        for (const int move_number : opt.moves)
+        {
+            for (const bool fixed_time : {false, true})
+            {
+                if ((fixed_time ? opt.msec : opt.iters) <= 0) continue;
+                quiet(true);
+                searches.push_back(
+                    runSearch(opt, file, seq, move_number, fixed_time));
+                quiet(false);
+                const auto& r = searches.back();
+                std::cerr << r.file << " @" << r.move_number << " " << r.mode
+                          << ": " << r.iterations << " iterations in "
+                          << r.search_s << " s" << std::endl;
+            }
+        }
+    }
+    const double total_s = secondsSince(start);
+    if (opt.out.empty())
+        writeJson(std::cout, opt, searches, total_s);
+    else
+    {
+        std::ofstream os(opt.out);
+        writeJson(os, opt, searches, total_s);
+    }
+    return 0;
+}
+catch (const std::exception& e)
+{
+    std::cerr << "kropla_bench: " << e.what() << std::endl;
+    usage();
+    return 1;
+}
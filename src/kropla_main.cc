@@ -25,8 +25,13 @@
 #include <iostream>
 #include <string>
 
+#include "analysis.h"
 #include "game.h"
+#include "gtp.h"
+#include "logger.h"
 #include "montecarlo.h"
+#include "report.h"
+#include "server.h"
 #include "sgf.h"
 
 /* sample sgf */
@@ -109,10 +114,16 @@ int main(int argc, char* argv[])
     auto getDirectory = [](const std::string& s)
     { return s.substr(0, s.find_last_of('/') + 1); };
     global::program_path = getDirectory(argv[0]);
+    logger::configure(global::program_path + "log.config");
+    report::configure(global::program_path + "report.config",
+                      global::program_path + "report.ndjson");
+    analysis::configure(global::program_path + "analysis.config");
     std::string s(sgf185253);
     enum class Mode
     {
         play,
+        gtp,
+        serve,
         sgf_move,
         interactive
     } mode;
@@ -131,6 +142,16 @@ int main(int argc, char* argv[])
             mode = Mode::play;
             std::cerr << "Parameter: " << s << std::endl;
         }
+        else if (name == "gtp")
+        {
+            mode = Mode::gtp;
+            s = "(;FF[4]GM[40]CA[UTF-8]AP[kropla]SZ[39:32])";
+        }
+        else if (name == "serve" and argc > 2)
+        {
+            mode = Mode::serve;
+            s = "(;FF[4]GM[40]CA[UTF-8]AP[kropla]SZ[39:32])";
+        }
         else if (name == "--help")
         {
             std::cerr << R"raws(Usage:
@@ -148,6 +169,32 @@ int main(int argc, char* argv[])
     the next moves in the game; this is for use with Kropki program.
     If msec is present and threads>1, 'think' for at most (msec); msec==0 means no time limit.
     If komi is present, sets initial komi to that value. Otherwise leaves default 0 value.
+    A line RELOAD (or the signal SIGHUP, at the start of the next move) loads the CNN models
+    again from their config files, without restarting.
+    A line STATS prints to stderr the latency percentiles and the health of the CNN workers.
+
+  kropla gtp [iterations [threads [msec [komi]]]]
+    reads commands of a GTP-like protocol from stdin, starting with an empty 39x32 board:
+    protocol_version, name, version, list_commands, known_command, quit, boardsize,
+    clear_board, play [colour] move, undo, genmove [colour], time_left colour seconds [moves],
+    set_komi komi, analyze [msec], showboard, save_snapshot file, load_snapshot file.
+    Moves are in sgf coordinates, with enclosures as in the sgf. The game and the search
+    tree are kept between the commands.
+
+  kropla serve socket_path [iterations [threads [msec [komi]]]]
+    listens on the Unix domain socket socket_path; each connection is a separate game
+    driven by the commands of 'kropla gtp'. The games share the CNN workers and the
+    tables, and the searches take turns, each using all the threads.
+
+  The log level (error, warning, info or debug; info by default) is read from log.config
+  next to the program.
+  A line of JSON about the search of each move is appended to report.ndjson next to the
+  program. report.config may give "max_megabytes keep_files" (16 3 by default): a full
+  report is renamed to report.ndjson.1 and so on, keeping keep_files of them; 0 megabytes
+  turns the report off.
+  With analysis.config ("fd interval_ms top_n", e.g. "3 200 5") and threads>1, a line of
+  JSON with the top_n moves (visits, value, CNN prior, variation) is written every
+  interval_ms during the search to the file descriptor fd, e.g. kropla - 3>analysis.txt
 )raws";
             return 0;
         }
@@ -169,11 +216,8 @@ int main(int argc, char* argv[])
     }
     // for debug, save the sgf we have read
 #ifndef SPEED_TEST
-    {
-        std::ofstream ofs("debug_mc.txt", std::ofstream::app);
-        ofs << "-----------------------------" << std::endl;
-        ofs << s << std::endl;
-    }
+    report::write(
+        report::JsonObject().add("type", "start").add("sgf", s).str());
 #endif
 
     SgfParser parser(s);
@@ -192,10 +236,12 @@ int main(int argc, char* argv[])
     game.show();
 #endif
 
-    int iter_count = (argc > 3) ? std::atoi(argv[3]) : 2000;
-    int threads_count = (argc > 4) ? std::atoi(argv[4]) : 3;
-    int msec = (argc > 5) ? std::atoi(argv[5]) : 0;
-    int komi = (argc > 6) ? std::atoi(argv[6]) : 0;
+    // gtp has no move_number, serve has the socket path instead
+    const int first = (mode == Mode::gtp) ? 2 : 3;
+    int iter_count = (argc > first) ? std::atoi(argv[first]) : 2000;
+    int threads_count = (argc > first + 1) ? std::atoi(argv[first + 1]) : 3;
+    int msec = (argc > first + 2) ? std::atoi(argv[first + 2]) : 0;
+    int komi = (argc > first + 3) ? std::atoi(argv[first + 3]) : 0;
     global::komi = komi;
 
     switch (mode)
@@ -203,6 +249,12 @@ int main(int argc, char* argv[])
         case Mode::play:
             play_engine(game, s, threads_count, iter_count, msec);
             break;
+        case Mode::gtp:
+            play_gtp(s, threads_count, iter_count, msec);
+            break;
+        case Mode::serve:
+            serve(argv[2], threads_count, iter_count, msec);
+            break;
         case Mode::sgf_move:
             findAndPrintBestMove(game, threads_count, iter_count);
             break;
@@ -0,0 +1,414 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file kropla_regress.cc -- runs the
+regression tests of regression-list.txt in one process.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "game.h"
+#include "get_cnn_prob.h"
+#include "logger.h"
+#include "regression.h"
+#include "report.h"
+
+namespace
+{
+struct Options
+{
+    std::string list{"../regression-list.txt"};
+    std::string filter{".*"};
+    int repeat{10};
+    int jobs{static_cast<int>(
+        std::max(1u, std::thread::hardware_concurrency()))};
+    regression::Limits limits{
+        .threads = static_cast<int>(
+            std::max(1u, std::thread::hardware_concurrency()))};
+    uint64_t seed{1};
+    std::string out{};
+    bool verbose{false};
+};
+
+class NullBuffer : public std::streambuf
+{
+   protected:
+    int overflow(int c) override { return c; }
+};
+
+void usage()
+{
+    std::cerr << R"raws(Usage:
+  kropla_regress [options]
+    runs the regression tests of the list, each one repeat times with the seeds
+    seed, seed+1, ..., and writes the results as JSON to stdout.
+    The runs are dealt out in turn to the jobs, forked processes which run
+    at the same time and split the threads among them. The CNN workers are
+    started and load the nets once, before the jobs, and all the jobs send
+    their queries to them. A run takes the time of its test whatever the
+    threads, so N jobs take about 1/N of the wall time, with fewer
+    iterations per search. With one job the runs go one after another in
+    this process, each search with all the threads.
+  --list FILE       the tests (default ../regression-list.txt)
+  --filter REGEX    only the tests whose whole name matches REGEX
+  --repeat N        runs of each test (default 10)
+  --jobs N          runs at the same time (default: the number of cores)
+  --threads N       search threads of all the jobs together (default: the
+                    number of cores)
+  --iters N         at most N iterations of a search (default 5000000)
+  --cnn-only        take the move of the CNN, without a search
+  --time-scale F    multiply the time of the tests by F (default 1)
+  --seed N          seed of the first run (default 1)
+  --out FILE        write JSON to FILE instead of stdout
+  --verbose         keep the logs of the search on stderr
+)raws";
+}
+
+Options parseArgs(int argc, char* argv[])
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        const auto value = [&]() -> std::string
+        {
+            if (i + 1 >= argc)
+                throw std::invalid_argument("missing value of " + arg);
+            return argv[++i];
+        };
+        if (arg == "--list")
+            opt.list = value();
+        else if (arg == "--filter")
+            opt.filter = value();
+        else if (arg == "--repeat")
+            opt.repeat = std::max(1, std::stoi(value()));
+        else if (arg == "--jobs")
+            opt.jobs = std::max(1, std::stoi(value()));
+        else if (arg == "--threads")
+            opt.limits.threads = std::max(1, std::stoi(value()));
+        else if (arg == "--iters")
+            opt.limits.iter_count = std::max(1, std::stoi(value()));
+        else if (arg == "--cnn-only")
+            opt.limits.iter_count = -1;
+        else if (arg == "--time-scale")
+            opt.limits.time_scale = std::stod(value());
+        else if (arg == "--seed")
+            opt.seed = std::stoull(value());
+        else if (arg == "--out")
+            opt.out = value();
+        else if (arg == "--verbose")
+            opt.verbose = true;
+        else
+            throw std::invalid_argument("unknown option " + arg);
+    }
+    return opt;
+}
+
+// name of the model file in the 3rd line of cnn.config, for the config of
+// the results
+std::string cnnName()
+{
+    std::ifstream config(global::program_path + "cnn.config");
+    std::string line;
+    for (int i = 0; i < 3; ++i)
+        if (not std::getline(config, line)) return "(unknown)";
+    const auto end = line.find_last_not_of(" \t\r");
+    line = line.substr(0, end + 1);
+    return line.substr(line.find_last_of('/') + 1);
+}
+
+// A run of the test number test: its number in the results, the repeat and
+// the run, in one line that the parent reads back from a job.
+struct Record
+{
+    std::size_t test;
+    int repeat;
+    regression::Run run;
+};
+
+std::string toLine(const Record& r)
+{
+    std::ostringstream os;
+    os.precision(17);
+    os << r.test << " " << r.repeat << " " << r.run.seed << " "
+       << r.run.score << " " << r.run.iterations << " " << r.run.playouts
+       << " " << r.run.cnn_reads << " " << r.run.search_s << " "
+       << (r.run.move.empty() ? "-" : r.run.move) << "\n";
+    return os.str();
+}
+
+std::vector<Record> fromLines(const std::string& lines)
+{
+    std::vector<Record> records;
+    std::istringstream is(lines);
+    for (Record r; is >> r.test >> r.repeat >> r.run.seed >> r.run.score >>
+                   r.run.iterations >> r.run.playouts >> r.run.cnn_reads >>
+                   r.run.search_s >> r.run.move;)
+    {
+        if (r.run.move == "-") r.run.move.clear();
+        records.push_back(r);
+    }
+    return records;
+}
+
+bool writeAll(int fd, const std::string& data)
+{
+    for (std::size_t done = 0; done < data.size();)
+    {
+        const ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0 and errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+std::string readAll(int fd)
+{
+    std::string data;
+    char buffer[4096];
+    for (;;)
+    {
+        const ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 and errno == EINTR) continue;
+        if (n <= 0) return data;
+        data.append(buffer, n);
+    }
+}
+
+void writeJson(std::ostream& os, const Options& opt,
+               const std::vector<regression::Result>& results, double wall_s)
+{
+    double score = 0;
+    std::size_t runs = 0;
+    for (const auto& result : results)
+    {
+        score += result.total();
+        runs += result.runs.size();
+    }
+    os << "{\n  \"config\": "
+       << report::JsonObject()
+              .add("list", opt.list)
+              .add("filter", opt.filter)
+              .add("repeat", opt.repeat)
+              .add("jobs", opt.jobs)
+              .add("threads", opt.limits.threads)
+              .add("iters", opt.limits.iter_count)
+              .add("time_scale", opt.limits.time_scale)
+              .add("seed", opt.seed)
+              .add("cnn", cnnName())
+              .str()
+       << ",\n  \"tests\": [";
+    for (std::size_t i = 0; i < results.size(); ++i)
+        os << (i ? ",\n    " : "\n    ") << regression::toJson(results[i]);
+    os << "\n  ],\n  \"total\": "
+       << report::JsonObject()
+              .add("tests", results.size())
+              .add("runs", runs)
+              .add("score", score)
+              .add("mean", runs > 0 ? score / runs : 0.0)
+              .add("wall_s", wall_s)
+              .str()
+       << "\n}" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+try
+{
+    auto getDirectory = [](const std::string& s)
+    { return s.substr(0, s.find_last_of('/') + 1); };
+    global::program_path = getDirectory(argv[0]);
+    if (argc > 1 and (std::string(argv[1]) == "-h" or
+                      std::string(argv[1]) == "--help"))
+    {
+        usage();
+        return 0;
+    }
+    const Options opt = parseArgs(argc, argv);
+    std::ifstream list(opt.list);
+    if (not list) throw std::runtime_error("cannot read " + opt.list);
+    const auto tests = regression::parseList(list, std::cerr);
+    const std::regex filter(opt.filter);
+    std::cerr << "Tests found: " << tests.size() << std::endl;
+
+    // the search logs a lot, also to stdout; keep only our progress lines
+    // and the JSON
+    if (not opt.verbose) logger::setLevel(logger::Level::error);
+    auto* const cout_buf = std::cout.rdbuf();
+    auto* const cerr_buf = std::cerr.rdbuf();
+    NullBuffer discarded;
+    const auto quiet = [&](bool on)
+    {
+        if (opt.verbose) return;
+        std::cout.rdbuf(on ? &discarded : cout_buf);
+        std::cerr.rdbuf(on ? &discarded : cerr_buf);
+    };
+
+    std::vector<regression::Result> results;
+    for (const auto& test : tests)
+        if (std::regex_match(test.name, filter))
+            results.push_back(regression::Result{test, {}});
+    const auto print = [](const regression::Result& result, int i,
+                          const regression::Run& run)
+    {
+        std::cerr << "  " << result.test.name << " " << i << ": " << run.move
+                  << " --> " << run.score << "; iterations=" << run.iterations
+                  << ", cnnReads=" << run.cnn_reads << std::endl;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    if (opt.jobs == 1)
+    {
+        for (auto& result : results)
+        {
+            std::cerr << "Running test " << result.test.name << "..."
+                      << std::endl;
+            for (int i = 0; i < opt.repeat; ++i)
+            {
+                quiet(true);
+                result.runs.push_back(
+                    regression::runOnce(result.test, opt.limits, opt.seed + i));
+                quiet(false);
+                print(result, i, result.runs.back());
+            }
+            std::cerr << "  mean: " << result.mean() << std::endl;
+        }
+    }
+    else
+    {
+        // The CNN workers are started before the fork and shared by the
+        // jobs. The logger and the report writer are started lazily by the
+        // first search, so each job gets its own.
+        if (not shareCnnWithForks())
+            std::cerr << "A CNN model failed the test query" << std::endl;
+        regression::Limits limits = opt.limits;
+        limits.threads = std::max(1, opt.limits.threads / opt.jobs);
+        std::cerr << "Running " << results.size() << " tests in " << opt.jobs
+                  << " jobs of " << limits.threads << " threads..."
+                  << std::endl;
+        std::vector<std::pair<pid_t, int>> jobs;
+        for (int job = 0; job < opt.jobs; ++job)
+        {
+            int fds[2];
+            if (pipe(fds) != 0) throw std::runtime_error("pipe failed");
+            std::cout.flush();
+            std::cerr.flush();
+            const pid_t pid = fork();
+            if (pid < 0) throw std::runtime_error("fork failed");
+            if (pid == 0)
+            {
+                close(fds[0]);
+                for (const auto& other : jobs) close(other.second);
+                bool ok = true;
+                try
+                {
+                    // the runs are dealt out in turn, so that the slow tests
+                    // are shared by the jobs
+                    std::string lines;
+                    int k = 0;
+                    for (std::size_t t = 0; t < results.size(); ++t)
+                        for (int i = 0; i < opt.repeat; ++i, ++k)
+                        {
+                            if (k % opt.jobs != job) continue;
+                            quiet(true);
+                            const auto run = regression::runOnce(
+                                results[t].test, limits, opt.seed + i);
+                            quiet(false);
+                            print(results[t], i, run);
+                            lines += toLine(Record{t, i, run});
+                        }
+                    ok = writeAll(fds[1], lines);
+                }
+                catch (const std::exception& e)
+                {
+                    quiet(false);
+                    std::cerr << "kropla_regress: job " << job << ": "
+                              << e.what() << std::endl;
+                    ok = false;
+                }
+                close(fds[1]);
+                // exit() and not _exit(), to flush the logs of the job; the
+                // CNN workers are left to the parent
+                std::exit(ok ? 0 : 1);
+            }
+            close(fds[1]);
+            jobs.emplace_back(pid, fds[0]);
+        }
+        std::vector<Record> records;
+        bool failed = false;
+        for (const auto& [pid, fd] : jobs)
+        {
+            for (auto& r : fromLines(readAll(fd))) records.push_back(r);
+            close(fd);
+            int status = 0;
+            while (waitpid(pid, &status, 0) < 0 and errno == EINTR)
+            {
+            }
+            failed = failed or not WIFEXITED(status) or
+                     WEXITSTATUS(status) != 0;
+        }
+        if (failed or
+            records.size() != results.size() * std::size_t(opt.repeat))
+            throw std::runtime_error("a job failed");
+        std::sort(records.begin(), records.end(),
+                  [](const Record& a, const Record& b)
+                  {
+                      return a.test != b.test ? a.test < b.test
+                                              : a.repeat < b.repeat;
+                  });
+        for (const auto& r : records) results[r.test].runs.push_back(r.run);
+        for (const auto& result : results)
+            std::cerr << "  " << result.test.name
+                      << " mean: " << result.mean() << std::endl;
+    }
+    const double wall_s = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+    if (opt.out.empty())
+        writeJson(std::cout, opt, results, wall_s);
+    else
+    {
+        std::ofstream os(opt.out);
+        writeJson(os, opt, results, wall_s);
+    }
+    return 0;
+}
+catch (const std::exception& e)
+{
+    std::cerr << "kropla_regress: " << e.what() << std::endl;
+    usage();
+    return 1;
+}
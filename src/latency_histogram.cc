@@ -0,0 +1,77 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file latency_histogram.cc -- histogram of
+durations for latency percentiles.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+int LatencyHistogram::bucketOf(double micros)
+{
+    if (not(micros >= 1.0)) return 0;
+    const int b = static_cast<int>(4.0 * std::log2(micros)) + 1;
+    return std::min(b, BUCKETS - 1);
+}
+
+double LatencyHistogram::upperBound(int bucket)
+{
+    return std::exp2(bucket / 4.0);
+}
+
+void LatencyHistogram::add(double micros)
+{
+    counts[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+    sum_micros.fetch_add(static_cast<uint64_t>(std::max(micros, 0.0)),
+                         std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+    const uint64_t n = total;
+    return n ? static_cast<double>(sum_micros) / n : 0.0;
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+    const uint64_t n = total;
+    if (n == 0) return 0.0;
+    // rank of the quantile, 1-based
+    const auto rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(std::clamp(p, 0.0, 1.0) * n)));
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS; ++b)
+    {
+        seen += counts[b].load(std::memory_order_relaxed);
+        if (seen >= rank) return upperBound(b);
+    }
+    return upperBound(BUCKETS - 1);
+}
+
+void LatencyHistogram::clear()
+{
+    for (auto& c : counts) c = 0;
+    total = 0;
+    sum_micros = 0;
+}
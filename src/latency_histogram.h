@@ -0,0 +1,54 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file latency_histogram.h -- histogram of
+durations for latency percentiles.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Histogram of durations in microseconds. Bucket b > 0 holds values in
+// [2^((b-1)/4), 2^(b/4)), so percentiles are reported with a relative error
+// below 19%. May be updated and read from many threads at once.
+class LatencyHistogram
+{
+   public:
+    static constexpr int BUCKETS = 128;
+
+    void add(double micros);
+    uint64_t count() const { return total; }
+    double mean() const;
+    // upper bound of the bucket holding the p-th quantile (p in [0, 1]),
+    // 0 if empty
+    double percentile(double p) const;
+    void clear();
+
+   private:
+    static int bucketOf(double micros);
+    static double upperBound(int bucket);
+
+    std::array<std::atomic<uint64_t>, BUCKETS> counts{};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum_micros{0};
+};
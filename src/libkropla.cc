@@ -0,0 +1,264 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file libkropla.cc -- C API of the engine,
+for use in the same process (libkropla.so).
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "libkropla.h"
+
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "analysis.h"
+#include "game.h"
+#include "gtp.h"
+#include "logger.h"
+#include "montecarlo.h"
+#include "report.h"
+
+struct kropla_engine
+{
+    // starts with an empty 39x32 board, as "kropla gtp"
+    explicit kropla_engine(int threads)
+        : gtp("(;FF[4]GM[40]CA[UTF-8]AP[kropla]SZ[39:32])", threads, 0, 0)
+    {
+    }
+    GtpEngine gtp;
+    std::string error;
+    std::string result;
+    kropla_analysis_fn callback{nullptr};
+    void *user_data{nullptr};
+    int interval_ms{200};
+    kropla_stats stats{};
+};
+
+namespace
+{
+// one call at a time, see kropla_engine in libkropla.h
+std::mutex api_mutex;
+std::once_flag configured;
+
+// Executes a command of the protocol of GtpEngine; the result (after "= ")
+// goes to engine->result, the message of an error to engine->error.
+int execute(kropla_engine *engine, const std::string &command)
+{
+    if (engine->callback)
+    {
+        analysis::setCallback([engine](const std::string &line)
+                              { engine->callback(line.c_str(),
+                                                 engine->user_data); },
+                              engine->interval_ms);
+    }
+    const auto response = engine->gtp.execute(command);
+    analysis::setCallback(nullptr, 0);
+    // "= result\n\n" or "? error\n\n"
+    const auto text = response.size() >= 4
+                          ? response.substr(2, response.size() - 4)
+                          : std::string{};
+    if (response.starts_with("="))
+    {
+        engine->result = text;
+        return KROPLA_OK;
+    }
+    engine->error = text;
+    return KROPLA_ERROR;
+}
+
+// runs a search command and keeps its statistics
+int search(kropla_engine *engine, const std::string &command)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const int res = execute(engine, command);
+    if (res != KROPLA_OK) return res;
+    auto &stats = engine->stats;
+    stats.iterations = montec::iterations;
+    stats.playouts = montec::playouts;
+    stats.root_visits = montec::root.t.playouts;
+    stats.cnn_reads = montec::cnnReads;
+    stats.wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    return KROPLA_OK;
+}
+
+template <class F>
+int guarded(kropla_engine *engine, F &&f)
+{
+    if (engine == nullptr) return KROPLA_ERROR;
+    std::lock_guard<std::mutex> lock(api_mutex);
+    try
+    {
+        return f();
+    }
+    catch (const std::exception &e)
+    {
+        engine->error = e.what();
+        return KROPLA_ERROR;
+    }
+}
+
+std::string colourName(int colour)
+{
+    switch (colour)
+    {
+        case KROPLA_TO_MOVE:
+            return "";
+        case KROPLA_BLACK:
+            return "b ";
+        case KROPLA_WHITE:
+            return "w ";
+    }
+    throw std::runtime_error("invalid colour " + std::to_string(colour));
+}
+
+}  // namespace
+
+int kropla_api_version(void) { return KROPLA_API_VERSION; }
+
+kropla_engine *kropla_create(const char *data_dir, int threads)
+{
+    std::lock_guard<std::mutex> lock(api_mutex);
+    try
+    {
+        std::call_once(
+            configured,
+            [data_dir]
+            {
+                std::string dir = data_dir != nullptr ? data_dir : "";
+                if (not dir.empty() and dir.back() != '/') dir += '/';
+                global::program_path = dir;
+                logger::configure(dir + "log.config");
+                report::configure(dir + "report.config",
+                                  dir + "report.ndjson");
+            });
+        return new kropla_engine(threads);
+    }
+    catch (const std::exception &)
+    {
+        return nullptr;
+    }
+}
+
+void kropla_destroy(kropla_engine *engine)
+{
+    std::lock_guard<std::mutex> lock(api_mutex);
+    delete engine;
+}
+
+const char *kropla_last_error(const kropla_engine *engine)
+{
+    return engine != nullptr ? engine->error.c_str() : "no engine";
+}
+
+int kropla_set_position_sgf(kropla_engine *engine, const char *sgf)
+{
+    return guarded(engine,
+                   [&]
+                   {
+                       engine->gtp.setPosition(sgf);
+                       return KROPLA_OK;
+                   });
+}
+
+int kropla_set_position_moves(kropla_engine *engine, int width, int height,
+                              const char *const *moves, size_t count)
+{
+    return guarded(
+        engine,
+        [&]
+        {
+            int res = execute(engine, "boardsize " + std::to_string(width) +
+                                          " " + std::to_string(height));
+            for (size_t i = 0; i < count and res == KROPLA_OK; ++i)
+                res = execute(engine, std::string("play ") + moves[i]);
+            return res;
+        });
+}
+
+int kropla_play(kropla_engine *engine, int colour, const char *move)
+{
+    return guarded(engine,
+                   [&] {
+                       return execute(engine,
+                                      "play " + colourName(colour) + move);
+                   });
+}
+
+int kropla_undo(kropla_engine *engine)
+{
+    return guarded(engine, [&] { return execute(engine, "undo"); });
+}
+
+int kropla_set_komi(kropla_engine *engine, double komi)
+{
+    return guarded(engine,
+                   [&] {
+                       return execute(engine,
+                                      "komi " + std::to_string(komi));
+                   });
+}
+
+const char *kropla_genmove(kropla_engine *engine, int iterations, int msec)
+{
+    const int res = guarded(engine,
+                            [&]
+                            {
+                                engine->gtp.setLimits(iterations, msec);
+                                return search(engine, "genmove");
+                            });
+    return res == KROPLA_OK ? engine->result.c_str() : nullptr;
+}
+
+const char *kropla_analyze(kropla_engine *engine, int msec)
+{
+    const int res =
+        guarded(engine, [&]
+                { return search(engine, "analyze " + std::to_string(msec)); });
+    return res == KROPLA_OK ? engine->result.c_str() : nullptr;
+}
+
+int kropla_set_analysis_callback(kropla_engine *engine,
+                                 kropla_analysis_fn callback, void *user_data,
+                                 int interval_ms)
+{
+    return guarded(engine,
+                   [&]
+                   {
+                       engine->callback = callback;
+                       engine->user_data = user_data;
+                       engine->interval_ms = interval_ms;
+                       return KROPLA_OK;
+                   });
+}
+
+int kropla_get_stats(const kropla_engine *engine, kropla_stats *stats)
+{
+    if (engine == nullptr or stats == nullptr) return KROPLA_ERROR;
+    std::lock_guard<std::mutex> lock(api_mutex);
+    *stats = engine->stats;
+    const Game &game = engine->gtp.getGame();
+    // the history of the empty board has 2 entries
+    stats->move_number = static_cast<int32_t>(game.getHistory().size()) - 1;
+    stats->to_move = game.whoNowMoves();
+    return KROPLA_OK;
+}
@@ -0,0 +1,117 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file libkropla.h -- C API of the engine,
+for use in the same process (libkropla.so).
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#ifndef KROPLA_LIBKROPLA_H
+#define KROPLA_LIBKROPLA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define KROPLA_API __attribute__((visibility("default")))
+#else
+#define KROPLA_API
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Changed when a function or struct of this header changes incompatibly. */
+#define KROPLA_API_VERSION 1
+
+/* Results of the functions returning int. */
+#define KROPLA_OK 0
+#define KROPLA_ERROR (-1)
+
+/* Colours; KROPLA_TO_MOVE is the player who moves now. */
+#define KROPLA_TO_MOVE 0
+#define KROPLA_BLACK 1
+#define KROPLA_WHITE 2
+
+/* One game with its search tree, as in "kropla gtp". Engines may be used
+   from any thread, but the calls are serialised: the search state is global
+   in the process, and every search uses all the threads of its engine. */
+typedef struct kropla_engine kropla_engine;
+
+/* Of the last search (genmove or analyze) of the engine. */
+typedef struct kropla_stats
+{
+    int64_t iterations;
+    int64_t playouts; /* really played, not replaced by the CNN value */
+    int64_t root_visits;
+    int64_t cnn_reads;
+    int64_t wall_ms;
+    int32_t move_number; /* of the next move in the engine, from 1 */
+    int32_t to_move;     /* KROPLA_BLACK or KROPLA_WHITE */
+} kropla_stats;
+
+/* Called with a line of JSON with the best moves during a search (see
+   analysis.h), by the thread that called genmove or analyze. */
+typedef void (*kropla_analysis_fn)(const char *json, void *user_data);
+
+KROPLA_API int kropla_api_version(void);
+
+/* data_dir holds patterns.bin and the config files (cnn.config, log.config
+   and so on) and gets report.ndjson; it is taken from the first engine
+   created, NULL means the current directory. The board is empty, 39x32.
+   Returns NULL on error. */
+KROPLA_API kropla_engine *kropla_create(const char *data_dir, int threads);
+KROPLA_API void kropla_destroy(kropla_engine *engine);
+/* message of the last error of the engine, valid until its next call */
+KROPLA_API const char *kropla_last_error(const kropla_engine *engine);
+
+/* the position at the end of the main variation of sgf */
+KROPLA_API int kropla_set_position_sgf(kropla_engine *engine, const char *sgf);
+/* an empty board and moves played in turn, black first; moves are in sgf
+   coordinates, with enclosures as in the sgf, e.g. "cd.bcccdcdbbc" */
+KROPLA_API int kropla_set_position_moves(kropla_engine *engine, int width,
+                                         int height, const char *const *moves,
+                                         size_t count);
+KROPLA_API int kropla_play(kropla_engine *engine, int colour,
+                           const char *move);
+KROPLA_API int kropla_undo(kropla_engine *engine);
+KROPLA_API int kropla_set_komi(kropla_engine *engine, double komi);
+
+/* Searches for at most iterations (a negative value: CNN only) and msec
+   (0: no limit) and plays the move; returns it in sgf coordinates, valid
+   until the next call, or NULL on error. */
+KROPLA_API const char *kropla_genmove(kropla_engine *engine, int iterations,
+                                      int msec);
+/* Searches the position for msec without playing; returns a JSON array of
+   the best moves, valid until the next call, or NULL on error. */
+KROPLA_API const char *kropla_analyze(kropla_engine *engine, int msec);
+/* the callback for the next searches of the engine; NULL turns it off */
+KROPLA_API int kropla_set_analysis_callback(kropla_engine *engine,
+                                            kropla_analysis_fn callback,
+                                            void *user_data, int interval_ms);
+KROPLA_API int kropla_get_stats(const kropla_engine *engine,
+                                kropla_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* KROPLA_LIBKROPLA_H */
@@ -0,0 +1,251 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file logger.cc -- leveled logging without
+stream I/O in the search threads.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "logger.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace logger
+{
+std::atomic<int> current_level{static_cast<int>(Level::info)};
+
+namespace
+{
+constexpr std::size_t QUEUE_SIZE = 1024;  // lines per thread
+constexpr auto FLUSH_PERIOD = std::chrono::milliseconds(20);
+
+struct Entry
+{
+    uint64_t seq{0};
+    std::string text;
+};
+
+// written by its thread (head), read by the flusher (tail)
+struct ThreadQueue
+{
+    std::array<Entry, QUEUE_SIZE> entries;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    bool in_use{true};  // under queues_mutex
+
+    bool push(uint64_t seq, std::string &&text)
+    {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= QUEUE_SIZE)
+            return false;
+        entries[h % QUEUE_SIZE] = Entry{seq, std::move(text)};
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    void popAll(std::vector<Entry> &out)
+    {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+        const uint64_t h = head.load(std::memory_order_acquire);
+        for (uint64_t i = t; i < h; ++i)
+            out.push_back(std::move(entries[i % QUEUE_SIZE]));
+        tail.store(h, std::memory_order_release);
+    }
+};
+
+std::atomic<uint64_t> next_seq{0};
+std::atomic<uint64_t> dropped{0};
+
+std::mutex queues_mutex;
+std::vector<std::unique_ptr<ThreadQueue>> queues;
+
+// one consumer at a time: the flusher thread or flush()
+std::mutex drain_mutex;
+std::function<void(std::string_view)> sink;
+
+std::once_flag flusher_started;
+std::mutex flusher_mutex;
+std::condition_variable flusher_cv;
+bool stop_flusher{false};
+std::atomic<bool> stopped{false};
+std::thread *flusher{nullptr};  // never deleted, see Shutdown
+pid_t owner_pid{0};
+
+void writeOut(std::string_view text)
+{
+    if (sink)
+        sink(text);
+    else
+    {
+        std::fwrite(text.data(), 1, text.size(), stderr);
+        std::fflush(stderr);
+    }
+}
+
+void drain()
+{
+    std::lock_guard<std::mutex> drain_lock(drain_mutex);
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(queues_mutex);
+        for (auto &q : queues) q->popAll(entries);
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) { return a.seq < b.seq; });
+    std::string text;
+    for (const auto &e : entries) text += e.text;
+    if (const auto n = dropped.exchange(0))
+        text += "[log] " + std::to_string(n) + " lines dropped\n";
+    if (not text.empty()) writeOut(text);
+}
+
+void runFlusher()
+{
+    std::unique_lock<std::mutex> lock(flusher_mutex);
+    while (not stop_flusher)
+    {
+        flusher_cv.wait_for(lock, FLUSH_PERIOD);
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+ThreadQueue *claimQueue()
+{
+    std::call_once(flusher_started,
+                   []
+                   {
+                       owner_pid = getpid();
+                       flusher = new std::thread(runFlusher);
+                   });
+    std::lock_guard<std::mutex> lock(queues_mutex);
+    for (auto &q : queues)
+    {
+        if (not q->in_use)
+        {
+            q->in_use = true;
+            return q.get();
+        }
+    }
+    queues.push_back(std::make_unique<ThreadQueue>());
+    return queues.back().get();
+}
+
+struct QueueHolder
+{
+    ThreadQueue *queue{nullptr};
+    ~QueueHolder()
+    {
+        if (queue == nullptr) return;
+        // the lines stay queued for the flusher
+        std::lock_guard<std::mutex> lock(queues_mutex);
+        queue->in_use = false;
+    }
+};
+
+thread_local QueueHolder holder;
+
+// Stops the flusher at exit, after writing the remaining lines. In a forked
+// child the thread does not exist, so there is nothing to stop.
+struct Shutdown
+{
+    ~Shutdown()
+    {
+        if (flusher == nullptr or getpid() != owner_pid) return;
+        {
+            std::lock_guard<std::mutex> lock(flusher_mutex);
+            stop_flusher = true;
+        }
+        flusher_cv.notify_one();
+        flusher->join();
+        stopped = true;
+        drain();
+    }
+} shutdown_at_exit;
+
+}  // namespace
+
+void setLevel(Level level) { current_level = static_cast<int>(level); }
+
+std::optional<Level> parseLevel(const std::string &name)
+{
+    constexpr std::array<std::pair<const char *, Level>, 4> names{
+        {{"error", Level::error},
+         {"warning", Level::warning},
+         {"info", Level::info},
+         {"debug", Level::debug}}};
+    for (const auto &[n, level] : names)
+        if (name == n) return level;
+    return std::nullopt;
+}
+
+void configure(const std::string &config_file)
+{
+    std::ifstream file(config_file);
+    std::string name;
+    if (not(file >> name)) return;
+    if (const auto level = parseLevel(name))
+    {
+        setLevel(*level);
+        std::cerr << "Log level: " << name << std::endl;
+    }
+    else
+        std::cerr << "Unknown log level " << name << " in " << config_file
+                  << std::endl;
+}
+
+void setSink(std::function<void(std::string_view)> new_sink)
+{
+    std::lock_guard<std::mutex> drain_lock(drain_mutex);
+    sink = std::move(new_sink);
+}
+
+void flush() { drain(); }
+
+Line::~Line()
+{
+    std::string text = os.str();
+    if (text.empty() or text.back() != '\n') text += '\n';
+    if (stopped)
+    {
+        writeOut(text);
+        return;
+    }
+    if (holder.queue == nullptr) holder.queue = claimQueue();
+    if (not holder.queue->push(next_seq++, std::move(text))) ++dropped;
+    // errors are not left waiting, in case the program is about to die
+    if (level == Level::error) flush();
+}
+
+}  // namespace logger
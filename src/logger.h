@@ -0,0 +1,91 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file logger.h -- leveled logging without
+stream I/O in the search threads.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+// Usage: KROPLA_LOG(debug) << "iteration " << i;
+// The arguments are not evaluated if the level is off. A line goes into a
+// queue of the calling thread (one producer, one consumer, no locks) and a
+// background thread writes the queued lines of all threads, in order, to
+// stderr (or the sink) every few milliseconds. If a queue is full, the line
+// is dropped and counted.
+// The background thread is not there in processes forked from this one, so
+// the CNN workers do not log this way.
+namespace logger
+{
+enum class Level
+{
+    error,
+    warning,
+    info,
+    debug
+};
+
+extern std::atomic<int> current_level;
+
+inline bool isEnabled(Level level)
+{
+    return static_cast<int>(level) <=
+           current_level.load(std::memory_order_relaxed);
+}
+
+void setLevel(Level level);
+// "error", "warning", "info" or "debug"
+std::optional<Level> parseLevel(const std::string &name);
+// sets the level from the first word of the file, if it exists (the
+// default is info)
+void configure(const std::string &config_file);
+// where the lines go, stderr by default; called from one thread at a time
+void setSink(std::function<void(std::string_view)> sink);
+// writes all the lines queued until now
+void flush();
+
+class Line
+{
+   public:
+    explicit Line(Level level) : level{level} {}
+    ~Line();
+    Line(const Line &) = delete;
+    Line &operator=(const Line &) = delete;
+    std::ostream &stream() { return os; }
+
+   private:
+    Level level;
+    std::ostringstream os;
+};
+
+}  // namespace logger
+
+// (a loop rather than if-else, so that it may follow an if without braces)
+#define KROPLA_LOG(level)                                                      \
+    for (bool kropla_log_on = ::logger::isEnabled(::logger::Level::level);     \
+         kropla_log_on; kropla_log_on = false)                                 \
+    ::logger::Line(::logger::Level::level).stream()
@@ -40,12 +40,20 @@ class CnnProxy
    public:
     virtual ~CnnProxy() = default;
     virtual bool is_ready() const = 0;
+    // Implementation specific options, from the optional 5th line of the
+    // config file; must be called before load().
+    virtual void set_options(const std::string& /*options*/) {}
     virtual void load(const std::string& model_file,
                       const std::string& weights_file, int default_size) = 0;
     virtual void init(int size, const std::string& model_file,
                       const std::string& weights_file, int default_size) = 0;
-    virtual std::vector<float> get_data(float* data, int size, int planes,
-                                        int psize) = 0;
+    // Writes size*psize softmaxed probabilities to output, followed by the
+    // value of the position for the player to move, in [-1, 1], or NaN if
+    // the net has no value head; so output holds size*psize+1 floats. It may
+    // alias data (the input is not read after the forward pass).
+    virtual void get_data(float* data, int size, int planes, int psize,
+                          float* output) = 0;
+    virtual bool has_value() const { return false; }
 };
 
 std::unique_ptr<CnnProxy> buildTorch();
@@ -24,10 +24,13 @@
 
 #include "montecarlo.h"
 
+#include <sys/resource.h>
+
 #include <algorithm>
 #include <array>
 #include <atomic>
 #include <chrono>  // chrono::high_resolution_clock, only to measure elapsed time
+#include <cmath>
 #include <condition_variable>
 #include <filesystem>
 #include <fstream>
@@ -35,17 +38,103 @@
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <span>
+#include <sstream>
 #include <thread>
+#include <vector>
 
+#include "analysis.h"
 #include "command.h"
 #include "game.h"
 #include "get_cnn_prob.h"
+#include "logger.h"
+#include "playout_board.h"
+#include "profiler.h"
+#include "report.h"
+#include "trace.h"
 
 /********************************************************************************************************
   Montecarlo class for Monte Carlo search.
 *********************************************************************************************************/
 std::mutex mutex_finish_threads;
 std::condition_variable cv_finish_threads;
+namespace
+{
+// Order of the iterations of a lockstep search (MonteCarlo::Determinism).
+// Iteration k selects its leaf after the selections before it and after the
+// backups up to k - threads, and it backs up its result after the backups
+// before it and after the selections up to k + threads - 1. Every selection
+// then sees the same backups, whatever the timing of the threads.
+class Lockstep
+{
+   public:
+    void reset(int64_t iterations, int threads_count)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        total = iterations;
+        threads = threads_count;
+        selected = played = backed_up = 0;
+    }
+    void waitForSelection(int64_t k)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock,
+                [&] { return selected == k and backed_up > k - threads; });
+    }
+    void selectionDone()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++selected;
+        }
+        cv.notify_all();
+    }
+    // waits until the playouts of the iterations before k (the one holding
+    // the selection) are done, so that none of them reads the komi
+    void waitForPlayouts(int64_t k)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return played == k; });
+    }
+    // marks the playout of k as done and waits for the turn of its backup
+    void waitForBackup(int64_t k)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ++played;
+        cv.notify_all();
+        cv.wait(lock,
+                [&] {
+                    return backed_up == k and
+                           selected >= std::min(k + threads, total);
+                });
+    }
+    void backupDone()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++backed_up;
+        }
+        cv.notify_all();
+    }
+    void waitForAll()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return backed_up == total; });
+    }
+
+   private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    int64_t total{0};
+    int64_t threads{1};
+    int64_t selected{0};
+    int64_t played{0};
+    int64_t backed_up{0};
+};
+
+Lockstep lockstep;
+}  // namespace
+
 namespace montec
 {
 Treenode root;
@@ -58,6 +147,7 @@ std::array<std::atomic<int64_t>, 10> generateMovesCount_depths{0, 0, 0, 0, 0,
                                                                0, 0, 0, 0, 0};
 std::atomic<int64_t> cnnReads{0};
 std::atomic<int64_t> redundantGenerateMovesCount{0};
+std::atomic<int64_t> playouts{0};
 
 DebugInfo root_debug_info;
 
@@ -67,23 +157,299 @@ constexpr int start_increasing = 200;
 constexpr real_t increase_komi_threshhold = 0.75;
 constexpr real_t decrease_komi_threshhold = 0.45;
 constexpr int MC_EXPAND_THRESHOLD = 8;
+constexpr int max_depth_for_cnn = 12;
+// a kept tree is dropped when its allocators hold more nodes
+constexpr std::size_t max_kept_nodes = 2'000'000;
 constexpr int komi_step = 2;
 auto take_next_komi_change = [](auto curr_komi_change)
 { return curr_komi_change + 8000; };
 
-bool save_mc_stats = false;
+// the MonteCarlo object whose tree has montec::root as its root
+MonteCarlo *root_owner{nullptr};
+
+// weight of the CNN value in the result of a simulation, from
+// cnnvalue.config; 0: playouts only, 1: no playouts
+real_t cnn_value_weight = 0.0;
+
+// After the children of node are sorted, their own children still point to
+// the old places of their parents.
+void fixParentsOfGrandchildren(Treenode *node)
+{
+    for (Treenode *ch = node->children; ch != nullptr; ++ch)
+    {
+        for (Treenode *gch = ch->children; gch != nullptr; ++gch)
+        {
+            gch->parent = ch;
+            if (gch->isLast()) break;
+        }
+        if (ch->isLast()) break;
+    }
+}
+
+// State of the program when the search of one move starts.
+struct SearchStart
+{
+    std::chrono::steady_clock::time_point time{
+        std::chrono::steady_clock::now()};
+    int komi{global::komi};
+    int komi_ratchet{global::komi_ratchet};
+    CnnStats cnn{getCnnStats()};
+};
+
+// Prints the profile of the search of one move, if the profiler is compiled
+// in, and returns it as JSON (empty if it is not).
+std::string profileOfMove(int threads, int64_t iterations, int64_t wall_nanos)
+{
+    if constexpr (not prof::enabled) return {};
+    const auto totals = prof::collect();
+    std::cerr << "Profile (" << iterations << " iterations, "
+              << wall_nanos / 1000000 << " ms, threads=" << threads
+              << "):" << std::endl;
+    prof::printTable(std::cerr, totals, wall_nanos * threads);
+    std::ostringstream json;
+    prof::writeJson(json, totals);
+    return json.str();
+}
+
+// number of nodes below node
+int64_t countTree(const Treenode *node)
+{
+    int64_t count = 0;
+    std::vector<const Treenode *> stack{node};
+    while (not stack.empty())
+    {
+        const Treenode *child = stack.back()->children;
+        stack.pop_back();
+        for (; child != nullptr; ++child)
+        {
+            ++count;
+            stack.push_back(child);
+            if (child->isLast()) break;
+        }
+    }
+    return count;
+}
+
+// Queues the line of report.ndjson about the search of one move. It must be
+// called while the tree still exists, i.e., before the search threads are let
+// go; the file is written by the report thread.
+void reportMove(const Game &pos, int threads, int64_t iterations,
+                const SearchStart &start)
+{
+    const auto wall_nanos =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start.time)
+            .count();
+    const auto profile = profileOfMove(threads, iterations, wall_nanos);
+    if (not report::isOpen()) return;
+    const double seconds = std::max<double>(wall_nanos, 1) * 1e-9;
+
+    const auto cnn = getCnnStats();
+    const auto queries = cnn.ht_queries - start.cnn.ht_queries;
+    const auto answers = cnn.ht_answers - start.cnn.ht_answers;
+    report::JsonObject cnn_json;
+    cnn_json.add("reads", cnnReads.load())
+        .add("ht_queries", queries)
+        .add("ht_answers", answers)
+        .add("ht_hit_rate", queries > 0 ? double(answers) / queries : NAN)
+        .add("speculative_saved",
+             cnn.speculative_saved - start.cnn.speculative_saved)
+        .add("speculative_used",
+             cnn.speculative_used - start.cnn.speculative_used);
+
+    report::JsonObject komi_json;
+    komi_json.add("start", start.komi)
+        .add("end", global::komi)
+        .add("ratchet_start", start.komi_ratchet)
+        .add("ratchet_end", global::komi_ratchet);
+
+    const auto children = analysis::snapshot(root, 10, 0);
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    report::JsonObject line;
+    line.add("type", "move")
+        .add("move", pos.getHistory().size() + 1)
+        .add("best",
+             root.children != nullptr ? root.children[0].getMoveSgf() : "")
+        .add("threads", threads)
+        .add("iterations", iterations)
+        .add("wall_ms", wall_nanos / 1000000)
+        .add("iterations_per_s", iterations / seconds)
+        .add("playouts", playouts.load())
+        .add("playouts_per_s", playouts.load() / seconds)
+        .add("tree_nodes", countTree(&root))
+        .add("expansions", generateMovesCount.load())
+        .add("peak_rss_kb", static_cast<int64_t>(usage.ru_maxrss))
+        .addRaw("cnn", cnn_json.str())
+        .addRaw("komi", komi_json.str())
+        .add("pv", analysis::bestContinuation(&root, 15))
+        .addRaw("children", analysis::toJson(children));
+    if (not profile.empty()) line.addRaw("profile", profile);
+    report::write(line.str());
+}
+
+// With analysis on (analysis.config), writes a line with the best moves so
+// far in the search of the move after pos.
+void publishAnalysis(const Game &pos, const SearchStart &start, bool final)
+{
+    if (not analysis::isEnabled()) return;
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - start.time)
+                             .count();
+    const auto moves = analysis::snapshot(root, analysis::topN(), 15);
+    analysis::publish(report::JsonObject()
+                          .add("type", "analysis")
+                          .add("move", pos.getHistory().size() + 1)
+                          .add("final", final)
+                          .add("elapsed_ms", elapsed)
+                          .add("iterations", iterations.load())
+                          .add("komi", global::komi)
+                          .addRaw("moves", analysis::toJson(moves))
+                          .str());
+}
+
+// With tracing on (trace.config), writes the timeline of the search of one
+// move to trace-<move number>.json.
+void writeTrace(const Game &pos)
+{
+    if (not trace::isEnabled()) return;
+    const auto name = global::program_path + "trace-" +
+                      std::to_string(pos.getHistory().size() + 1) + ".json";
+    std::ofstream file(name);
+    trace::writeChromeJson(file);
+    std::cerr << "Trace written to " << name << std::endl;
+}
 }  // namespace montec
 
 MonteCarlo::MonteCarlo()  //: finish_sim(false), finish_threads(false),
                           // finished_threads(0), iterations(0)
 {
     montec::root.parent = &montec::root;
-    montec::save_mc_stats = std::filesystem::exists("savemc.config");
+    trace::setEnabled(
+        std::filesystem::exists(global::program_path + "trace.config"));
+    PlayoutBoard::setEnabled(
+        std::filesystem::exists(global::program_path + "playoutboard.config"));
+    std::ifstream value_config(global::program_path + "cnnvalue.config");
+    if (value_config >> montec::cnn_value_weight)
+    {
+        montec::cnn_value_weight =
+            std::clamp<real_t>(montec::cnn_value_weight, 0.0, 1.0);
+        std::cerr << "CNN value weight: " << montec::cnn_value_weight
+                  << std::endl;
+    }
+}
+
+MonteCarlo::~MonteCarlo()
+{
+    clearTree();
+    if (montec::root_owner == this) montec::root_owner = nullptr;
+}
+
+void MonteCarlo::clearTree()
+{
+    if (has_tree and montec::root_owner == this)
+    {
+        montec::root = Treenode();
+        montec::root.parent = &montec::root;
+    }
+    has_tree = false;
+    parked_root.reset();
+    allocators.clear();
+}
+
+std::size_t MonteCarlo::keptNodes() const
+{
+    std::size_t capacity = 0;
+    for (const auto &alloc : allocators) capacity += alloc->capacity();
+    return capacity;
+}
+
+void MonteCarlo::takeRoot()
+{
+    if (montec::root_owner == this) return;
+    if (montec::root_owner != nullptr) montec::root_owner->parkRoot();
+    montec::root_owner = this;
+    montec::root = parked_root ? *parked_root : Treenode();
+    montec::root.parent = &montec::root;
+    parked_root.reset();
+}
+
+// The children keep pointing to montec::root as their parent, which is right
+// again when the root is taken back.
+void MonteCarlo::parkRoot()
+{
+    if (has_tree) parked_root = std::make_unique<Treenode>(montec::root);
+    montec::root = Treenode();
+    montec::root.parent = &montec::root;
+    montec::root_owner = nullptr;
+}
+
+/// Makes the node of the kept tree for the position pos (the root, a child or
+/// a grandchild) the new root. Returns false if there is no such node.
+bool MonteCarlo::reuseTree(const Game &pos)
+{
+    if (not has_tree) return false;
+    const auto isPos = [&pos](const Treenode &node)
+    {
+        const auto game = node.game_ptr.load();
+        return game != nullptr and game->getZobrist() == pos.getZobrist() and
+               game->getHistory().size() == pos.getHistory().size();
+    };
+    const Treenode *found = isPos(montec::root) ? &montec::root : nullptr;
+    for (const Treenode *ch = montec::root.children;
+         found == nullptr and ch != nullptr; ++ch)
+    {
+        if (isPos(*ch)) found = ch;
+        for (const Treenode *gch = ch->children;
+             found == nullptr and gch != nullptr; ++gch)
+        {
+            if (isPos(*gch)) found = gch;
+            if (gch->isLast()) break;
+        }
+        if (ch->isLast()) break;
+    }
+    if (found == nullptr or found->children == nullptr or
+        keptNodes() > montec::max_kept_nodes)
+    {
+        return false;
+    }
+    const uint32_t depth = found->getDepth();
+    if (found != &montec::root) montec::root = *found;
+    montec::root.parent = &montec::root;
+    montec::root.flags = 0;
+    montec::root.game_ptr = std::make_shared<Game>(pos);
+    std::cerr << "Reusing the tree, root playouts = " << montec::root.t.playouts
+              << std::endl;
+    if (depth == 0) return true;
+    // the depths are counted from the new root
+    std::vector<Treenode *> stack;
+    for (Treenode *ch = montec::root.children; true; ++ch)
+    {
+        ch->parent = &montec::root;
+        stack.push_back(ch);
+        if (ch->isLast()) break;
+    }
+    while (not stack.empty())
+    {
+        Treenode *node = stack.back();
+        stack.pop_back();
+        const uint32_t new_depth = node->getDepth() - depth;
+        node->flags &= ~Treenode::DEPTH_MASK;
+        node->setDepth(new_depth);
+        for (Treenode *ch = node->children; ch != nullptr; ++ch)
+        {
+            stack.push_back(ch);
+            if (ch->isLast()) break;
+        }
+    }
+    return true;
 }
 
 std::string MonteCarlo::findBestMove(Game &pos, int iter_count)
 {
     debug_previous_count = -1;
+    takeRoot();
+    clearTree();
     montec::root = Treenode();
     montec::root.move = pos.getLastMove();
     montec::root.parent = &montec::root;
@@ -91,6 +457,12 @@ std::string MonteCarlo::findBestMove(Game &pos, int iter_count)
     initialiseCnn();
     clearLastGoodReplies();
     std::cerr << "Descend starts, komi==" << global::komi << std::endl;
+    montec::generateMovesCount = 0;
+    montec::cnnReads = 0;
+    montec::playouts = 0;
+    prof::reset();
+    trace::clear();
+    const montec::SearchStart search_start;
 #ifdef DEBUG_SGF
     pos.sgf_tree.saveCursor();
 #endif
@@ -103,7 +475,7 @@ std::string MonteCarlo::findBestMove(Game &pos, int iter_count)
 #ifdef DEBUG_SGF
         pos.sgf_tree.restoreCursor();
 #endif
-        if ((i & 0x7f) == 0) std::cerr << "iteration = " << i << std::endl;
+        if ((i & 0x7f) == 0) KROPLA_LOG(debug) << "iteration = " << i;
         if (i >= komi_change_at)
         {
             komi_change_at = montec::take_next_komi_change(komi_change_at);
@@ -151,7 +523,7 @@ std::string MonteCarlo::findBestMove(Game &pos, int iter_count)
                 std::cerr << global::komi << std::endl;
             }
         }
-        descend(alloc, &montec::root, seed + i);
+        descend(alloc, &montec::root, seed + i, -1);
     }
     std::cerr << "Descend ends" << std::endl;
     assert(pos.checkRootListOfMovesCorrectness(montec::root.children));
@@ -169,6 +541,7 @@ std::string MonteCarlo::findBestMove(Game &pos, int iter_count)
                              t2.t.playouts - t2.prior.playouts;
                   });
         montec::root.children[n - 1].markAsLast();
+        montec::fixParentsOfGrandchildren(&montec::root);
     }
     std::cerr << "Sort ends, root.children.size()==" << n << ", root value = "
               << montec::root.t.value_sum / montec::root.t.playouts
@@ -197,6 +570,7 @@ std::string MonteCarlo::findBestMove(Game &pos, int iter_count)
                                      t2.t.playouts - t2.prior.playouts;
                           });
                 montec::root.children[i].children[nn - 1].markAsLast();
+                montec::fixParentsOfGrandchildren(&montec::root.children[i]);
             }
             for (int j = 0; /*j<15 &&*/ j < nn; j++)
             {
@@ -208,10 +582,12 @@ std::string MonteCarlo::findBestMove(Game &pos, int iter_count)
             }
         }
     }
+    prof::flushThread();
+    logger::flush();
+    montec::reportMove(pos, 1, iter_count, search_start);
+    montec::writeTrace(pos);
     if (montec::root.children != nullptr)
     {
-        const int max_moves = n;
-        saveMCstats(n, max_moves, false);
         return montec::root.children[0].getMoveSgf();
     }
     else
@@ -220,78 +596,9 @@ std::string MonteCarlo::findBestMove(Game &pos, int iter_count)
     }
 }
 
-void MonteCarlo::saveMCstats(int n, int max_moves, bool saveCnnStats) const
-{
-    if (montec::save_mc_stats)
-    {
-        const auto filename = "mcstats.txt";
-        std::fstream file(filename, std::fstream::out | std::fstream::app |
-                                        std::fstream::ate);
-        file << montec::root.children[0].getMoveSgf();
-        const int limit = std::min(n, max_moves);
-        std::map<pti, uint32_t> playouts_per_move;
-        for (int i = 0; i < limit; ++i)
-        {
-            const auto playouts = (montec::root.children[i].t.playouts -
-                                   montec::root.children[i].prior.playouts);
-            if (playouts == 0) continue;
-            const auto ind = montec::root.children[i].move.ind;
-            if (auto it = playouts_per_move.find(ind);
-                it == playouts_per_move.end())
-            {
-                playouts_per_move[ind] = playouts;
-            }
-            else
-            {
-                it->second += playouts;
-            }
-        }
-        if (not playouts_per_move.empty())
-        {
-            file << "LB";
-            for (auto [move_ind, playouts] : playouts_per_move)
-                file << "[" << coord.indToSgf(move_ind) << ":" << playouts
-                     << "]";
-            file << '\n';
-        }
-        if (saveCnnStats)
-        {
-            file << "C[";
-            for (int i = 0; i < limit; ++i)
-            {
-                const auto playouts = (montec::root.children[i].t.playouts -
-                                       montec::root.children[i].prior.playouts);
-                if (playouts == 0) break;
-                file << i << " "
-                     << coord.indToSgf(montec::root.children[i].move.ind)
-                     << ": " << playouts
-                     << "  cnn: " << montec::root.children[i].cnn_prob << "\n";
-            }
-            using MoveCnnProb = std::pair<pti, float>;
-            std::vector<MoveCnnProb> moves_cnn(n, MoveCnnProb{0, -1.0f});
-            std::transform(montec::root.children.load(),
-                           montec::root.children.load() + n, moves_cnn.begin(),
-                           [](const auto &node) {
-                               return MoveCnnProb{node.move.ind, node.cnn_prob};
-                           });
-
-            std::sort(moves_cnn.begin(), moves_cnn.end(),
-                      [](const MoveCnnProb &mc1, const MoveCnnProb &mc2)
-                      { return mc1.second > mc2.second; });
-            file << "\nCNN:\n";
-            for (int i = 0; i < limit; ++i)
-            {
-                if (moves_cnn[i].second < 1e-4) break;
-                file << i << " " << coord.indToSgf(moves_cnn[i].first) << ": "
-                     << moves_cnn[i].second << "\n";
-            }
-            file << "]" << std::endl;
-        }
-    }
-}
-
 Treenode *MonteCarlo::selectBestChild(Treenode *node) const
 {
+    KROPLA_PROFILE_SCOPE(select);
     Treenode *ch = node->children;
     Treenode *best = ch;
     real_t bestv = -1e5;
@@ -325,8 +632,14 @@ std::shared_ptr<Game> MonteCarlo::getCopyOfGame(Treenode *node) const
 void MonteCarlo::expandNode(TreenodeAllocator &alloc, Treenode *node,
                             Game *game, int depth) const
 {
-    constexpr int max_depth_for_cnn = 12;
-    std::unique_lock<std::mutex> lock_children(node->children_mutex);
+    KROPLA_PROFILE_SCOPE(expand);
+    const trace::Span span("expandNode");
+    std::unique_lock<std::mutex> lock_children(node->children_mutex,
+                                               std::defer_lock);
+    {
+        const trace::Span lock_span("children_mutex");
+        lock_children.lock();
+    }
     if (node->children != nullptr) return;
     auto debug_info =
         game->generateListOfMoves(alloc, node, depth, node->move.who ^ 3);
@@ -334,7 +647,7 @@ void MonteCarlo::expandNode(TreenodeAllocator &alloc, Treenode *node,
         depth, montec::generateMovesCount_depths.size() - 1)];
     if (node->children == nullptr)
     {
-        if (depth > max_depth_for_cnn)
+        if (depth > montec::max_depth_for_cnn)
         {
             node->children = alloc.getLastBlock();
         }
@@ -342,6 +655,7 @@ void MonteCarlo::expandNode(TreenodeAllocator &alloc, Treenode *node,
         {
             auto lastBlock = alloc.getLastBlock();
             ++montec::cnnReads;
+            const trace::Span priors_span("updatePriors");
             updatePriors(*game, lastBlock, depth);
             node->children = lastBlock;
         }
@@ -365,12 +679,17 @@ void MonteCarlo::expandNode(TreenodeAllocator &alloc, Treenode *node,
 }
 
 void MonteCarlo::descend(TreenodeAllocator &alloc, Treenode *node,
-                         unsigned seed)
+                         unsigned seed, int64_t iteration)
 {
+    const bool in_lockstep = (iteration >= 0);
+    const trace::Span span("descend");
     int depth = 1;
     std::shared_ptr<Game> game_ptr;
+    // whether node has just been expanded by this descent
+    bool expanded = false;
     for (;;)
     {
+        expanded = false;
         if (node->children == nullptr)
         {
             game_ptr = getCopyOfGame(node);
@@ -381,11 +700,18 @@ void MonteCarlo::descend(TreenodeAllocator &alloc, Treenode *node,
                            montec::MC_EXPAND_THRESHOLD))
         {
             expandNode(alloc, node, game_ptr.get(), depth);
+            expanded = (node->children != nullptr);
         }
         if (node->children == nullptr)
         {
             break;
         }
+        // a node just given its priors by a net with a value head is the
+        // leaf, its value comes with the priors
+        if (expanded and montec::cnn_value_weight > 0 and node->cnn_value >= 0)
+        {
+            break;
+        }
         node = selectBestChild(node);
 #ifdef DEBUG_SGF
         Game::sgf_tree.makePartialMove({(node->move.who == 1 ? "B" : "W"),
@@ -397,27 +723,52 @@ void MonteCarlo::descend(TreenodeAllocator &alloc, Treenode *node,
         node->t.playouts += node->getVirtualLoss();
         ++depth;
     }
+    if (in_lockstep) lockstep.selectionDone();
+    const real_t cnn_value = expanded ? node->cnn_value.load() : -1.0;
     game_ptr->seedRandomEngine(seed);
-    game_ptr->rollout(node, depth);
+    {
+        const trace::Span rollout_span("rollout");
+        if (in_lockstep)
+        {
+            game_ptr->rollout(
+                node, depth, cnn_value, montec::cnn_value_weight,
+                [iteration] { lockstep.waitForBackup(iteration); });
+            lockstep.backupDone();
+        }
+        else
+            game_ptr->rollout(node, depth, cnn_value,
+                              montec::cnn_value_weight);
+    }
+    if (cnn_value < 0 or montec::cnn_value_weight < 1) ++montec::playouts;
 }
 
 int MonteCarlo::runSimulations(int max_iter_count, unsigned thread_no,
                                unsigned threads_count)
 {
     int komi_change_at = montec::start_increasing;
-    TreenodeAllocator alloc;
+    TreenodeAllocator &alloc = *allocators[thread_no];
     int i = 0;
-    std::cerr << "*** Starting ratchet: " << global::komi_ratchet << std::endl;
+    KROPLA_LOG(info) << "*** Starting ratchet: " << global::komi_ratchet;
+    trace::setThreadName("search " + std::to_string(thread_no));
     bool was_komi_change = false;
+    const bool deterministic = (determinism != Determinism::off);
+    const bool in_lockstep = (determinism == Determinism::lockstep);
+    if (deterministic) clearLastGoodReplies();
     for (;;)
     {
+        // number of the iteration in a deterministic search
+        const int64_t k = thread_no + int64_t{threads_count} * i;
+        if (deterministic and k >= max_iter_count) break;
+        if (in_lockstep) lockstep.waitForSelection(k);
         if ((i & 0x7f) == 0)
-            std::cerr << "thr " << thread_no << ", iteration = " << i
-                      << std::endl;
+            KROPLA_LOG(debug) << "thr " << thread_no << ", iteration = " << i;
         if (thread_no == 0)
         {
-            if (montec::iterations >= komi_change_at)
+            if ((deterministic ? k : montec::iterations.load()) >=
+                komi_change_at)
             {
+                const trace::Span komi_span("komi adjustment");
+                if (in_lockstep) lockstep.waitForPlayouts(k);
                 komi_change_at = montec::take_next_komi_change(komi_change_at);
                 if (montec::root.t.value_sum <
                     montec::root.t.playouts *
@@ -426,19 +777,18 @@ int MonteCarlo::runSimulations(int max_iter_count, unsigned thread_no,
                     int perspective = 2 * montec::root.move.who -
                                       3;  // -1 if we are white, 1 if black
                                           // (root.move.who is the opponent)
-                    std::cerr << "Green zone; komi = " << global::komi
-                              << ", perspective = " << perspective
-                              << ", ratchet = " << global::komi_ratchet
-                              << std::endl;
+                    KROPLA_LOG(info) << "Green zone; komi = " << global::komi
+                                     << ", perspective = " << perspective
+                                     << ", ratchet = " << global::komi_ratchet;
                     if (global::komi * perspective < global::komi_ratchet)
                     {
-                        std::cerr << "Changing komi from " << global::komi
-                                  << " to ";
+                        const int old_komi = global::komi;
                         global::komi += (montec::root.move.who == 1)
                                             ? -montec::komi_step
                                             : montec::komi_step;
                         was_komi_change = true;
-                        std::cerr << global::komi << std::endl;
+                        KROPLA_LOG(info) << "Changing komi from " << old_komi
+                                         << " to " << global::komi;
                     }
                 }
                 else if (montec::root.t.value_sum >
@@ -448,43 +798,48 @@ int MonteCarlo::runSimulations(int max_iter_count, unsigned thread_no,
                     int perspective = 2 * montec::root.move.who -
                                       3;  // -1 if we are white, 1 if black
                                           // (root.move.who is the opponent)
-                    std::cerr << "Red zone; komi = " << global::komi
-                              << ", perspective = " << perspective
-                              << ", ratchet = " << global::komi_ratchet
-                              << std::endl;
+                    KROPLA_LOG(info) << "Red zone; komi = " << global::komi
+                                     << ", perspective = " << perspective
+                                     << ", ratchet = " << global::komi_ratchet;
                     if (global::komi * perspective > 0)
                     {
                         global::komi_ratchet = global::komi * perspective;
                     }
-                    std::cerr << "New ratchet: " << global::komi_ratchet
-                              << ". Changing komi from " << global::komi
-                              << " to ";
+                    const int old_komi = global::komi;
                     global::komi -= (montec::root.move.who == 1)
                                         ? -montec::komi_step
                                         : montec::komi_step;
                     was_komi_change = true;
-                    std::cerr << global::komi << std::endl;
+                    KROPLA_LOG(info) << "New ratchet: " << global::komi_ratchet
+                                     << ". Changing komi from " << old_komi
+                                     << " to " << global::komi;
                 }
             }
         }
         unsigned seed = montec::time_seed + thread_no + threads_count * i;
-        descend(alloc, &montec::root, seed);
+        descend(alloc, &montec::root, seed, in_lockstep ? k : -1);
         i++;
         montec::iterations++;
-        if (montec::iterations >= max_iter_count || montec::finish_sim)
+        if (not deterministic and
+            (montec::iterations >= max_iter_count || montec::finish_sim))
         {
             break;
         }
     }
 
+    prof::flushThread();
+    // the playouts of the other threads must not see the change of komi
+    if (thread_no == 0 and in_lockstep) lockstep.waitForAll();
     if (thread_no == 0 and not was_komi_change and global::komi != 0)
     {
-        std::cerr << "komi was not changed, so changing komi from "
-                  << global::komi << " to ";
+        const int old_komi = global::komi;
         global::komi +=
             (global::komi > 0) ? -montec::komi_step : montec::komi_step;
-        std::cerr << global::komi << " and increasing ratchet by 1 to "
-                  << ++global::komi_ratchet << std::endl;
+        ++global::komi_ratchet;
+        KROPLA_LOG(info) << "komi was not changed, so changing komi from "
+                         << old_komi << " to " << global::komi
+                         << " and increasing ratchet by 1 to "
+                         << global::komi_ratchet;
     }
 
     montec::threads_to_be_finished--;
@@ -526,9 +881,10 @@ void MonteCarlo::showBestContinuation(const Treenode *node,
 std::string MonteCarlo::findBestMoveUsingCNNonly(Game &pos, float exponent)
 {
     initialiseCnn();
-    const auto [is_cnn_available, probs] = getCnnInfo(pos);
+    const auto [is_cnn_available, cnn_info] = getCnnInfo(pos);
     if (not is_cnn_available)
         throw std::runtime_error("No CNN available and asking to use CNN");
+    const std::span<const float> probs{*cnn_info};
     std::vector<float> weights;
     std::vector<pti> moves;
     for (int y = 0; y < coord.wlky; ++y)
@@ -572,10 +928,18 @@ std::string MonteCarlo::findBestMoveMT(Game &pos, int threads, int iter_count,
                                        int msec)
 {
     debug_previous_count = -1;
-    montec::root = Treenode();
-    montec::root.move = pos.getLastMove();
-    montec::root.parent = &montec::root;
-    montec::root.game_ptr = std::make_shared<Game>(pos);
+    takeRoot();
+    if (not(keep_tree and reuseTree(pos)))
+    {
+        clearTree();
+        montec::root = Treenode();
+        montec::root.move = pos.getLastMove();
+        montec::root.parent = &montec::root;
+        montec::root.game_ptr = std::make_shared<Game>(pos);
+    }
+    while (allocators.size() < static_cast<std::size_t>(threads))
+        allocators.push_back(std::make_unique<TreenodeAllocator>());
+    has_tree = true;
     initialiseCnn();
     std::cerr << "Descend MT (threads=" << threads
               << ") starts, komi==" << global::komi << std::endl;
@@ -591,9 +955,20 @@ std::string MonteCarlo::findBestMoveMT(Game &pos, int threads, int iter_count,
     std::fill(montec::generateMovesCount_depths.begin(),
               montec::generateMovesCount_depths.end(), 0);
     montec::cnnReads = 0;
+    montec::playouts = 0;
+    prof::reset();
+    trace::clear();
     montec::threads_to_be_finished = threads;
-    montec::time_seed =
-        std::chrono::system_clock::now().time_since_epoch().count();
+    const bool deterministic = (determinism != Determinism::off);
+    if (fixed_seed)
+        montec::time_seed = *fixed_seed;
+    else
+        montec::time_seed =
+            deterministic
+                ? 0
+                : std::chrono::system_clock::now().time_since_epoch().count();
+    lockstep.reset(iter_count, threads);
+    const montec::SearchStart search_start;
     std::vector<std::future<int>> concurrent;
     concurrent.reserve(threads);
     for (int t = 0; t < threads; t++)
@@ -603,11 +978,34 @@ std::string MonteCarlo::findBestMoveMT(Game &pos, int threads, int iter_count,
                        { return runSimulations(iter_count, t, threads); }));
     }
     auto time_begin = std::chrono::high_resolution_clock::now();
-    if (msec > 0)
+    setCnnDeadline(deterministic ? 0 : msec);
+    const std::chrono::milliseconds analysis_interval{analysis::intervalMs()};
+    const auto step = analysis::isEnabled()
+                          ? std::min(std::chrono::milliseconds(50),
+                                     analysis_interval)
+                          : std::chrono::milliseconds(50);
+    auto next_analysis = search_start.time + analysis_interval;
+    const auto publishIfDue = [&]()
+    {
+        if (std::chrono::steady_clock::now() < next_analysis) return;
+        montec::publishAnalysis(pos, search_start, false);
+        next_analysis += analysis_interval;
+    };
+    if (deterministic)
+    {
+        // no early stop: all the threads make their iterations
+        while (montec::threads_to_be_finished > 0)
+        {
+            std::this_thread::sleep_for(step);
+            publishIfDue();
+        }
+    }
+    else if (msec > 0)
     {
         for (;;)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            std::this_thread::sleep_for(step);
+            publishIfDue();
             auto duration =
                 std::chrono::duration_cast<std::chrono::milliseconds>(
                     std::chrono::high_resolution_clock::now() - time_begin)
@@ -656,7 +1054,8 @@ std::string MonteCarlo::findBestMoveMT(Game &pos, int threads, int iter_count,
     {
         while (montec::threads_to_be_finished > 0)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            std::this_thread::sleep_for(step);
+            publishIfDue();
 #ifndef SPEED_TEST
             if (5 * montec::iterations > 3 * iter_count)
             {
@@ -692,6 +1091,7 @@ std::string MonteCarlo::findBestMoveMT(Game &pos, int threads, int iter_count,
         cv_finish_threads.wait(
             ul, [] { return montec::threads_to_be_finished == 0; });
     }
+    setCnnDeadline(0);
 
     std::cerr << "Descend ends" << std::endl;
     assert(pos.checkRootListOfMovesCorrectness(montec::root.children));
@@ -709,6 +1109,7 @@ std::string MonteCarlo::findBestMoveMT(Game &pos, int threads, int iter_count,
                              t2.t.playouts - t2.prior.playouts;
                   });
         montec::root.children[n - 1].markAsLast();
+        montec::fixParentsOfGrandchildren(&montec::root);
     }
     std::cerr << "Sort ends, root.children.size()==" << n << ", root value = "
               << montec::root.t.value_sum / montec::root.t.playouts
@@ -740,6 +1141,7 @@ std::string MonteCarlo::findBestMoveMT(Game &pos, int threads, int iter_count,
                           [](Treenode &t1, Treenode &t2)
                           { return t1.t.playouts > t2.t.playouts; });
                 montec::root.children[i].children[nn - 1].markAsLast();
+                montec::fixParentsOfGrandchildren(&montec::root.children[i]);
             }
             const int max_moves2 = std::min(std::min(max_moves, nn), 2);
             for (int j = 0; j < max_moves2; j++)
@@ -780,11 +1182,11 @@ std::string MonteCarlo::findBestMoveMT(Game &pos, int threads, int iter_count,
     std::string res = "";
     if (montec::root.children != nullptr)
     {
-        const int max_moves = n;
-        saveMCstats(n, max_moves, false);
-
         res = montec::root.children[0].getMoveSgf();
     }
+    logger::flush();
+    montec::publishAnalysis(pos, search_start, true);
+    montec::reportMove(pos, threads, montec::iterations, search_start);
 
     // let the threads go to the end
     {
@@ -798,6 +1200,7 @@ std::string MonteCarlo::findBestMoveMT(Game &pos, int threads, int iter_count,
         int num = concurrent[t].get();
         std::cerr << "Thread " << t << ": sims = " << num << std::endl;
     }
+    montec::writeTrace(pos);
 
     return res;
 }
@@ -856,6 +1259,16 @@ void play_engine(Game &game, std::string &s, int threads_count, int iter_count,
             {
                 return;
             }
+            if (buf.starts_with("RELOAD"))
+            {
+                reloadCnn();
+                continue;
+            }
+            if (buf.starts_with("STATS"))
+            {
+                printCnnPoolStats(std::cerr);
+                continue;
+            }
             n += buf;
         } while (n.find(")") == std::string::npos);
         getSgfAndMsec(n, msec);
@@ -901,15 +1314,6 @@ void findAndPrintBestMove(Game &game, int threads_count, int iter_count)
                      end_time - start_time)
                      .count()
               << " mikros" << std::endl;
-    std::cerr << "debug: " << debug_nanos / 1000 << " mikros" << std::endl;
-    std::cerr << "debug2: " << debug_nanos2 / 1000 << " mikros" << std::endl;
-    std::cerr << "debug3: " << debug_nanos3 / 1000 << " mikros" << std::endl;
-    std::cerr << "All threats2m: " << debug_allt2m
-              << ", skipped: " << debug_skippedt2m
-              << ", small singular: " << debug_sing_smallt2m
-              << ", large singular: " << debug_sing_larget2m
-              << ", found before: " << debug_foundt2m << ". n= " << debug_n
-              << ", N=" << debug_N << std::endl;
 }
 
 void playInteractively(Game &game, int threads_count, int iter_count)
@@ -25,8 +25,12 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 /********************************************************************************************************
   Montecarlo class for Monte Carlo search.
@@ -39,10 +43,39 @@ class MonteCarlo
 {
    public:
     MonteCarlo();
+    ~MonteCarlo();
     std::string findBestMove(Game &pos, int iter_count);
     std::string findBestMoveMT(Game &pos, int threads, int iter_count,
                                int msec);
     static std::string findBestMoveUsingCNNonly(Game &pos, float exponent);
+    // seeds of simulations in findBestMoveMT are taken from seed instead of
+    // the clock
+    void setSeed(uint64_t seed) { fixed_seed = seed; }
+    // Deterministic modes of findBestMoveMT, for reproducible measurements.
+    // node_count: the search makes exactly iter_count iterations (msec and
+    // the early stops are ignored), iteration k is made by thread
+    // k % threads with the seed seed + k (seed 0 without setSeed). The work
+    // is then the same in every run, but with more than one thread the tree
+    // still depends on the interleaving of the threads.
+    // lockstep: as node_count, and the iterations also select their leaves
+    // and back up their results in the order of k (the selection of k sees
+    // exactly the backups up to k - threads), so that the search does not
+    // depend on the timing of the threads; only the playouts run in
+    // parallel.
+    enum class Determinism
+    {
+        off,
+        node_count,
+        lockstep
+    };
+    void setDeterminism(Determinism mode) { determinism = mode; }
+    // Keeps the tree of findBestMoveMT, so that the next search in the same
+    // position or up to 2 moves later starts from the subtree of that
+    // position.
+    void setKeepTree(bool keep) { keep_tree = keep; }
+    void clearTree();
+    // nodes held by the kept tree
+    std::size_t keptNodes() const;
 
    private:
     int runSimulations(int max_iter_count, unsigned thread_no,
@@ -51,11 +84,25 @@ class MonteCarlo
     std::shared_ptr<Game> getCopyOfGame(Treenode *node) const;
     void expandNode(TreenodeAllocator &alloc, Treenode *node, Game *game,
                     int depth) const;
-    void descend(TreenodeAllocator &alloc, Treenode *node, unsigned seed);
+    // iteration: the number of the iteration of a lockstep search, else -1
+    void descend(TreenodeAllocator &alloc, Treenode *node, unsigned seed,
+                 int64_t iteration);
     void showBestContinuation(const Treenode *node, const std::string &prefix,
                               const std::string &added_to_prefix,
                               unsigned depth) const;
-    void saveMCstats(int n, int max_moves, bool saveCnnStat) const;
+
+    bool reuseTree(const Game &pos);
+    // montec::root is shared by all MonteCarlo objects; the one searching
+    // owns it, and the roots of the kept trees of the others are parked
+    void takeRoot();
+    void parkRoot();
+
+    std::optional<uint64_t> fixed_seed{};
+    Determinism determinism{Determinism::off};
+    bool keep_tree{false};
+    bool has_tree{false};  // the root of the tree is in allocators
+    std::vector<std::unique_ptr<TreenodeAllocator>> allocators;
+    std::unique_ptr<Treenode> parked_root;
 };
 
 namespace montec
@@ -66,6 +113,9 @@ extern bool finish_threads;
 extern std::atomic<int> threads_to_be_finished;
 extern std::atomic<int64_t> iterations;
 extern std::atomic<int64_t> generateMovesCount;
+extern std::atomic<int64_t> cnnReads;
+// playouts really played (not replaced by the CNN value)
+extern std::atomic<int64_t> playouts;
 }  // namespace montec
 
 void play_engine(Game &game, std::string &s, int threads_count, int iter_count,
@@ -0,0 +1,523 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file playout_board.cc -- a light board
+for random playouts, set up from a Game.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "playout_board.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+#include "game.h"
+
+namespace
+{
+std::atomic<bool> enabled{false};
+}  // namespace
+
+void PlayoutBoard::setEnabled(bool on) { enabled = on; }
+
+bool PlayoutBoard::isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+PlayoutBoard::PlayoutBoard(const Game &game)
+    : now_moves{game.whoNowMoves()}, history{game.getHistory()}
+{
+    const auto &sg = game.getSimpleGame();
+    score[0] = sg.score[0].dots;
+    score[1] = sg.score[1].dots;
+    margin.fill(3);
+    dots.fill({0, 0});
+    pool.fill(0);
+    in_threat[0].fill(0);
+    in_threat[1].fill(0);
+    move_pos.fill(-1);
+    mark.fill(0);
+    std::vector<bool> worm_seen(sg.MASK_WORM_NO + 1, false);
+    for (pti i = 0; i < coord.getSize(); ++i)
+    {
+        margin[i] = game.whoseDotMarginAt(i);
+        if ((margin[i] == 1 or margin[i] == 2) and not worm_seen[sg.worm[i]])
+        {
+            worm_seen[sg.worm[i]] = true;
+            const auto &descr = sg.descr.at(sg.worm[i]);
+            dots[i] = {descr.dots[0], descr.dots[1]};
+        }
+    }
+    // pools: the regions of non-who points not reaching the outside
+    for (int who = 1; who <= 2; ++who)
+    {
+        const auto batch = mark_no;
+        for (pti i = coord.first; i <= coord.last; ++i)
+        {
+            if (margin[i] == who or margin[i] == 3 or mark[i] > batch)
+                continue;
+            region.clear();
+            if (findRegion(i, who, batch, 0, 0))
+            {
+                for (auto p : region) pool[p] |= who;
+            }
+        }
+    }
+    for (pti i = coord.first; i <= coord.last; ++i)
+    {
+        if (isPlayable(i))
+        {
+            move_pos[i] = moves.size();
+            moves.push_back(i);
+        }
+    }
+    for (auto p : moves)
+    {
+        findThreat(p, 1);
+        findThreat(p, 2);
+    }
+}
+
+int PlayoutBoard::whosePoolAt(pti ind) const
+{
+    static constexpr int owner[4] = {0, 1, 2, 0};
+    return owner[pool[ind]];
+}
+
+bool PlayoutBoard::isPlayable(pti ind) const
+{
+    return margin[ind] == 0 and pool[ind] == 0;
+}
+
+void PlayoutBoard::removeMove(pti ind)
+{
+    const auto pos = move_pos[ind];
+    if (pos < 0) return;
+    moves[pos] = moves.back();
+    move_pos[moves[pos]] = pos;
+    moves.pop_back();
+    move_pos[ind] = -1;
+}
+
+/// A dot of who at ind may close a region only if it joins two separate
+/// parts of who's margin around it.
+bool PlayoutBoard::mayClose(pti ind, int who) const
+{
+    int parts = 0;
+    bool prev = margin[ind + coord.nb8[7]] == who;
+    for (int i = 0; i < 8; ++i)
+    {
+        const bool curr = margin[ind + coord.nb8[i]] == who;
+        if (curr and not prev) ++parts;
+        prev = curr;
+    }
+    return parts >= 2;
+}
+
+/// Appends to region the points of the 4-connected region of non-who points
+/// containing start, with extra_border (if non-zero) counted as a who point.
+/// Returns false, and leaves region as it was, if the region reaches the
+/// outside, a point visited by another search since batch (which then
+/// reached the outside), or has more than size_limit (if non-zero) points.
+bool PlayoutBoard::findRegion(pti start, int who, uint32_t batch,
+                              pti extra_border, int size_limit)
+{
+    const auto begin = region.size();
+    const auto current = ++mark_no;
+    stack.clear();
+    stack.push_back(start);
+    mark[start] = current;
+    while (not stack.empty())
+    {
+        const pti p = stack.back();
+        stack.pop_back();
+        region.push_back(p);
+        if (size_limit and int(region.size() - begin) > size_limit)
+        {
+            region.resize(begin);
+            return false;
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            const pti q = p + coord.nb4[i];
+            if (q == extra_border or margin[q] == who or mark[q] == current)
+                continue;
+            if (margin[q] == 3 or mark[q] > batch)
+            {
+                region.resize(begin);
+                return false;
+            }
+            mark[q] = current;
+            stack.push_back(q);
+        }
+    }
+    return true;
+}
+
+/// Encloses the region [begin, end) of region by who, together with the
+/// points it surrounds, as Game::makeEnclosure() does.
+void PlayoutBoard::encloseRegion(std::size_t begin, std::size_t end, int who)
+{
+    const int opp = 3 - who;
+    int x0 = coord.wlkx, x1 = 0, y0 = coord.wlky, y1 = 0;
+    const auto in_region = ++mark_no;
+    for (auto i = begin; i < end; ++i)
+    {
+        const pti p = region[i];
+        mark[p] = in_region;
+        x0 = std::min<int>(x0, coord.x[p]);
+        x1 = std::max<int>(x1, coord.x[p]);
+        y0 = std::min<int>(y0, coord.y[p]);
+        y1 = std::max<int>(y1, coord.y[p]);
+    }
+    // the region does not touch the edge, so its bounding box with a margin of
+    // 1 lies on the board; the points of the box not reachable from the
+    // margin of the box are surrounded by the region
+    --x0, ++x1, --y0, ++y1;
+    auto in_box = [&](pti p)
+    {
+        return coord.x[p] >= x0 and coord.x[p] <= x1 and coord.y[p] >= y0 and
+               coord.y[p] <= y1;
+    };
+    const auto outer = ++mark_no;
+    stack.clear();
+    for (int x = x0; x <= x1; ++x)
+    {
+        for (int y = y0; y <= y1; y += (x == x0 or x == x1) ? 1 : y1 - y0)
+        {
+            const pti p = coord.ind(x, y);
+            mark[p] = outer;
+            stack.push_back(p);
+        }
+    }
+    while (not stack.empty())
+    {
+        const pti p = stack.back();
+        stack.pop_back();
+        for (int i = 0; i < 4; ++i)
+        {
+            const pti q = p + coord.nb4[i];
+            if (mark[q] != in_region and mark[q] != outer and in_box(q))
+            {
+                mark[q] = outer;
+                stack.push_back(q);
+            }
+        }
+    }
+    for (int x = x0 + 1; x < x1; ++x)
+    {
+        for (int y = y0 + 1; y < y1; ++y)
+        {
+            const pti p = coord.ind(x, y);
+            if (mark[p] == outer) continue;
+            if (margin[p] == opp)
+            {
+                score[who - 1] += dots[p][opp - 1];
+                score[opp - 1] -= dots[p][who - 1];
+            }
+            margin[p] = who;
+            pool[p] = 0;
+            removeMove(p);
+        }
+    }
+    last_enclosures.push_back(region[begin]);
+}
+
+/// Adds the threat of who to enclose some opponent dots by a dot at where,
+/// if there is one with not too large interior.
+void PlayoutBoard::findThreat(pti where, int who)
+{
+    if (not mayClose(where, who)) return;
+    const int opp = 3 - who;
+    Threat thr{where, 0, {}};
+    const auto batch = mark_no;
+    for (int i = 0; i < 4; ++i)
+    {
+        const pti nb = where + coord.nb4[i];
+        if (margin[nb] == who or margin[nb] == 3 or mark[nb] > batch or
+            (pool[nb] & who))
+            continue;
+        region.clear();
+        if (not findRegion(nb, who, batch, where, threat_size_limit)) continue;
+        int16_t opp_dots = 0;
+        for (auto p : region)
+        {
+            if (margin[p] == opp) opp_dots += dots[p][opp - 1];
+        }
+        if (opp_dots)
+        {
+            thr.opp_dots += opp_dots;
+            thr.interior.insert(thr.interior.end(), region.begin(),
+                                region.end());
+        }
+    }
+    if (thr.opp_dots == 0) return;
+    for (auto p : thr.interior) ++in_threat[who - 1][p];
+    threats[who - 1].push_back(std::move(thr));
+}
+
+/// Finds the threats again at their old places and around the last move ind.
+void PlayoutBoard::updateThreats(pti ind)
+{
+    candidates.clear();
+    const auto seen = ++mark_no;
+    for (int pl = 0; pl < 2; ++pl)
+    {
+        for (const auto &thr : threats[pl])
+        {
+            for (auto p : thr.interior) --in_threat[pl][p];
+            if (mark[thr.where] != seen)
+            {
+                mark[thr.where] = seen;
+                candidates.push_back(thr.where);
+            }
+        }
+        threats[pl].clear();
+    }
+    for (int x = coord.x[ind] - 2; x <= coord.x[ind] + 2; ++x)
+    {
+        for (int y = coord.y[ind] - 2; y <= coord.y[ind] + 2; ++y)
+        {
+            if (x < 0 or x >= coord.wlkx or y < 0 or y >= coord.wlky) continue;
+            const pti p = coord.ind(x, y);
+            if (mark[p] != seen) candidates.push_back(p);
+        }
+    }
+    for (auto p : candidates)
+    {
+        if (not isPlayable(p)) continue;
+        findThreat(p, 1);
+        findThreat(p, 2);
+    }
+}
+
+void PlayoutBoard::play(pti ind)
+{
+    assert(isPlayable(ind));
+    const int who = now_moves;
+    removeMove(ind);
+    margin[ind] = who;
+    dots[ind][who - 1] = 1;
+    last_enclosures.clear();
+    bool closed = false;
+    if (mayClose(ind, who))
+    {
+        // first find all the closed regions, then enclose them or make pools
+        std::array<std::size_t, 5> starts{};
+        int count = 0;
+        region.clear();
+        const auto batch = mark_no;
+        for (int i = 0; i < 4; ++i)
+        {
+            const pti nb = ind + coord.nb4[i];
+            if (margin[nb] == who or margin[nb] == 3 or mark[nb] > batch or
+                (pool[nb] & who))
+                continue;
+            starts[count] = region.size();
+            if (findRegion(nb, who, batch, 0, 0)) ++count;
+        }
+        starts[count] = region.size();
+        for (int r = 0; r < count; ++r)
+        {
+            closed = true;
+            const bool with_opp_dots = std::any_of(
+                region.begin() + starts[r], region.begin() + starts[r + 1],
+                [this, who](pti p) { return margin[p] == 3 - who; });
+            if (with_opp_dots)
+            {
+                encloseRegion(starts[r], starts[r + 1], who);
+                continue;
+            }
+            for (auto i = starts[r]; i < starts[r + 1]; ++i)
+            {
+                pool[region[i]] |= who;
+                removeMove(region[i]);
+            }
+        }
+    }
+    history.push_back(ind, false, closed, false, 0);
+    if (not last_enclosures.empty()) history.setEnclosureInLastMove();
+    updateThreats(ind);
+    now_moves ^= 3;
+}
+
+pattern3_val PlayoutBoard::getPattern3Value(pti ind, int who) const
+{
+    // the code as in Game::getPattern3_at()
+    static constexpr pattern3_t atari_masks[8] = {0, 0x10000, 0, 0x20000,
+                                                  0, 0x40000, 0, 0x80000};
+    pattern3_t p = 0, atari = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        const pti nb = ind + coord.nb8[i];
+        p <<= 2;
+        const int dot = margin[nb];
+        p |= dot;
+        if ((i & 1) and (dot == 1 or dot == 2) and
+            (in_threat[2 - dot][nb] or (pool[nb] & (3 - dot))))
+            atari |= atari_masks[i];
+    }
+    return global::patt3.getValue(p | atari, who);
+}
+
+pti PlayoutBoard::choosePattern3Move(pti move,
+                                     std::default_random_engine &engine)
+{
+    if (move == 0) return 0;
+    const int who = now_moves;
+    std::array<std::pair<pti, int>, 8> stack;
+    int count = 0, total = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        const pti nb = move + coord.nb8[i];
+        if (not isPlayable(nb) or in_threat[2 - who][nb]) continue;
+        const auto v = getPattern3Value(nb, who);
+        if (v > 0)
+        {
+            stack[count++] = {nb, v};
+            total += v;
+        }
+    }
+    if (total == 0) return 0;
+    std::uniform_int_distribution<int> di(0, total - 1);
+    int number = di(engine);
+    for (int i = 0; i < count; ++i)
+    {
+        number -= stack[i].second;
+        if (number < 0) return stack[i].first;
+    }
+    return stack[0].first;
+}
+
+/// Chooses a threat of owner, with probability proportional to the number of
+/// dots it would enclose, and returns its point.
+pti PlayoutBoard::chooseThreatMove(int owner,
+                                   std::default_random_engine &engine)
+{
+    int total = 0;
+    for (const auto &thr : threats[owner - 1]) total += thr.opp_dots;
+    if (total == 0) return 0;
+    std::uniform_int_distribution<int> di(0, total - 1);
+    int number = di(engine);
+    for (const auto &thr : threats[owner - 1])
+    {
+        number -= thr.opp_dots;
+        if (number < 0) return thr.where;
+    }
+    return threats[owner - 1][0].where;
+}
+
+/// The policy of Game::randomPlayout() reduced to what the board keeps: last
+/// good reply, a defence against or a capture by a threat, pattern3 around the
+/// last two moves, or a random move.
+pti PlayoutBoard::chooseMove(std::default_random_engine &engine)
+{
+    if (moves.empty()) return 0;
+    const int who = now_moves;
+    std::uniform_int_distribution<uint32_t> di(0, 0xffffff);
+    const auto number = di(engine);
+    if ((number & 0x10000) != 0)  // probability 1/2
+    {
+        const pti m = history.getLastGoodReplyFor(who);
+        if (m != 0 and isPlayable(m)) return m;
+    }
+    if ((number & 0xc00) != 0)
+    {
+        if (const pti m = chooseThreatMove(3 - who, engine)) return m;
+    }
+    if ((number & 0x300) != 0)
+    {
+        if (const pti m = choosePattern3Move(history.getLast(), engine))
+            return m;
+    }
+    if ((number & 0x4) != 0)
+    {
+        if (const pti m = choosePattern3Move(history.getLastButOne(), engine))
+            return m;
+    }
+    if ((number & 0x2) != 0)
+    {
+        if (const pti m = chooseThreatMove(who, engine)) return m;
+    }
+    std::uniform_int_distribution<std::size_t> dm(0, moves.size() - 1);
+    return moves[dm(engine)];
+}
+
+real_t PlayoutBoard::randomPlayout(std::default_random_engine &engine)
+{
+    while (const pti m = chooseMove(engine)) play(m);
+    const auto [res, res_small] = countTerritory_simple(now_moves);
+    return Game::winValueOfScore(res, res_small);
+}
+
+std::pair<int, int> PlayoutBoard::countTerritory_simple(int who_moves) const
+{
+    int delta_score[4] = {0, 0, 0, 0};  // dots of 0,1, terr of 0,1
+    int dame = 0;
+    for (pti ind = coord.first; ind <= coord.last; ++ind)
+    {
+        switch (pool[ind])
+        {
+            case 1:
+                if (margin[ind] == 2)
+                {
+                    delta_score[0] += dots[ind][1];
+                    delta_score[1] -= dots[ind][0];
+                }
+                else if (margin[ind] == 0)
+                {
+                    delta_score[2]++;
+                }
+                break;
+            case 2:
+                if (margin[ind] == 1)
+                {
+                    delta_score[1] += dots[ind][0];
+                    delta_score[0] -= dots[ind][1];
+                }
+                else if (margin[ind] == 0)
+                {
+                    delta_score[3]++;
+                }
+                break;
+            case 0:
+                if (margin[ind] == 0) dame++;
+                break;
+        }
+    }
+    // as in Game, assuming last-dot-safe==false
+    delta_score[3] += global::komi;
+    int delta = (delta_score[0] - delta_score[1]);
+    int small_score = 0;
+    if ((delta_score[2] - delta_score[3]) % 2 == 0)
+    {
+        delta += (delta_score[2] - delta_score[3]) / 2;
+    }
+    else
+    {
+        const int correction = ((dame + who_moves) % 2)
+                                   ? (delta_score[2] - delta_score[3] - 1) / 2
+                                   : (delta_score[2] - delta_score[3] + 1) / 2;
+        delta += correction;
+        small_score = delta_score[2] - delta_score[3] - 2 * correction;
+    }
+    return {(score[0] - score[1]) + delta, small_score};
+}
@@ -0,0 +1,124 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file playout_board.h -- a light board
+for random playouts, set up from a Game.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "history.h"
+#include "patterns.h"
+
+class Game;
+
+// A board for random playouts, set up from a Game at the leaf. It keeps only
+// what the playout policy reads: margins and dots, the scores, pools (closed
+// regions of a player that are not enclosed yet, i.e., the territory of
+// countTerritory_simple), 1-move threats to capture found around the recent
+// moves, the history for the last good replies, and the list of points still
+// possible to play. Pattern3 codes are computed from the margins when needed.
+// There are no worm descriptions, no threats in 2 moves, no safety and no
+// Move objects; a move is a point, and every region it closes is enclosed if
+// it contains opponent dots, otherwise it becomes a pool.
+// Nobody plays inside a pool, so the playout ends when the board is full.
+class PlayoutBoard
+{
+   public:
+    explicit PlayoutBoard(const Game &game);
+
+    // with playoutboard.config present, Game::rollout plays on a PlayoutBoard
+    static void setEnabled(bool on);
+    static bool isEnabled();
+
+    int whoNowMoves() const { return now_moves; }
+    // as Game::whoseDotMarginAt()
+    int whoseDotMarginAt(pti ind) const { return margin[ind]; }
+    // 1 or 2 if ind lies in a pool of that player, 0 otherwise
+    int whosePoolAt(pti ind) const;
+    bool isPlayable(pti ind) const;
+    const History &getHistory() const { return history; }
+    void updateGoodReplies(int lastWho, float abs_value)
+    {
+        history.updateGoodReplies(lastWho, abs_value);
+    }
+
+    // 0 if there is no move left
+    pti chooseMove(std::default_random_engine &engine);
+    // places a dot of whoNowMoves() at a playable point ind
+    void play(pti ind);
+    // for each enclosure made by the last move, one point of its interior
+    // (as after '!' in the sgf notation of Game::makeSgfMove)
+    const std::vector<pti> &getLastEnclosures() const
+    {
+        return last_enclosures;
+    }
+    // plays to the end, returns the value for player 1 as
+    // Game::randomPlayout() does
+    real_t randomPlayout(std::default_random_engine &engine);
+    // as Game::countTerritory_simple(); points in pools of both players
+    // (possible only in the position taken from the Game, for which Game
+    // uses countTerritory()) are not counted
+    std::pair<int, int> countTerritory_simple(int who_moves) const;
+
+   private:
+    struct Threat
+    {
+        pti where;
+        int16_t opp_dots;
+        std::vector<pti> interior;
+    };
+    // threats with a larger interior are not looked for
+    static constexpr int threat_size_limit = 100;
+
+    std::array<uint8_t, Coord::maxSize> margin;
+    // dots of players 1, 2 counted at the point: a dot counts at its point,
+    // the dots of a worm taken from the Game count at one point of the worm
+    std::array<std::array<int16_t, 2>, Coord::maxSize> dots;
+    std::array<uint8_t, Coord::maxSize> pool;  // bit who (1 or 2): pool of who
+    std::array<uint16_t, Coord::maxSize> in_threat[2];  // counts interiors
+    std::array<int16_t, Coord::maxSize> move_pos;  // in moves, -1 if absent
+    std::array<uint32_t, Coord::maxSize> mark;
+    uint32_t mark_no{0};
+    std::vector<pti> moves;
+    std::vector<Threat> threats[2];
+    std::vector<pti> region, stack, candidates, last_enclosures;
+    int score[2];
+    int now_moves;
+    History history;
+
+    void removeMove(pti ind);
+    bool mayClose(pti ind, int who) const;
+    bool findRegion(pti start, int who, uint32_t batch, pti extra_border,
+                    int size_limit);
+    void encloseRegion(std::size_t begin, std::size_t end, int who);
+    void findThreat(pti where, int who);
+    void updateThreats(pti ind);
+    pattern3_val getPattern3Value(pti ind, int who) const;
+    pti choosePattern3Move(pti move, std::default_random_engine &engine);
+    pti chooseThreatMove(int owner, std::default_random_engine &engine);
+};
@@ -0,0 +1,179 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file profiler.cc -- per-phase timers and
+counters of the search hot path.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "profiler.h"
+
+#include <iomanip>
+#include <mutex>
+
+namespace prof
+{
+namespace
+{
+std::mutex merged_mutex;
+Totals merged;
+
+constexpr std::array<const char *, PHASES> phase_names{
+    "select",
+    "expand",
+    "cnn_wait",
+    "playout",
+    "ladder_check",
+    "last_good_reply",
+    "atari_response",
+    "soft_safety_response",
+    "pattern3",
+    "soft_safety_continuation",
+    "atari_move",
+    "interesting_move",
+    "safety_move",
+    "any_move",
+    "place_dot",
+    "threats_pre_dot",
+    "threats2m_pre_dot",
+    "threats_post_dot",
+    "threats2m_post_dot",
+    "scoring"};
+
+constexpr std::array<const char *, COUNTERS> counter_names{
+    "threats2m_checked",        "threats2m_skipped",
+    "threats2m_small_singular", "threats2m_large_singular",
+    "threats2m_found_before",   "threats2m_encl_searches",
+    "threats2m_encl_points"};
+
+}  // namespace
+
+const char *name(Phase phase)
+{
+    return phase_names[static_cast<int>(phase)];
+}
+
+const char *name(Counter counter)
+{
+    return counter_names[static_cast<int>(counter)];
+}
+
+void Totals::add(const Totals &other)
+{
+    for (int i = 0; i < PHASES; ++i)
+    {
+        nanos[i] += other.nanos[i];
+        calls[i] += other.calls[i];
+    }
+    for (int i = 0; i < COUNTERS; ++i) counters[i] += other.counters[i];
+}
+
+bool Totals::empty() const
+{
+    for (int i = 0; i < PHASES; ++i)
+        if (calls[i]) return false;
+    for (int i = 0; i < COUNTERS; ++i)
+        if (counters[i]) return false;
+    return true;
+}
+
+#ifdef KROPLA_PROFILE
+thread_local ThreadTotals local;
+
+ThreadTotals::~ThreadTotals() { flushThread(); }
+
+void flushThread()
+{
+    if (local.totals.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(merged_mutex);
+        merged.add(local.totals);
+    }
+    local.totals = Totals{};
+}
+
+void reset()
+{
+    local.totals = Totals{};
+    std::lock_guard<std::mutex> lock(merged_mutex);
+    merged = Totals{};
+}
+#else
+void flushThread() {}
+
+void reset() {}
+#endif
+
+Totals collect()
+{
+    std::lock_guard<std::mutex> lock(merged_mutex);
+    return merged;
+}
+
+void printTable(std::ostream &os, const Totals &totals, uint64_t busy_nanos)
+{
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << std::left << std::setw(26) << "phase" << std::right << std::setw(12)
+       << "calls" << std::setw(12) << "total ms" << std::setw(12)
+       << "ns/call" << std::setw(8) << "%" << '\n';
+    os << std::fixed;
+    for (int i = 0; i < PHASES; ++i)
+    {
+        if (totals.calls[i] == 0) continue;
+        os << std::left << std::setw(26) << phase_names[i] << std::right
+           << std::setw(12) << totals.calls[i] << std::setw(12)
+           << std::setprecision(1) << totals.nanos[i] * 1e-6 << std::setw(12)
+           << std::setprecision(0)
+           << static_cast<double>(totals.nanos[i]) / totals.calls[i]
+           << std::setw(8) << std::setprecision(1)
+           << (busy_nanos ? 100.0 * totals.nanos[i] / busy_nanos : 0.0)
+           << '\n';
+    }
+    for (int i = 0; i < COUNTERS; ++i)
+    {
+        os << std::left << std::setw(26) << counter_names[i] << std::right
+           << std::setw(12) << totals.counters[i] << '\n';
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void writeJson(std::ostream &os, const Totals &totals)
+{
+    os << "{\"phases\": {";
+    bool first = true;
+    for (int i = 0; i < PHASES; ++i)
+    {
+        if (totals.calls[i] == 0) continue;
+        os << (first ? "" : ", ") << '"' << phase_names[i]
+           << "\": {\"calls\": " << totals.calls[i]
+           << ", \"nanos\": " << totals.nanos[i] << '}';
+        first = false;
+    }
+    os << "}, \"counters\": {";
+    for (int i = 0; i < COUNTERS; ++i)
+    {
+        os << (i ? ", " : "") << '"' << counter_names[i]
+           << "\": " << totals.counters[i];
+    }
+    os << "}}";
+}
+
+}  // namespace prof
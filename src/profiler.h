@@ -0,0 +1,163 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file profiler.h -- per-phase timers and
+counters of the search hot path.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Profiler of the search: time and number of calls of its phases and counts
+// of some events, accumulated per thread and merged into global totals by
+// flushThread() (called by each search thread when it is done, and anyway at
+// thread exit). It is compiled in only with -DKROPLA_PROFILE (cmake
+// -DKROPLA_PROFILE=ON); otherwise the macros expand to nothing and the totals
+// stay empty.
+// Times are inclusive, so nested phases (e.g. place_dot inside playout) are
+// counted in both.
+namespace prof
+{
+enum class Phase
+{
+    select,
+    expand,
+    cnn_wait,
+    playout,
+    // move choice in the playouts, by the policy which was tried
+    ladder_check,
+    last_good_reply,
+    atari_response,
+    soft_safety_response,
+    pattern3,
+    soft_safety_continuation,
+    atari_move,
+    interesting_move,
+    safety_move,
+    any_move,
+    place_dot,
+    threats_pre_dot,
+    threats2m_pre_dot,
+    threats_post_dot,
+    threats2m_post_dot,
+    scoring,
+    COUNT
+};
+
+enum class Counter
+{
+    threats2m_checked,
+    threats2m_skipped,
+    threats2m_small_singular,
+    threats2m_large_singular,
+    threats2m_found_before,
+    threats2m_encl_searches,
+    threats2m_encl_points,
+    COUNT
+};
+
+constexpr int PHASES = static_cast<int>(Phase::COUNT);
+constexpr int COUNTERS = static_cast<int>(Counter::COUNT);
+
+const char *name(Phase phase);
+const char *name(Counter counter);
+
+struct Totals
+{
+    std::array<uint64_t, PHASES> nanos{};
+    std::array<uint64_t, PHASES> calls{};
+    std::array<uint64_t, COUNTERS> counters{};
+
+    void add(const Totals &other);
+    bool empty() const;
+};
+
+#ifdef KROPLA_PROFILE
+constexpr bool enabled = true;
+
+struct ThreadTotals
+{
+    Totals totals;
+    ~ThreadTotals();
+};
+extern thread_local ThreadTotals local;
+
+class ScopedTimer
+{
+   public:
+    explicit ScopedTimer(Phase phase)
+        : phase{phase}, start{std::chrono::steady_clock::now()}
+    {
+    }
+    ~ScopedTimer()
+    {
+        const auto i = static_cast<int>(phase);
+        local.totals.nanos[i] +=
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+        ++local.totals.calls[i];
+    }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+   private:
+    Phase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+inline void count(Counter counter, uint64_t n = 1)
+{
+    local.totals.counters[static_cast<int>(counter)] += n;
+}
+
+#define KROPLA_PROFILE_CONCAT2(a, b) a##b
+#define KROPLA_PROFILE_CONCAT(a, b) KROPLA_PROFILE_CONCAT2(a, b)
+#define KROPLA_PROFILE_SCOPE(phase)                                    \
+    const ::prof::ScopedTimer KROPLA_PROFILE_CONCAT(kropla_profile_, \
+                                                    __LINE__)(       \
+        ::prof::Phase::phase)
+#define KROPLA_PROFILE_COUNT(counter, n) \
+    ::prof::count(::prof::Counter::counter, n)
+#else
+constexpr bool enabled = false;
+
+#define KROPLA_PROFILE_SCOPE(phase)
+#define KROPLA_PROFILE_COUNT(counter, n)
+#endif
+
+// adds the data of the calling thread to the totals and clears it
+void flushThread();
+// clears the totals and the data of the calling thread
+void reset();
+// totals flushed since the last reset()
+Totals collect();
+
+// per phase: calls, total time, mean time per call and the share of
+// busy_nanos (the search time summed over threads); then the counters
+void printTable(std::ostream &os, const Totals &totals, uint64_t busy_nanos);
+// one line JSON object, without the trailing newline
+void writeJson(std::ostream &os, const Totals &totals);
+
+}  // namespace prof
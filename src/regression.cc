@@ -0,0 +1,228 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file regression.cc -- regression tests
+of the choice of moves, as listed in regression-list.txt.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "regression.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "game.h"
+#include "montecarlo.h"
+#include "report.h"
+#include "sgf.h"
+
+namespace regression
+{
+namespace
+{
+std::string trimmed(const std::string &s)
+{
+    const auto end = s.find_last_not_of(" \t\r\n");
+    return end == std::string::npos ? std::string{} : s.substr(0, end + 1);
+}
+
+// move of an sgf node like ";B[al]"
+std::string moveOfSgfNode(const std::string &node)
+{
+    const auto l = node.find('[');
+    const auto r = node.rfind(']');
+    if (l == std::string::npos or r == std::string::npos or r <= l + 1)
+        return {};
+    return node.substr(l + 1, r - l - 1);
+}
+
+double perSecond(double n, double s) { return s > 0 ? n / s : 0; }
+
+}  // namespace
+
+double Test::scoreOf(const std::string &move) const
+{
+    for (const auto &[listed, score] : moves)
+        if (listed == move) return score;
+    const auto dot = move.substr(0, move.find('.'));
+    for (const auto &[listed, score] : moves)
+        if (listed == dot) return score;
+    return default_score;
+}
+
+std::vector<Test> parseList(std::istream &is, std::ostream &warnings)
+{
+    std::vector<Test> tests;
+    Test test;
+    int line_number = 0;
+    for (std::string line; std::getline(is, line);)
+    {
+        ++line_number;
+        line = trimmed(line);
+        const auto value = [&](std::string_view prefix)
+        { return line.substr(prefix.size()); };
+        try
+        {
+            if (line.starts_with("name="))
+            {
+                test.name = value("name=");
+                test.default_score = 0.0;
+            }
+            else if (line.starts_with("sgf="))
+                test.sgf = value("sgf=");
+            else if (line.starts_with("time="))
+                test.msec = std::stoi(value("time="));
+            else if (line.starts_with("move="))
+            {
+                std::istringstream ss(value("move="));
+                std::string move;
+                double score;
+                if (not(ss >> move >> score))
+                    throw std::invalid_argument(line);
+                test.moves.emplace_back(move, score);
+            }
+            else if (line.starts_with("else="))
+                test.default_score = std::stod(value("else="));
+            else if (line.starts_with("end"))
+            {
+                if (test.name.empty() or test.sgf.empty() or
+                    test.moves.empty())
+                    warnings << "Ignoring a noncomplete test ending in line "
+                             << line_number << ": name = " << test.name
+                             << ", moves = " << test.moves.size()
+                             << (test.sgf.empty() ? ", no sgf" : "")
+                             << std::endl;
+                else
+                    tests.push_back(test);
+                test = Test{};
+            }
+        }
+        catch (const std::logic_error &)
+        {
+            warnings << "Ignoring invalid line " << line_number << ": "
+                     << line << std::endl;
+        }
+    }
+    return tests;
+}
+
+Run runOnce(const Test &test, const Limits &limits, uint64_t seed)
+{
+    constexpr float exponent = 2.0f;
+    SgfParser parser(test.sgf);
+    const auto seq = parser.parseMainVar();
+    Game game(seq, std::numeric_limits<int>::max());
+    MonteCarlo mc;
+    mc.setSeed(seed);
+    const int msec = std::max(
+        1, static_cast<int>(std::lround(test.msec * limits.time_scale)));
+    const auto start = std::chrono::steady_clock::now();
+    const auto best =
+        limits.iter_count < 0
+            ? MonteCarlo::findBestMoveUsingCNNonly(game, exponent)
+            : mc.findBestMoveMT(game, std::max(limits.threads, 1),
+                                limits.iter_count, msec);
+    Run run{};
+    run.search_s = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    run.seed = seed;
+    run.move = moveOfSgfNode(best);
+    run.score = test.scoreOf(run.move);
+    if (limits.iter_count >= 0)
+    {
+        run.iterations = montec::iterations;
+        run.playouts = montec::playouts;
+        run.cnn_reads = montec::cnnReads;
+    }
+    return run;
+}
+
+double Result::total() const
+{
+    double sum = 0;
+    for (const auto &run : runs) sum += run.score;
+    return sum;
+}
+
+double Result::mean() const
+{
+    return runs.empty() ? 0.0 : total() / runs.size();
+}
+
+std::string toJson(const Result &result)
+{
+    std::vector<std::string> chosen;  // in the order of the first choice
+    std::string runs = "[";
+    int64_t iterations = 0, playouts = 0, cnn_reads = 0;
+    double search_s = 0;
+    for (const auto &run : result.runs)
+    {
+        if (std::find(chosen.begin(), chosen.end(), run.move) == chosen.end())
+            chosen.push_back(run.move);
+        iterations += run.iterations;
+        playouts += run.playouts;
+        cnn_reads += run.cnn_reads;
+        search_s += run.search_s;
+        if (runs.size() > 1) runs += ", ";
+        runs += report::JsonObject()
+                    .add("seed", run.seed)
+                    .add("move", run.move)
+                    .add("score", run.score)
+                    .add("iterations", run.iterations)
+                    .add("playouts", run.playouts)
+                    .add("cnn_reads", run.cnn_reads)
+                    .add("search_s", run.search_s)
+                    .str();
+    }
+    const auto times = [&](const std::string &move)
+    {
+        return std::count_if(result.runs.begin(), result.runs.end(),
+                             [&](const Run &run) { return run.move == move; });
+    };
+    report::JsonObject moves;
+    for (const auto &move : chosen)
+        moves.addRaw(move, report::JsonObject()
+                               .add("score", result.test.scoreOf(move))
+                               .add("times", times(move))
+                               .str());
+    const double repeats = std::max<std::size_t>(result.runs.size(), 1);
+    return report::JsonObject()
+        .add("name", result.test.name)
+        .add("msec", result.test.msec)
+        .add("repeats", result.runs.size())
+        .addRaw("moves", moves.str())
+        .add("total", result.total())
+        .add("mean", result.mean())
+        .add("iterations", iterations)
+        .add("iter_per_s", perSecond(iterations, search_s))
+        .add("playouts_per_s", perSecond(playouts, search_s))
+        .add("cnn_reads", cnn_reads / repeats)
+        .add("search_s", search_s)
+        .addRaw("runs", runs + "]")
+        .str();
+}
+
+}  // namespace regression
@@ -0,0 +1,96 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file regression.h -- regression tests
+of the choice of moves, as listed in regression-list.txt.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Regression tests of the move choice. The list (regression-list.txt) has
+// blocks of lines
+//   name=<name>
+//   sgf=<sgf, the position after its last move>
+//   time=<msec of the search, 10000 by default>
+//   move=<move> <score>  (repeated for each scored move)
+//   else=<score of the other moves, 0 by default>
+//   end
+// Other lines (e.g. comments starting with #) are ignored.
+namespace regression
+{
+constexpr int default_msec = 10000;
+
+struct Test
+{
+    std::string name;
+    std::string sgf;
+    int msec{default_msec};
+    std::vector<std::pair<std::string, double>> moves;
+    double default_score{0.0};
+
+    // a move with an enclosure scores as its dot, unless it is listed itself
+    double scoreOf(const std::string &move) const;
+};
+
+// Tests without a name, sgf or move are skipped with a warning.
+std::vector<Test> parseList(std::istream &is, std::ostream &warnings);
+
+struct Limits
+{
+    int threads{1};
+    int iter_count{5000000};  // negative: the move of the CNN only
+    double time_scale{1.0};   // multiplies msec of the tests
+};
+
+struct Run
+{
+    uint64_t seed;
+    std::string move;
+    double score;
+    int64_t iterations;
+    int64_t playouts;
+    int64_t cnn_reads;
+    double search_s;
+};
+
+// Searches the position of the test once. The search state is global in the
+// process, so runs cannot overlap in one process (kropla_regress --jobs runs
+// them in forked ones); each one uses all limits.threads threads.
+Run runOnce(const Test &test, const Limits &limits, uint64_t seed);
+
+struct Result
+{
+    Test test;
+    std::vector<Run> runs;
+
+    double total() const;
+    double mean() const;
+};
+
+// JSON object of the result: the runs, the chosen moves with their scores
+// and counts, the mean score, iterations/s and the time of the runs
+std::string toJson(const Result &result);
+}  // namespace regression
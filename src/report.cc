@@ -0,0 +1,241 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file report.cc -- per-move search report
+as lines of JSON, written in the background.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "report.h"
+
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace report
+{
+namespace
+{
+std::mutex mutex;
+std::condition_variable cv;
+std::condition_variable written_cv;
+std::deque<std::string> queue;
+bool busy{false};  // the writer holds lines taken from the queue
+bool stop{false};
+
+std::string file_path;
+uint64_t max_bytes{0};
+int keep_files{0};
+std::thread *writer{nullptr};  // never deleted, see Shutdown
+pid_t owner_pid{0};
+
+void rotate()
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    const auto numbered = [](int n)
+    { return file_path + "." + std::to_string(n); };
+    if (keep_files <= 0)
+    {
+        fs::remove(file_path, ec);
+        return;
+    }
+    fs::remove(numbered(keep_files), ec);
+    for (int n = keep_files - 1; n >= 1; --n)
+        fs::rename(numbered(n), numbered(n + 1), ec);
+    fs::rename(file_path, numbered(1), ec);
+}
+
+uint64_t currentSize()
+{
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(file_path, ec);
+    return ec ? 0 : size;
+}
+
+void runWriter()
+{
+    std::ofstream file(file_path, std::ofstream::app);
+    uint64_t size = currentSize();
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        cv.wait(lock, [] { return stop or not queue.empty(); });
+        if (queue.empty()) return;
+        std::deque<std::string> lines;
+        lines.swap(queue);
+        busy = true;
+        lock.unlock();
+        for (const auto &line : lines)
+        {
+            if (size > 0 and size + line.size() + 1 > max_bytes)
+            {
+                file.close();
+                rotate();
+                file.open(file_path, std::ofstream::app);
+                size = 0;
+            }
+            file << line << '\n';
+            size += line.size() + 1;
+        }
+        file.flush();
+        lock.lock();
+        busy = false;
+        written_cv.notify_all();
+    }
+}
+
+// Writes the remaining lines at exit. In a forked child (a CNN worker) the
+// writer thread does not exist, so there is nothing to do.
+struct Shutdown
+{
+    ~Shutdown()
+    {
+        if (writer == nullptr or getpid() != owner_pid) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_one();
+        writer->join();
+    }
+} shutdown_at_exit;
+
+}  // namespace
+
+void configure(const std::string &config_file, const std::string &path)
+{
+    double max_megabytes = 16;
+    int keep = 3;
+    std::ifstream config(config_file);
+    if (config >> max_megabytes) config >> keep;
+    if (max_megabytes <= 0)
+    {
+        std::cerr << "Report turned off in " << config_file << std::endl;
+        return;
+    }
+    open(path, static_cast<uint64_t>(max_megabytes * 1024 * 1024), keep);
+}
+
+void open(const std::string &path, uint64_t max, int keep)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (writer) return;
+    file_path = path;
+    max_bytes = max;
+    keep_files = keep;
+    owner_pid = getpid();
+    writer = new std::thread(runWriter);
+}
+
+bool isOpen()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return writer != nullptr and not stop;
+}
+
+void write(std::string line)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (writer == nullptr or stop) return;
+        queue.push_back(std::move(line));
+    }
+    cv.notify_one();
+}
+
+void flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    written_cv.wait(lock, [] { return queue.empty() and not busy; });
+}
+
+std::string quoted(std::string_view s)
+{
+    std::string res = "\"";
+    for (const char c : s)
+    {
+        switch (c)
+        {
+            case '"':
+                res += "\\\"";
+                break;
+            case '\\':
+                res += "\\\\";
+                break;
+            case '\n':
+                res += "\\n";
+                break;
+            case '\t':
+                res += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) >= 0x20)
+                    res += c;
+                else
+                {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    res += buf;
+                }
+        }
+    }
+    return res + "\"";
+}
+
+JsonObject &JsonObject::addRaw(std::string_view key, std::string_view json)
+{
+    if (body.size() > 1) body += ", ";
+    body += '"';
+    body += key;
+    body += "\": ";
+    body += json;
+    return *this;
+}
+
+JsonObject &JsonObject::add(std::string_view key, std::string_view value)
+{
+    return addRaw(key, report::quoted(value));
+}
+
+JsonObject &JsonObject::add(std::string_view key, bool value)
+{
+    return addRaw(key, value ? "true" : "false");
+}
+
+JsonObject &JsonObject::add(std::string_view key,
+                            const std::vector<std::string> &strings)
+{
+    std::string json = "[";
+    for (const auto &s : strings)
+    {
+        if (json.size() > 1) json += ", ";
+        json += report::quoted(s);
+    }
+    return addRaw(key, json + "]");
+}
+
+}  // namespace report
@@ -0,0 +1,81 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file report.h -- per-move search report
+as lines of JSON, written in the background.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Report of the program as NDJSON (one JSON object per line). write() only
+// queues the line; a background thread appends it to the file. When the file
+// would grow over max_bytes, it is renamed to file.1 (file.1 to file.2, and
+// so on, keeping keep_files old files) and a new one is started.
+// Nothing is written until open() is called.
+namespace report
+{
+// reads "max_megabytes keep_files" from the config file, if it exists
+// (defaults 16 and 3; 0 megabytes turns the report off) and opens the report
+void configure(const std::string &config_file, const std::string &path);
+void open(const std::string &path, uint64_t max_bytes, int keep_files);
+bool isOpen();
+void write(std::string line);
+// waits until the lines queued so far are written
+void flush();
+
+// JSON string literal of s
+std::string quoted(std::string_view s);
+
+// Builds one JSON object; keys are not escaped.
+class JsonObject
+{
+   public:
+    JsonObject &add(std::string_view key, std::string_view value);
+    JsonObject &add(std::string_view key, const char *value)
+    {
+        return add(key, std::string_view(value));
+    }
+    JsonObject &add(std::string_view key, bool value);
+    template <typename T>
+        requires std::integral<T> or std::floating_point<T>
+    JsonObject &add(std::string_view key, T value)
+    {
+        if constexpr (std::floating_point<T>)
+            if (not std::isfinite(value)) return addRaw(key, "null");
+        return addRaw(key, std::to_string(value));
+    }
+    JsonObject &add(std::string_view key,
+                    const std::vector<std::string> &strings);
+    // value is already JSON
+    JsonObject &addRaw(std::string_view key, std::string_view json);
+    std::string str() const { return body + "}"; }
+
+   private:
+    std::string body{"{"};
+};
+
+}  // namespace report
@@ -59,6 +59,11 @@ class Safety
     bool isDameFor(int who, pti where) const;
     int getUpdateValueForAllMargins() const;
     int getUpdateValueForMarginsContaining(pti p) const;
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(safety, move_value, justAddedMoveSugg, prevAddedMoveSugg);
+    }
 
    private:
     void findMoveValues(const SimpleGame* game);
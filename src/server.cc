@@ -0,0 +1,315 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file server.cc -- many games over a
+Unix domain socket in one process.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "server.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+// the board of a new connection, as in "kropla gtp"
+constexpr auto initial_sgf = "(;FF[4]GM[40]CA[UTF-8]AP[kropla]SZ[39:32])";
+// a longer line without the end closes the connection
+constexpr std::size_t max_line = 1 << 20;
+
+std::runtime_error systemError(const std::string &what)
+{
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+bool hasCommand(const std::string &input)
+{
+    return input.find('\n') != std::string::npos;
+}
+
+// the first line of input, without the end
+std::string nextLine(const std::string &input)
+{
+    return input.substr(0, input.find('\n'));
+}
+}  // namespace
+
+GameServer::GameServer(const std::string &socket_path, int threads,
+                       int iter_count, int msec, std::size_t kept_nodes_limit)
+    : socket_path{socket_path},
+      threads{threads},
+      iter_count{iter_count},
+      msec{msec},
+      komi{global::komi},
+      kept_nodes_limit{kept_nodes_limit}
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("socket path is too long: " + socket_path);
+    std::strcpy(addr.sun_path, socket_path.c_str());
+    if (pipe(stop_pipe) != 0) throw systemError("pipe");
+    if (pipe(search_done_pipe) != 0)
+    {
+        const auto error = systemError("pipe");
+        ::close(stop_pipe[0]);
+        ::close(stop_pipe[1]);
+        throw error;
+    }
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) throw systemError("socket");
+    ::unlink(socket_path.c_str());  // left by a previous server
+    if (bind(listen_fd, reinterpret_cast<const sockaddr *>(&addr),
+             sizeof(addr)) != 0 or
+        listen(listen_fd, 16) != 0)
+    {
+        const auto error = systemError(socket_path);
+        ::close(listen_fd);
+        for (const int fd : {stop_pipe[0], stop_pipe[1], search_done_pipe[0],
+                             search_done_pipe[1]})
+            ::close(fd);
+        throw error;
+    }
+}
+
+GameServer::~GameServer()
+{
+    if (search_thread.joinable()) search_thread.join();
+    for (const auto &session : sessions)
+        if (session->fd >= 0) ::close(session->fd);
+    ::close(listen_fd);
+    ::unlink(socket_path.c_str());
+    for (const int fd : {stop_pipe[0], stop_pipe[1], search_done_pipe[0],
+                         search_done_pipe[1]})
+        ::close(fd);
+}
+
+void GameServer::stop()
+{
+    const char byte = 0;
+    while (::write(stop_pipe[1], &byte, 1) < 0 and errno == EINTR)
+    {
+    }
+}
+
+void GameServer::run()
+{
+    std::vector<pollfd> fds;
+    for (;;)
+    {
+        fds.clear();
+        fds.push_back({stop_pipe[0], POLLIN, 0});
+        fds.push_back({search_done_pipe[0], POLLIN, 0});
+        fds.push_back({listen_fd, POLLIN, 0});
+        bool pending = false;
+        for (const auto &session : sessions)
+        {
+            fds.push_back({session->fd, POLLIN, 0});
+            pending = pending or canExecute(*session);
+        }
+        // commands already received are not delayed by waiting for more
+        if (poll(fds.data(), fds.size(), pending ? 0 : -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            throw systemError("poll");
+        }
+        if (fds[0].revents != 0)
+        {
+            if (searching != nullptr) finishSearch();
+            return;
+        }
+        if (fds[1].revents != 0) finishSearch();
+        for (std::size_t i = 0; i < sessions.size(); ++i)
+            if (fds[i + 3].revents != 0) receive(*sessions[i]);
+        if (fds[2].revents != 0) acceptConnection();
+        // one command of each game in turn, starting after the game of the
+        // last search, so that a game waits for at most one search of each
+        // other game
+        const std::size_t first = next_turn;
+        for (std::size_t k = 0; k < sessions.size(); ++k)
+        {
+            const std::size_t i = (first + k) % sessions.size();
+            if (not canExecute(*sessions[i])) continue;
+            if (GtpEngine::isSearch(nextLine(sessions[i]->input)))
+                next_turn = i + 1;
+            executeCommand(*sessions[i]);
+        }
+        for (const auto &session : sessions)
+        {
+            if (session->closed and session->fd >= 0)
+            {
+                ::close(session->fd);
+                session->fd = -1;  // ignored by poll
+            }
+        }
+        // the engines are destroyed only between the searches, which may
+        // park the tree of any of them
+        if (searching == nullptr)
+            std::erase_if(sessions,
+                          [](const auto &session) { return session->closed; });
+    }
+}
+
+void GameServer::acceptConnection()
+{
+    const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) return;
+    auto session = std::make_unique<Session>();
+    session->fd = fd;
+    if (sessions.size() >= max_games)
+    {
+        send(*session, "? too many games\n\n");
+        ::close(fd);
+        return;
+    }
+    sessions.push_back(std::move(session));
+    std::cerr << "New game, " << sessions.size() << " games" << std::endl;
+}
+
+void GameServer::receive(Session &session)
+{
+    char buf[4096];
+    const auto n = ::read(session.fd, buf, sizeof(buf));
+    if (n < 0 and errno == EINTR) return;
+    if (n <= 0 or session.input.size() + n > max_line)
+    {
+        session.closed = true;
+        return;
+    }
+    session.input.append(buf, n);
+}
+
+bool GameServer::canExecute(const Session &session) const
+{
+    if (session.closed or &session == searching or
+        not hasCommand(session.input))
+    {
+        return false;
+    }
+    // the board size of the search stays set until it is done
+    return searching == nullptr or
+           (session.engine != nullptr and session.engine->hasBoardSizeSet() and
+            GtpEngine::isLocal(nextLine(session.input)));
+}
+
+void GameServer::executeCommand(Session &session)
+{
+    const std::string line = nextLine(session.input);
+    session.input.erase(0, line.size() + 1);
+    // made here and not when the connection is accepted, because the
+    // constructor sets the board size, which must not change during a search
+    if (session.engine == nullptr)
+    {
+        session.engine = std::make_unique<GtpEngine>(initial_sgf, threads,
+                                                     iter_count, msec, komi);
+    }
+    if (GtpEngine::isSearch(line))
+    {
+        // before the thread starts, so that canExecute() sees the board size
+        // of the search
+        session.engine->restoreGlobalState();
+        searching = &session;
+        session.last_search = ++searches;
+        search_thread = std::thread(
+            [this, &session, line]
+            {
+                search_response = session.engine->execute(line);
+                const char byte = 0;
+                while (::write(search_done_pipe[1], &byte, 1) < 0 and
+                       errno == EINTR)
+                {
+                }
+            });
+        return;
+    }
+    send(session, session.engine->execute(line));
+    if (session.engine->hasQuit()) session.closed = true;
+}
+
+void GameServer::finishSearch()
+{
+    search_thread.join();
+    char byte;
+    while (::read(search_done_pipe[0], &byte, 1) < 0 and errno == EINTR)
+    {
+    }
+    Session &session = *searching;
+    searching = nullptr;
+    send(session, search_response);
+    dropOldTrees();
+}
+
+// The game of the last search keeps its tree, which is limited by the
+// search itself.
+void GameServer::dropOldTrees()
+{
+    for (;;)
+    {
+        std::size_t total = 0;
+        Session *oldest = nullptr;
+        for (const auto &session : sessions)
+        {
+            if (session->engine == nullptr) continue;
+            const std::size_t nodes = session->engine->keptNodes();
+            total += nodes;
+            if (nodes > 0 and session->last_search != searches and
+                (oldest == nullptr or
+                 session->last_search < oldest->last_search))
+            {
+                oldest = session.get();
+            }
+        }
+        if (total <= kept_nodes_limit or oldest == nullptr) return;
+        oldest->engine->dropTree();
+    }
+}
+
+void GameServer::send(Session &session, const std::string &response)
+{
+    std::size_t done = 0;
+    while (done < response.size())
+    {
+        const auto n = ::send(session.fd, response.data() + done,
+                              response.size() - done, MSG_NOSIGNAL);
+        if (n < 0 and errno == EINTR) continue;
+        if (n <= 0)
+        {
+            session.closed = true;
+            return;
+        }
+        done += n;
+    }
+}
+
+void serve(const std::string &socket_path, int threads, int iter_count,
+           int msec)
+{
+    GameServer server(socket_path, threads, iter_count, msec);
+    std::cerr << "Serving games on " << socket_path << std::endl;
+    server.run();
+}
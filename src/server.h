@@ -0,0 +1,109 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file server.h -- many games over a
+Unix domain socket in one process.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtp.h"
+
+// Server for "kropla serve": each connection to the Unix domain socket is a
+// game, driven by the commands of GtpEngine (see gtp.h), with its own game,
+// search tree, board size and komi. The pattern tables, the coordinate
+// tables and the CNN workers are loaded once and shared by all the games.
+// The searches (genmove, analyze) run one at a time in a thread of the
+// server, taking in turn the games with a search to do, and every search
+// gets all the threads: the search state (montec::root, coord, komi) is
+// global in the process, so the games share one thread budget instead of
+// competing for the cores. Meanwhile the local commands (see
+// GtpEngine::isLocal, e.g. play and showboard) of the games with the board
+// size of the search are executed as they come; the other commands wait for
+// the end of the search.
+// The search trees kept for the next move hold at most max_kept_nodes nodes
+// together; beyond that, the trees of the games which searched least
+// recently are dropped.
+class GameServer
+{
+   public:
+    static constexpr std::size_t max_games = 64;
+    static constexpr std::size_t max_kept_nodes = 4'000'000;
+
+    GameServer(const std::string &socket_path, int threads, int iter_count,
+               int msec, std::size_t kept_nodes_limit = max_kept_nodes);
+    ~GameServer();
+    GameServer(const GameServer &) = delete;
+    GameServer &operator=(const GameServer &) = delete;
+    // serves the connections until stop() is called
+    void run();
+    // may be called from another thread
+    void stop();
+
+   private:
+    struct Session
+    {
+        int fd;
+        std::string input;  // received, but not executed yet
+        std::unique_ptr<GtpEngine> engine;  // made by the first command
+        bool closed{false};
+        uint64_t last_search{0};  // number of its last search, 0 if none
+    };
+    void acceptConnection();
+    void receive(Session &session);
+    // whether the next command of session may be executed now
+    bool canExecute(const Session &session) const;
+    // executes the next command, in the search thread if it is a search
+    void executeCommand(Session &session);
+    void finishSearch();
+    void dropOldTrees();
+    static void send(Session &session, const std::string &response);
+
+    std::string socket_path;
+    int threads;
+    int iter_count;
+    int msec;
+    // of every new game: global::komi when the server is made, since the
+    // engines change it while they execute commands
+    int komi;
+    std::size_t kept_nodes_limit;
+    int listen_fd{-1};
+    int stop_pipe[2]{-1, -1};
+    // written by the search thread when it is done
+    int search_done_pipe[2]{-1, -1};
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::thread search_thread;
+    Session *searching{nullptr};  // the game of the search thread
+    std::string search_response;
+    uint64_t searches{0};
+    // the first session to get its turn in the next round
+    std::size_t next_turn{0};
+};
+
+// serves games on the socket until the process is killed
+void serve(const std::string &socket_path, int threads, int iter_count,
+           int msec);
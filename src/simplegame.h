@@ -64,6 +64,11 @@ struct WormDescr
     krb::SmallVector<pti, 6> neighb{
         arena_neighb};  // numbers of other worms that touch this one
     std::string show() const;
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(dots, leftmost, group_id, safety, neighb);
+    }
     WormDescr(const WormDescr& other)
         : leftmost{other.leftmost},
           group_id{other.group_id},
@@ -128,6 +133,11 @@ class Connections
     void reset(pti ind, int who);
 
     bool checkCorrectness(const SimpleGame& sg) const;
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(connections, offsets);
+    }
 };
 
 struct SimpleGame
@@ -204,6 +214,12 @@ struct SimpleGame
     void wormMergeOther(pti dst, pti src);
 
     bool checkConnectionsCorrectness() const;
+    template <class Archive>
+    void serialize(Archive& ar)
+    {
+        ar(worm, nextDot, descr, score, lastWormNo, nowMoves, rectangle,
+           history, safety_soft, connects);
+    }
 
    private:
     Connections connects;
@@ -0,0 +1,347 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file snapshot.cc -- versioned binary
+snapshot of a Game, for a fast restart or a hand-off of a game.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "snapshot.h"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "sgf.h"
+
+namespace snapshot
+{
+namespace
+{
+constexpr char magic[4] = {'K', 'R', 'S', 'N'};
+constexpr uint16_t byte_order_mark = 0x0102;
+
+// Archive writing the fields given to operator() to a string. Trivially
+// copyable values and vectors of them are copied as bytes; classes are
+// written by their serialize() member.
+class Writer
+{
+   public:
+    template <class... T>
+    void operator()(const T &...values)
+    {
+        (write(values), ...);
+    }
+    std::string data;
+
+   private:
+    void writeBytes(const void *p, std::size_t size)
+    {
+        data.append(static_cast<const char *>(p), size);
+    }
+    void writeSize(std::size_t size)
+    {
+        const auto s = static_cast<uint32_t>(size);
+        writeBytes(&s, sizeof(s));
+    }
+    template <class T>
+    void write(const T &value)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+            writeBytes(&value, sizeof(T));
+        else  // serialize() is not const, as it is also used to load
+            const_cast<T &>(value).serialize(*this);
+    }
+    template <class T, std::size_t N>
+    void write(const T (&values)[N])
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+            writeBytes(values, sizeof(values));
+        else
+            for (const auto &v : values) write(v);
+    }
+    template <class T, std::size_t N>
+    void write(const std::array<T, N> &values)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+            writeBytes(values.data(), sizeof(values));
+        else
+            for (const auto &v : values) write(v);
+    }
+    template <class T, class A>
+    void write(const std::vector<T, A> &values)
+    {
+        writeSize(values.size());
+        if constexpr (std::is_trivially_copyable_v<T>)
+            writeBytes(values.data(), values.size() * sizeof(T));
+        else
+            for (const auto &v : values) write(v);
+    }
+    template <class T>
+    void write(const std::list<T> &values)
+    {
+        writeSize(values.size());
+        for (const auto &v : values) write(v);
+    }
+    template <class K, class V>
+    void write(const std::unordered_map<K, V> &values)
+    {
+        writeSize(values.size());
+        for (const auto &[key, value] : values)
+        {
+            write(key);
+            write(value);
+        }
+    }
+    // Objects shared by several pointers (enclosures of threats) are written
+    // once: the first time with their number and contents, later only with
+    // the number. 0 is nullptr.
+    template <class T>
+    void write(const std::shared_ptr<T> &ptr)
+    {
+        if (ptr == nullptr)
+        {
+            writeSize(0);
+            return;
+        }
+        const auto [it, is_new] =
+            shared_ids.try_emplace(ptr.get(), shared_ids.size() + 1);
+        writeSize(it->second);
+        if (is_new) write(*ptr);
+    }
+    std::unordered_map<const void *, std::size_t> shared_ids;
+};
+
+// Archive reading the fields given to operator() in the order of Writer.
+class Reader
+{
+   public:
+    explicit Reader(std::string_view data) : data{data} {}
+    template <class... T>
+    void operator()(T &...values)
+    {
+        (read(values), ...);
+    }
+    bool atEnd() const { return pos == data.size(); }
+
+   private:
+    void readBytes(void *p, std::size_t size)
+    {
+        if (size > data.size() - pos)
+            throw std::runtime_error("snapshot is truncated");
+        std::memcpy(p, data.data() + pos, size);
+        pos += size;
+    }
+    std::size_t readSize()
+    {
+        uint32_t s;
+        readBytes(&s, sizeof(s));
+        return s;
+    }
+    // number of elements of at least min_bytes each, checked against the
+    // data left, so that a corrupted size does not allocate gigabytes
+    std::size_t readCount(std::size_t min_bytes)
+    {
+        const auto count = readSize();
+        if (count > (data.size() - pos) / min_bytes)
+            throw std::runtime_error("snapshot is truncated");
+        return count;
+    }
+    template <class T>
+    void read(T &value)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+            readBytes(&value, sizeof(T));
+        else
+            value.serialize(*this);
+    }
+    template <class T, std::size_t N>
+    void read(T (&values)[N])
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+            readBytes(values, sizeof(values));
+        else
+            for (auto &v : values) read(v);
+    }
+    template <class T, std::size_t N>
+    void read(std::array<T, N> &values)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+            readBytes(values.data(), sizeof(values));
+        else
+            for (auto &v : values) read(v);
+    }
+    template <class T, class A>
+    void read(std::vector<T, A> &values)
+    {
+        if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            values.resize(readCount(sizeof(T)));
+            readBytes(values.data(), values.size() * sizeof(T));
+        }
+        else
+        {
+            values.clear();
+            values.resize(readCount(1));
+            for (auto &v : values) read(v);
+        }
+    }
+    template <class T>
+    void read(std::list<T> &values)
+    {
+        values.clear();
+        for (auto count = readCount(1); count > 0; --count)
+            read(values.emplace_back());
+    }
+    template <class K, class V>
+    void read(std::unordered_map<K, V> &values)
+    {
+        values.clear();
+        const auto count = readCount(sizeof(K));
+        values.reserve(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            K key;
+            read(key);
+            const auto [it, is_new] = values.try_emplace(key);
+            if (not is_new) throw std::runtime_error("snapshot is corrupted");
+            read(it->second);
+        }
+    }
+    template <class T>
+    void read(std::shared_ptr<T> &ptr)
+    {
+        const auto id = readSize();
+        if (id == 0)
+            ptr = nullptr;
+        else if (id <= shared.size())
+            ptr = std::static_pointer_cast<T>(shared[id - 1]);
+        else if (id == shared.size() + 1)
+        {
+            ptr = std::make_shared<T>();
+            shared.push_back(ptr);
+            read(*ptr);
+        }
+        else
+            throw std::runtime_error("snapshot is corrupted");
+    }
+    std::string_view data;
+    std::size_t pos{0};
+    std::vector<std::shared_ptr<void>> shared;
+};
+
+struct Header
+{
+    char magic[4];
+    uint16_t byte_order;
+    uint16_t pti_size;
+    uint32_t version;
+    int32_t width, height;
+    int32_t komi, komi_ratchet;
+};
+
+}  // namespace
+
+std::string save(const Game &game)
+{
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.byte_order = byte_order_mark;
+    header.pti_size = sizeof(pti);
+    header.version = version;
+    header.width = coord.wlkx;
+    header.height = coord.wlky;
+    header.komi = global::komi;
+    header.komi_ratchet = global::komi_ratchet;
+    Writer writer;
+    writer(header, game);
+    return std::move(writer.data);
+}
+
+Game load(std::string_view data)
+{
+    Reader reader(data);
+    Header header;
+    reader(header);
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+        throw std::runtime_error("not a snapshot");
+    if (header.byte_order != byte_order_mark or header.pti_size != sizeof(pti))
+        throw std::runtime_error("snapshot of an incompatible build");
+    if (header.version != version)
+        throw std::runtime_error("snapshot version " +
+                                 std::to_string(header.version) +
+                                 " is not supported");
+    if (header.width < 5 or header.width > Coord::maxx or header.height < 5 or
+        header.height > Coord::maxy)
+        throw std::runtime_error("snapshot is corrupted");
+    // the empty game below changes the global size and komi, which must stay
+    // as they were if the rest of the snapshot turns out to be bad
+    const int old_width = coord.wlkx;
+    const int old_height = coord.wlky;
+    const int old_komi = global::komi;
+    const int old_komi_ratchet = global::komi_ratchet;
+    try
+    {
+        // an empty game of this size, its state is then replaced
+        SgfParser parser("(;SZ[" + std::to_string(header.width) + ":" +
+                         std::to_string(header.height) + "])");
+        Game game(parser.parseMainVar(), 0);
+        reader(game);
+        if (not reader.atEnd())
+            throw std::runtime_error("snapshot is corrupted");
+        global::komi = header.komi;
+        global::komi_ratchet = header.komi_ratchet;
+        return game;
+    }
+    catch (...)
+    {
+        if (coord.wlkx != old_width or coord.wlky != old_height)
+            coord.changeSize(old_width, old_height);
+        global::komi = old_komi;
+        global::komi_ratchet = old_komi_ratchet;
+        throw;
+    }
+}
+
+void saveToFile(const Game &game, const std::string &path)
+{
+    const auto data = save(game);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    if (not file.flush())
+        throw std::runtime_error("cannot write snapshot to " + path);
+}
+
+Game loadFromFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (not file) throw std::runtime_error("cannot read snapshot " + path);
+    const std::string data{std::istreambuf_iterator<char>(file),
+                           std::istreambuf_iterator<char>()};
+    return load(data);
+}
+
+}  // namespace snapshot
@@ -0,0 +1,50 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file snapshot.h -- versioned binary
+snapshot of a Game, for a fast restart or a hand-off of a game.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "game.h"
+
+// A snapshot stores the whole incremental state of a Game (worms, threats,
+// threats in 2 moves, safety, pattern3 values, possible moves, history), so
+// that loading it is a few bulk copies instead of replaying all the moves
+// through placeDot. The board size and komi are stored too.
+// The data is in the byte order and type sizes of the program that wrote it;
+// a snapshot of another version, byte order or pti size is rejected.
+namespace snapshot
+{
+constexpr uint32_t version = 1;
+
+std::string save(const Game &game);
+// sets the board size (coord) and komi from the snapshot; throws
+// std::runtime_error if data is not a valid snapshot
+Game load(std::string_view data);
+
+void saveToFile(const Game &game, const std::string &path);
+Game loadFromFile(const std::string &path);
+}  // namespace snapshot
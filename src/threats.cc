@@ -26,6 +26,8 @@
 #include <iostream>
 #include <limits>
 
+#include "profiler.h"
+
 bool Threat::isShortcut(pti x) const
 {
     for (int i = 0; i < 4; ++i)
@@ -252,8 +254,6 @@ void AllThreats::addThreat2moves_toMiai(Threat2m &t2, Threat &t)
     }
 }
 
-int debug_foundt2m = 0;
-
 /// @param[in] t  Threat after ind0-ind1 moves, with t.type, t.zobrist_key,
 /// t.encl and t.opp_dots set.
 /// @param[in] safe0  Is placing dot at ind0 safe for who.
@@ -323,7 +323,7 @@ int AllThreats::addThreat2moves(pti ind0, pti ind1, bool safe0, bool safe1,
 #endif
             if (pos2 != pos->thr_list.end())
             {
-                debug_foundt2m++;
+                KROPLA_PROFILE_COUNT(threats2m_found_before, 1);
                 if (pos2->type & ThreatConsts::TO_REMOVE)
                 {
                     pos2->type &= ~ThreatConsts::TO_REMOVE;
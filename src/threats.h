@@ -67,6 +67,13 @@ struct Threat
     bool isShortcut(pti x) const;
     void addShortcuts(pti ind0, pti ind1);
     std::string show() const;
+    template <class Archive>
+    void serialize(Archive &ar)
+    {
+        ar(where, type, terr_points, opp_dots, singular_dots,
+           border_dots_in_danger, hist_size, zobrist_key, encl, opp_thr,
+           shortcuts);
+    }
 };
 
 /********************************************************************************************************
@@ -104,6 +111,12 @@ struct Threat2m
     bool isSafe() const { return (flags & Threat2mconsts::FLAG_SAFE) != 0; };
     // void removeMarked();
     std::string show() const;
+    template <class Archive>
+    void serialize(Archive &ar)
+    {
+        ar(where0, min_win, min_win2, flags, win_move_count, is_in_encl2,
+           thr_list);
+    }
 };
 
 /********************************************************************************************************
@@ -141,6 +154,12 @@ struct AllThreats
     int numberOfDotsToBeEnclosedIn2mAfterPlayingAt(pti i) const;
     bool isInBorder2m(pti i) const;
     uint32_t getAtariNeighbCode(pti ind) const;
+    template <class Archive>
+    void serialize(Archive &ar)
+    {
+        ar(threats, threats2m, is_in_encl, is_in_terr, is_in_border,
+           is_in_2m_encl, is_in_2m_miai, active_thr2m);
+    }
 
    private:
     bool active_thr2m{true};
@@ -151,8 +170,6 @@ struct AllThreats
     void addThreat2moves_toMiai(Threat2m &t2, Threat &t);
 };
 
-extern int debug_foundt2m;
-
 /********************************************************************************************************
   ThrInfo class for finding necessary enclosures
 *********************************************************************************************************/
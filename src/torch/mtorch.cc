@@ -21,7 +21,10 @@
 
 #include "mtorch.h"
 
+#include "../batch_norm.h"
+
 #include <stdlib.h>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -30,9 +33,14 @@
 #include <cmath>
 #include <optional>
 #include <charconv>
+#include <chrono>
+#include <cstring>
+#include <sstream>
 
+// Value marks a net with a value head: channel 1 of the last convolution,
+// averaged over the board and squashed by tanh.
 enum class LayerType {
-  Conv, Batch, Relu
+  Conv, Batch, Relu, Value
 };
 
 struct LayerInfo
@@ -54,6 +62,9 @@ std::ostream& operator<<(std::ostream& os, const LayerInfo& l)
   case LayerType::Relu:
     os << "r";
     break;
+  case LayerType::Value:
+    os << "V";
+    break;
   }
   return os;
 }
@@ -66,10 +77,17 @@ std::ostream& operator<<(std::ostream& os, const std::vector<T>& v)
   return os;
 }
 
+std::vector<float> toVector(const torch::Tensor& t)
+{
+  const auto c = t.detach().to(torch::kFloat32).contiguous();
+  return std::vector<float>(c.data_ptr<float>(), c.data_ptr<float>() + c.numel());
+}
+
 std::optional<LayerInfo> string2layer_info(const std::string& s)
 {
   if (s == "B") return LayerInfo{LayerType::Batch};
   if (s == "r") return LayerInfo{LayerType::Relu};
+  if (s == "V") return LayerInfo{LayerType::Value};
   const char* prefix = "conv";
   if (not s.starts_with(prefix) or s.size() < 7) return {};
   const char* beg = s.data() + std::strlen(prefix);
@@ -103,6 +121,7 @@ struct Net : torch::nn::Module {
 	  batchn.push_back(register_module("batchn" + std::to_string(i), torch::nn::BatchNorm2d(torch::nn::BatchNorm2dOptions(inch).affine(true))));
 	  break;
 	case LayerType::Relu:
+	case LayerType::Value:
 	  break;
       }
     }
@@ -119,11 +138,72 @@ struct Net : torch::nn::Module {
 	  x = batchn[batch_i++](x);
 	  break;
 	case LayerType::Relu:
-	  x = torch::relu(x);
+	  // the input of relu is always a fresh temporary, so no allocation
+	  x = x.relu_();
+	  break;
+	case LayerType::Value:
+	  break;
       }
     }
     return x.flatten(-2);
   }
+
+  // Inference-time rewrite: every BatchNorm directly following a convolution
+  // is folded into that convolution's weights and bias (see batch_norm.h) and
+  // removed from netdef.  Must be called after loading weights.
+  void foldBatchNorm() {
+    std::vector<LayerInfo> new_netdef;
+    std::vector<torch::nn::BatchNorm2d> new_batchn;
+    std::size_t batch_i = 0;
+    std::size_t conv_i = 0;
+    for (std::size_t i = 0; i < netdef.size(); ++i) {
+      switch (netdef[i].layer_type) {
+	case LayerType::Conv:
+	  if (i + 1 < netdef.size() && netdef[i+1].layer_type == LayerType::Batch) {
+	    auto& c = conv[conv_i];
+	    auto& bn = batchn[batch_i++];
+	    auto weights = toVector(c->weight);
+	    auto bias = c->bias.defined() ? toVector(c->bias) : std::vector<float>(netdef[i].kernels, 0.0f);
+	    foldBatchNorm(weights, bias, {toVector(bn->weight), toVector(bn->bias),
+					  toVector(bn->running_mean), toVector(bn->running_var),
+					  static_cast<float>(bn->options.eps())});
+	    auto options = c->options;
+	    torch::nn::Conv2d fused(options.bias(true));
+	    fused->weight.set_data(torch::from_blob(weights.data(), c->weight.sizes()).clone());
+	    fused->bias.set_data(torch::tensor(bias));
+	    c = replace_module("conv" + std::to_string(i), fused);
+	    new_netdef.push_back(netdef[i]);
+	    ++i;  // skip the folded BatchNorm
+	  } else {
+	    new_netdef.push_back(netdef[i]);
+	  }
+	  ++conv_i;
+	  break;
+	case LayerType::Batch:
+	  // not after a convolution, cannot be folded
+	  new_batchn.push_back(batchn[batch_i++]);
+	  new_netdef.push_back(netdef[i]);
+	  break;
+	case LayerType::Relu:
+	case LayerType::Value:
+	  new_netdef.push_back(netdef[i]);
+	  break;
+      }
+    }
+    netdef = std::move(new_netdef);
+    batchn = std::move(new_batchn);
+  }
+
+  bool hasValueHead() const {
+    return std::any_of(netdef.begin(), netdef.end(),
+		       [](const LayerInfo& l) { return l.layer_type == LayerType::Value; });
+  }
+
+  void toChannelsLast() {
+    for (auto& c : conv)
+      c->weight.set_data(c->weight.contiguous(torch::MemoryFormat::ChannelsLast));
+  }
+
   //torch::nn::Linear linear;
   //torch::Tensor another_bias;
   std::vector<torch::nn::BatchNorm2d> batchn;
@@ -150,6 +230,26 @@ std::pair<int, std::vector<LayerInfo>> read_cnn_def(const std::string& filename)
 }
 
 
+std::optional<torch::ScalarType> string2precision(const std::string& s)
+{
+  if (s == "fp32") return torch::kFloat32;
+  if (s == "fp16") return torch::kFloat16;
+  if (s == "bf16") return torch::kBFloat16;
+  return {};
+}
+
+std::string precision2string(torch::ScalarType t)
+{
+  switch (t) {
+  case torch::kFloat16:
+    return "fp16";
+  case torch::kBFloat16:
+    return "bf16";
+  default:
+    return "fp32";
+  }
+}
+
 MTorch::MTorch()
 {
   setenv("OMP_NUM_THREADS", "1", true);
@@ -159,14 +259,98 @@ MTorch::MTorch()
 bool MTorch::is_ready() const
 { return (net != nullptr); }
 
+bool MTorch::has_value() const
+{ return net != nullptr and net->hasValueHead(); }
+
+void MTorch::set_options(const std::string& options_str)
+{
+  std::istringstream is(options_str);
+  for (std::string s; is >> s; ) {
+    if (s == "fold") options.fold_batchnorm = true;
+    else if (s == "nofold") options.fold_batchnorm = false;
+    else if (s == "channels_last") options.channels_last = true;
+    else if (s == "verify") options.verify = true;
+    else if (s.starts_with("precision=")) {
+      if (auto p = string2precision(s.substr(std::strlen("precision="))))
+	options.precision = *p;
+      else
+	std::cerr << "Unknown precision in: " << s << ", using fp32.\n";
+    }
+    else if (s.starts_with("quantize="))
+      // dynamic quantization in torch covers only Linear and recurrent layers,
+      // our nets are convolutions only; better no net than a silently fp32 one
+      throw CnnException("quantization is not available for convolutional nets: " + s);
+    else
+      std::cerr << "Unknown cnn option ignored: " << s << ".\n";
+  }
+}
+
+torch::Tensor MTorch::forward(Net& n, float* data, int size, int planes,
+			      int psize) const
+{
+  auto options_f = torch::TensorOptions().dtype(torch::kFloat32);
+  torch::Tensor input = torch::from_blob(data, {1, planes, size, psize}, options_f);
+  if (&n == net.get()) {
+    if (options.precision != torch::kFloat32)
+      input = input.to(options.precision);
+    if (options.channels_last)
+      input = input.contiguous(torch::MemoryFormat::ChannelsLast);
+  }
+  return n.forward(input)[0].to(torch::kFloat32);
+}
+
+void MTorch::verify(Net& reference, int size, int in_channels)
+{
+  constexpr int repeats = 50;
+  torch::manual_seed(0);
+  auto input = (torch::rand({in_channels, size, size}) > 0.7).to(torch::kFloat32).contiguous();
+  auto measure = [&](Net& n, torch::Tensor& out) {
+    out = forward(n, input.data_ptr<float>(), size, in_channels, size);
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; ++i)
+      forward(n, input.data_ptr<float>(), size, in_channels, size);
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+	     std::chrono::steady_clock::now() - start).count() / repeats;
+  };
+  torch::Tensor out_ref, out_opt;
+  const auto micros_ref = measure(reference, out_ref);
+  const auto micros_opt = measure(*net, out_opt);
+  const float max_diff = (torch::softmax(out_ref[0], 0) - torch::softmax(out_opt[0], 0)).abs().max().item<float>();
+  std::cerr << "Optimised net (fold_bn=" << options.fold_batchnorm
+	    << ", channels_last=" << options.channels_last
+	    << ", precision=" << precision2string(options.precision)
+	    << "): max abs diff of probabilities = " << max_diff
+	    << ", latency per position [micros]: " << micros_ref << " -> " << micros_opt << '\n';
+  const float tolerance = (options.precision == torch::kFloat32) ? 1e-4f : 1e-2f;
+  if (not (max_diff <= tolerance)) {
+    std::cerr << "Optimised net does not match the original one, using the original.\n";
+    net = std::make_shared<Net>(reference);
+    options = MTorchOptions{false, false, torch::kFloat32, false};
+  }
+}
+
 void MTorch::load(const std::string& model_file, const std::string& weights_file,
-		  int /*default_size*/)
+		  int default_size)
 {
   auto [in_channels, netdef] = read_cnn_def(model_file);
   std::cerr << "netdef: " << netdef << '\n';
   net = std::make_shared<Net>(in_channels, netdef);
   torch::load(net, weights_file);
   net->eval();
+  if (not options.fold_batchnorm and not options.channels_last and
+      options.precision == torch::kFloat32)
+    return;
+  std::shared_ptr<Net> reference{};
+  if (options.verify) {
+    reference = std::make_shared<Net>(in_channels, netdef);
+    torch::load(reference, weights_file);
+    reference->eval();
+  }
+  if (options.fold_batchnorm) net->foldBatchNorm();
+  if (options.precision != torch::kFloat32) net->to(options.precision);
+  if (options.channels_last) net->toChannelsLast();
+  std::cerr << "optimised netdef: " << net->netdef << '\n';
+  if (reference) verify(*reference, default_size, in_channels);
 }
 
 void MTorch::init(int /*size*/, const std::string& model_file,
@@ -176,26 +360,55 @@ void MTorch::init(int /*size*/, const std::string& model_file,
     load(model_file, weights_file, default_size);
 }
 
-std::vector<float> MTorch::get_data(float* data, int size, int planes,
-				    int psize)
+void MTorch::get_data(float* data, int size, int planes, int psize,
+		      float* output)
 {
-  auto options = torch::TensorOptions().dtype(torch::kFloat32);
-  torch::Tensor input = torch::from_blob(data, {1, planes, size, psize}, options);
-  torch::Tensor prediction = net->forward(input);
-  std::vector<float> result;
-  result.resize(size * size);
-
-  float sum = 0.0;
-  for (std::size_t i=0; i< result.size(); ++i) {
-    result[i] =  std::exp(prediction[0][0][i].item<float>());
-    sum += result[i];
-  }
+  torch::Tensor prediction = forward(*net, data, size, planes, psize);
+  // softmax as one tensor op, written straight into the caller's buffer
+  // (which may be the input buffer, already consumed by forward())
+  auto options_f = torch::TensorOptions().dtype(torch::kFloat32);
+  torch::Tensor result = torch::from_blob(output, {size * psize}, options_f);
+  result.copy_(torch::softmax(prediction[0], 0));
+  output[size * psize] = has_value() ? torch::tanh(prediction[1].mean()).item<float>()
+    : std::nanf("");
+}
 
-  for (std::size_t i = 0; i < result.size(); i++)
-    {
-      result[i] /= sum;
+std::tuple<int, std::vector<NativeCnn::Layer>, bool>
+foldedLayers(const std::string& model_file, const std::string& weights_file)
+{
+  torch::NoGradGuard no_grad{};
+  auto [in_channels, netdef] = read_cnn_def(model_file);
+  auto net = std::make_shared<Net>(in_channels, netdef);
+  torch::load(net, weights_file);
+  net->eval();
+  net->foldBatchNorm();
+  std::vector<NativeCnn::Layer> layers;
+  std::size_t conv_i = 0;
+  for (const auto& l : net->netdef) {
+    switch (l.layer_type) {
+    case LayerType::Conv:
+      {
+	auto& c = net->conv[conv_i++];
+	NativeCnn::Layer layer;
+	layer.out_channels = l.kernels;
+	layer.size = l.size;
+	layer.weights = toVector(c->weight);
+	layer.bias = c->bias.defined() ? toVector(c->bias) : std::vector<float>(l.kernels, 0.0f);
+	layers.push_back(std::move(layer));
+      }
+      break;
+    case LayerType::Batch:
+      throw CnnException("BatchNorm not following a convolution, cannot be exported");
+    case LayerType::Relu:
+      if (layers.empty())
+	throw CnnException("relu before the first convolution, cannot be exported");
+      layers.back().relu = true;
+      break;
+    case LayerType::Value:
+      break;
     }
-  return result;
+  }
+  return {in_channels, layers, net->hasValueHead()};
 }
 
 std::unique_ptr<CnnProxy> buildTorch()
@@ -22,25 +22,49 @@
 #pragma once
 
 #include "../mcnn.h"
+#include "../cnn_native.h"
 
 #include <torch/torch.h>
 #include <memory>
+#include <tuple>
 
 struct Net;
 
+// Load-time optimisations, set by the options line of cnn.config.
+struct MTorchOptions
+{
+  bool fold_batchnorm{true};
+  bool channels_last{false};
+  torch::ScalarType precision{torch::kFloat32};
+  bool verify{false};  // compare with the plain net and measure latency
+};
+
 class MTorch : public CnnProxy
 {
    public:
     MTorch();
     bool is_ready() const override;
+    bool has_value() const override;
+    void set_options(const std::string& options) override;
     void load(const std::string& model_file, const std::string& weights_file,
               int default_size) override;
     void init(int size, const std::string& model_file,
               const std::string& weights_file, int default_size) override;
-    std::vector<float> get_data(float* data, int size, int planes,
-                                int psize) override;
+    void get_data(float* data, int size, int planes, int psize,
+                float* output) override;
 
    private:
+    torch::Tensor forward(Net& n, float* data, int size, int planes,
+                          int psize) const;
+    void verify(Net& reference, int size, int in_channels);
+
     std::shared_ptr<Net> net = nullptr;
+    MTorchOptions options{};
     torch::NoGradGuard no_grad{};
 };
+
+// Loads a torch net, folds its BatchNorms and returns the input planes, the
+// layers in the format of NativeCnn and whether the net has a value head
+// (used by torch2native).
+std::tuple<int, std::vector<NativeCnn::Layer>, bool>
+foldedLayers(const std::string& model_file, const std::string& weights_file);
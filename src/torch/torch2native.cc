@@ -0,0 +1,43 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file torch2native.cc -- converts torch
+weights to the format of the native CNN engine.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "mtorch.h"
+
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+  if (argc != 4) {
+    std::cerr << "Usage: " << argv[0] << " model_def weights.pt output.bin\n"
+	      << "Then use in cnn.config: native: as the model and output.bin as the weights.\n";
+    return 1;
+  }
+  try {
+    const auto [in_channels, layers, value_head] = foldedLayers(argv[1], argv[2]);
+    NativeCnn::save(argv[3], in_channels, layers, value_head);
+    std::cerr << "Saved " << layers.size() << " layers, " << in_channels << " input planes, value head: " << value_head << ".\n";
+  }
+  catch (const std::exception& exc) {
+    std::cerr << "Conversion failed: " << exc.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
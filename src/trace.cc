@@ -0,0 +1,193 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file trace.cc -- timeline of the search
+threads in the Chrome trace-event format.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace
+{
+namespace
+{
+struct Event
+{
+    // relaxed atomics, so that a dump during recording is not a data race
+    std::atomic<const char *> name{nullptr};
+    std::atomic<int64_t> begin{0};
+    std::atomic<int64_t> end{0};
+};
+
+struct ThreadBuffer
+{
+    std::unique_ptr<Event[]> events{new Event[RING_SIZE]};
+    std::atomic<uint64_t> written{0};
+    uint64_t written_at_clear{0};  // under buffers_mutex
+    // false after the thread exited; the buffer is then given to the next
+    // new thread, keeping the spans recorded so far
+    bool in_use{true};
+    std::string thread_name;
+    int tid{0};
+};
+
+std::atomic<bool> enabled{false};
+std::atomic<int64_t> cleared_at{0};
+
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+int64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+ThreadBuffer *claimBuffer()
+{
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (auto &buf : buffers)
+    {
+        if (not buf->in_use)
+        {
+            buf->in_use = true;
+            buf->thread_name.clear();
+            return buf.get();
+        }
+    }
+    buffers.push_back(std::make_unique<ThreadBuffer>());
+    buffers.back()->tid = static_cast<int>(buffers.size());
+    return buffers.back().get();
+}
+
+struct BufferHolder
+{
+    ThreadBuffer *buf{nullptr};
+    ~BufferHolder()
+    {
+        if (buf == nullptr) return;
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        buf->in_use = false;
+    }
+};
+
+thread_local BufferHolder holder;
+
+ThreadBuffer &threadBuffer()
+{
+    if (holder.buf == nullptr) holder.buf = claimBuffer();
+    return *holder.buf;
+}
+
+void writeMicros(std::ostream &os, int64_t nanos)
+{
+    os << nanos / 1000 << '.' << std::setw(3) << std::setfill('0')
+       << nanos % 1000;
+}
+
+}  // namespace
+
+void setEnabled(bool on) { enabled = on; }
+
+bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+void setThreadName(const std::string &name)
+{
+    if (not isEnabled()) return;
+    auto &buf = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buf.thread_name = name;
+}
+
+Span::Span(const char *name) : name{name}, begin{isEnabled() ? nowNanos() : -1}
+{
+}
+
+Span::~Span()
+{
+    if (begin < 0) return;
+    const int64_t end = nowNanos();
+    auto &buf = threadBuffer();
+    const uint64_t w = buf.written.load(std::memory_order_relaxed);
+    auto &ev = buf.events[w % RING_SIZE];
+    ev.name.store(name, std::memory_order_relaxed);
+    ev.begin.store(begin, std::memory_order_relaxed);
+    ev.end.store(end, std::memory_order_relaxed);
+    buf.written.store(w + 1, std::memory_order_release);
+}
+
+void clear()
+{
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    cleared_at = nowNanos();
+    for (auto &buf : buffers) buf->written_at_clear = buf->written;
+}
+
+void writeChromeJson(std::ostream &os)
+{
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    const int64_t since = cleared_at;
+    uint64_t dropped = 0;
+    const auto fill = os.fill();
+    os << "{\"traceEvents\": [";
+    bool first = true;
+    for (const auto &buf : buffers)
+    {
+        os << (first ? "\n" : ",\n") << "{\"name\": \"thread_name\", "
+           << "\"ph\": \"M\", \"pid\": 1, \"tid\": " << buf->tid
+           << ", \"args\": {\"name\": \""
+           << (buf->thread_name.empty() ? "thread " + std::to_string(buf->tid)
+                                        : buf->thread_name)
+           << "\"}}";
+        first = false;
+        const uint64_t w = buf->written.load(std::memory_order_acquire);
+        const uint64_t oldest = w > RING_SIZE ? w - RING_SIZE : 0;
+        const uint64_t from = std::max(oldest, buf->written_at_clear);
+        for (uint64_t i = from; i < w; ++i)
+        {
+            const auto &ev = buf->events[i % RING_SIZE];
+            const char *name = ev.name.load(std::memory_order_relaxed);
+            const int64_t begin = ev.begin.load(std::memory_order_relaxed);
+            const int64_t end = ev.end.load(std::memory_order_relaxed);
+            if (name == nullptr or begin < since) continue;
+            os << ",\n{\"name\": \"" << name
+               << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buf->tid
+               << ", \"ts\": ";
+            writeMicros(os, begin - since);
+            os << ", \"dur\": ";
+            writeMicros(os, std::max<int64_t>(end - begin, 0));
+            os << "}";
+        }
+        dropped += from - buf->written_at_clear;
+    }
+    os.fill(fill);
+    os << "\n], \"displayTimeUnit\": \"ms\", \"otherData\": "
+       << "{\"overwritten_spans\": " << dropped << "}}" << std::endl;
+}
+
+}  // namespace trace
@@ -0,0 +1,67 @@
+/********************************************************************************************************
+ kropla -- a program to play Kropki; file trace.h -- timeline of the search
+threads in the Chrome trace-event format.
+    Copyright (C) 2023 Bartek Dyda, email: bartekdyda (at) protonmail (dot) com
+
+    Some parts are inspired by Pachi http://pachi.or.cz/
+      by Petr Baudis and Jean-loup Gailly
+
+    This file is part of Kropla.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*********************************************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Timeline of the search: when tracing is on, each Span records its begin and
+// end into a ring buffer of the calling thread (written only by that thread,
+// so without locks; the oldest spans are overwritten). writeChromeJson() dumps
+// the spans recorded since the last clear() as Chrome trace-event JSON, to be
+// opened in chrome://tracing or https://ui.perfetto.dev.
+// When tracing is off, a Span costs one relaxed atomic load.
+namespace trace
+{
+constexpr int RING_SIZE = 1 << 16;  // spans kept per thread
+
+void setEnabled(bool on);
+bool isEnabled();
+// name of the calling thread in the timeline
+void setThreadName(const std::string &name);
+
+class Span
+{
+   public:
+    // name must be a string literal (or live as long as the program)
+    explicit Span(const char *name);
+    ~Span();
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+   private:
+    const char *name;
+    int64_t begin;  // -1 if tracing was off
+};
+
+// forgets the spans recorded until now
+void clear();
+// spans may be recorded concurrently; an overwritten one may then come out
+// garbled, but no more than that
+void writeChromeJson(std::ostream &os);
+
+}  // namespace trace
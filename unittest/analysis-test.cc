@@ -0,0 +1,91 @@
+#include "analysis.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "game.h"
+#include "utils.h"
+
+namespace
+{
+
+class Analysis : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        // sets up coord for a 5x5 board
+        constructGameFromSgfWithIsometry(constructSgfFromGameBoard(".........."
+                                                                   ".........."
+                                                                   "....."),
+                                         0);
+        root.parent = &root;
+        root.children = first;
+        for (int i = 0; i < 3; ++i)
+        {
+            first[i].parent = &root;
+            first[i].move.ind = coord.ind(i, 0);
+        }
+        first[2].markAsLast();
+        setStats(first[0], 10, 4.0f, 3);  // 7 visits
+        setStats(first[1], 20, 15.0f, 0);
+        setStats(first[2], 2, 1.0f, 2);  // no visits
+        first[1].cnn_prob = 0.25f;
+
+        first[1].children = second;
+        second[0].parent = &first[1];
+        second[0].move.ind = coord.ind(1, 1);
+        second[0].markAsLast();
+        setStats(second[0], 5, 2.0f, 0);
+    }
+
+    static void setStats(Treenode &node, int32_t playouts, float value_sum,
+                         int32_t prior_playouts)
+    {
+        node.t.playouts = playouts;
+        node.t.value_sum = value_sum;
+        node.prior.playouts = prior_playouts;
+    }
+
+    Treenode root;
+    Treenode first[3];
+    Treenode second[1];
+};
+
+TEST_F(Analysis, snapshotSortsByVisitsAndSkipsUnvisited)
+{
+    const auto moves = analysis::snapshot(root, 5, 3);
+    ASSERT_EQ(2u, moves.size());
+    EXPECT_EQ("ba", moves[0].move);
+    EXPECT_EQ(20, moves[0].visits);
+    EXPECT_FLOAT_EQ(0.75f, moves[0].value);
+    EXPECT_FLOAT_EQ(0.25f, moves[0].prior);
+    EXPECT_EQ((std::vector<std::string>{"ba", "bb"}), moves[0].pv);
+    EXPECT_EQ("aa", moves[1].move);
+    EXPECT_EQ(7, moves[1].visits);
+    EXPECT_EQ(std::vector<std::string>{"aa"}, moves[1].pv);
+}
+
+TEST_F(Analysis, snapshotKeepsTopN)
+{
+    const auto moves = analysis::snapshot(root, 1, 0);
+    ASSERT_EQ(1u, moves.size());
+    EXPECT_EQ("ba", moves[0].move);
+    EXPECT_TRUE(moves[0].pv.empty());
+    EXPECT_EQ(
+        "[{\"move\": \"ba\", \"visits\": 20, \"value\": 0.750000, "
+        "\"prior\": 0.250000, \"pv\": []}]",
+        analysis::toJson(moves));
+}
+
+TEST_F(Analysis, bestContinuationFollowsMostVisited)
+{
+    EXPECT_EQ((std::vector<std::string>{"ba", "bb"}),
+              analysis::bestContinuation(&root, 10));
+    EXPECT_EQ(std::vector<std::string>{"ba"},
+              analysis::bestContinuation(&root, 1));
+}
+
+}  // namespace
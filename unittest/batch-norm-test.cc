@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "batch_norm.h"
+
+namespace
+{
+
+struct Conv
+{
+    int out_channels, size;
+    bool relu;
+    std::vector<float> weights, bias;
+};
+
+// three convolutions, the last one without relu, and their BatchNorms with
+// the statistics of a trained net
+void randomNet(int in_channels, std::mt19937& engine, std::vector<Conv>& convs,
+               std::vector<BatchNorm>& norms)
+{
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+    std::uniform_real_distribution<float> positive(0.1f, 2.0f);
+    int inch = in_channels;
+    for (auto [out_channels, size, relu] :
+         {std::tuple{6, 3, true}, std::tuple{5, 5, true},
+          std::tuple{2, 1, false}})
+    {
+        Conv conv{out_channels, size, relu, {}, {}};
+        conv.weights.resize(out_channels * inch * size * size);
+        conv.bias.resize(out_channels);
+        for (auto& w : conv.weights) w = dist(engine);
+        for (auto& b : conv.bias) b = dist(engine);
+        BatchNorm bn;
+        for (int c = 0; c < out_channels; ++c)
+        {
+            bn.weight.push_back(positive(engine));
+            bn.bias.push_back(dist(engine));
+            bn.running_mean.push_back(dist(engine));
+            bn.running_var.push_back(positive(engine));
+        }
+        convs.push_back(conv);
+        norms.push_back(bn);
+        inch = out_channels;
+    }
+}
+
+// straightforward convolutions with zero padding; with norms, each one is
+// followed by its BatchNorm (before the relu), as in the torch nets
+std::vector<float> forward(int in_channels, const std::vector<Conv>& convs,
+                           const std::vector<BatchNorm>& norms,
+                           const std::vector<float>& input, int h, int w)
+{
+    std::vector<float> act = input;
+    int inch = in_channels;
+    for (std::size_t i = 0; i < convs.size(); ++i)
+    {
+        const auto& conv = convs[i];
+        const int k = conv.size;
+        const int p = k / 2;
+        std::vector<float> out(conv.out_channels * h * w);
+        for (int oc = 0; oc < conv.out_channels; ++oc)
+            for (int y = 0; y < h; ++y)
+                for (int x = 0; x < w; ++x)
+                {
+                    double sum = conv.bias[oc];
+                    for (int ic = 0; ic < inch; ++ic)
+                        for (int ky = 0; ky < k; ++ky)
+                            for (int kx = 0; kx < k; ++kx)
+                            {
+                                const int yy = y + ky - p;
+                                const int xx = x + kx - p;
+                                if (yy < 0 or yy >= h or xx < 0 or xx >= w)
+                                    continue;
+                                sum += conv.weights[((oc * inch + ic) * k +
+                                                     ky) * k + kx] *
+                                       act[(ic * h + yy) * w + xx];
+                            }
+                    if (i < norms.size())
+                    {
+                        const auto& bn = norms[i];
+                        sum = (sum - bn.running_mean[oc]) * bn.weight[oc] /
+                                  std::sqrt(bn.running_var[oc] + bn.eps) +
+                              bn.bias[oc];
+                    }
+                    if (conv.relu and sum < 0) sum = 0;
+                    out[(oc * h + y) * w + x] = sum;
+                }
+        act = std::move(out);
+        inch = conv.out_channels;
+    }
+    return act;
+}
+
+}  // namespace
+
+TEST(BatchNorm, foldedNetMatchesThePlainOne)
+{
+    constexpr int planes = 3;
+    constexpr int h = 13;
+    constexpr int w = 17;
+    std::mt19937 engine(5);
+    std::vector<Conv> convs;
+    std::vector<BatchNorm> norms;
+    randomNet(planes, engine, convs, norms);
+    auto folded = convs;
+    for (std::size_t i = 0; i < folded.size(); ++i)
+        foldBatchNorm(folded[i].weights, folded[i].bias, norms[i]);
+    for (int position = 0; position < 5; ++position)
+    {
+        std::vector<float> input(planes * h * w);
+        std::bernoulli_distribution stone(0.3);
+        for (auto& v : input) v = stone(engine);
+        const auto expected = forward(planes, convs, norms, input, h, w);
+        const auto output = forward(planes, folded, {}, input, h, w);
+        ASSERT_EQ(expected.size(), output.size());
+        for (std::size_t i = 0; i < output.size(); ++i)
+            EXPECT_NEAR(expected[i], output[i], 1e-4) << position;
+    }
+}
+
+TEST(BatchNorm, foldRejectsOtherChannels)
+{
+    std::mt19937 engine(9);
+    std::vector<Conv> convs;
+    std::vector<BatchNorm> norms;
+    randomNet(3, engine, convs, norms);
+    EXPECT_THROW(foldBatchNorm(convs[0].weights, convs[0].bias, norms[1]),
+                 CnnException);
+    norms[0].running_var.pop_back();
+    EXPECT_THROW(foldBatchNorm(convs[0].weights, convs[0].bias, norms[0]),
+                 CnnException);
+}
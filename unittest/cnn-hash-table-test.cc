@@ -0,0 +1,45 @@
+#include "cnn_hash_table.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+// a model number not used by the nets of other tests
+constexpr int model = 1000;
+
+CnnInfo infoOf(float value)
+{
+    return std::make_shared<const std::vector<float>>(1, value);
+}
+
+TEST(CnnHashTable, keepsOnlyTheRecentlyUsedResults)
+{
+    forgetCnnInfo(model);
+    const std::size_t start_size = getCnnHtSize();
+    const Position first{1, 0};
+    saveCnnInfo(first, infoOf(1.0f), false, model);
+    for (uint64_t i = 2; i <= 3 * cnn_ht::max_generation_size; ++i)
+    {
+        saveCnnInfo({i, 0}, infoOf(float(i)), false, model);
+        // the first one stays, as it is used all the time
+        if (i % 1000 == 0)
+        {
+            ASSERT_TRUE(getCnnInfoFromHT(first, model).first);
+        }
+    }
+    EXPECT_LE(getCnnHtSize(), start_size + 2 * cnn_ht::max_generation_size);
+    const auto [found, info] = getCnnInfoFromHT(first, model);
+    ASSERT_TRUE(found);
+    EXPECT_EQ(1.0f, info->at(0));
+    EXPECT_FALSE(isCnnInfoInHT({2, 0}, model));
+    EXPECT_TRUE(isCnnInfoInHT({3 * cnn_ht::max_generation_size, 0}, model));
+    forgetCnnInfo(model);
+    EXPECT_FALSE(isCnnInfoInHT(first, model));
+}
+
+}  // namespace
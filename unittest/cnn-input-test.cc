@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "cnn_input.h"
+#include "game.h"
+#include "sgf.h"
+
+namespace
+{
+
+const std::string sgf_szkrab9506{
+    "(;FF[4]GM[40]CA[UTF-8]SZ[30]PB[deeppurple]BR[1867]PW[bobek_]WR[1171]"
+    "DT[2007-11-23 "
+    "00:57:07]AP[www.szkrab.net.pl:0.0.1]RE[B+R];B[po];W[qo];B[qn];W[ro];B["
+    "rn];W[pn];B[so];W[rp];B[sp];W[oo];B[pp];W[sn];B[rq];W[qq];B[qp."
+    "qprqspsornqnpoppqp];W[rr];B[sr];W[tr];B[qr];W[rs];B[ss];W[rt];B[pq."
+    "pqqrrqqppppq];W[st];B[ts];W[us];B[tt];W[ut];B[tu];W[to];B[tn];W[sm];B["
+    "ur];W[vr];B[tq.tqurtsttsssrrqsptq];W[un];B[tm];W[um];B[tl])"};
+
+// point by point encoding through the accessors of Game, layout
+// [plane][x][y]
+std::vector<float> reference(const Game& game, int planes, unsigned isometry)
+{
+    const int wx = coord.wlkx;
+    const int wy = coord.wlky;
+    std::vector<float> data(planes * wx * wy, 0.0f);
+    auto at = [&](int plane, pti p) -> float&
+    {
+        int x = coord.x[p];
+        int y = coord.y[p];
+        if (isometry & 1) x = wx - 1 - x;
+        if (isometry & 2) y = wy - 1 - y;
+        if (isometry & 4) std::swap(x, y);
+        return data[(plane * wx + x) * wy + y];
+    };
+    const int on_move = game.whoNowMoves();
+    const int opponent = 3 - on_move;
+    for (int x = 0; x < wx; ++x)
+        for (int y = 0; y < wy; ++y)
+        {
+            const pti p = coord.ind(x, y);
+            at(0, p) = (game.whoseDotMarginAt(p) == 0) ? 1.0f : 0.0f;
+            at(1, p) = (game.whoseDotMarginAt(p) == on_move) ? 1.0f : 0.0f;
+            at(2, p) = (game.whoseDotMarginAt(p) == opponent) ? 1.0f : 0.0f;
+            at(3, p) = game.isInTerr(p, on_move) > 0 ? 1.0f : 0.0f;
+            at(4, p) = game.isInTerr(p, opponent) > 0 ? 1.0f : 0.0f;
+            at(5, p) = std::min<pti>(game.isInEncl(p, on_move), 2) * 0.5f;
+            at(6, p) = std::min<pti>(game.isInEncl(p, opponent), 2) * 0.5f;
+            if (planes == 7) continue;
+            at(7, p) = std::min<pti>(game.isInBorder(p, on_move), 2) * 0.5f;
+            at(8, p) = std::min<pti>(game.isInBorder(p, opponent), 2) * 0.5f;
+            at(9, p) = std::min(game.getTotalSafetyOf(p), 2.0f) * 0.5f;
+            if (planes == 10) continue;
+            at(10, p) = (coord.dist[p] == 1) ? 1 : 0;
+            at(11, p) = 1;
+            at(16, p) = game.threats[on_move - 1].is_in_2m_encl[p] > 0;
+            at(17, p) = game.threats[opponent - 1].is_in_2m_encl[p] > 0;
+            at(18, p) = game.threats[on_move - 1].is_in_2m_miai[p] > 1;
+            at(19, p) = game.threats[opponent - 1].is_in_2m_miai[p] > 1;
+        }
+    if (planes == 20)
+        for (int player = 0; player < 2; ++player)
+        {
+            const bool mine = (player + 1 == on_move);
+            for (auto& t : game.threats[player].threats2m)
+                if (t.min_win2 && t.isSafe())
+                    at(mine ? 14 : 15, t.where0) =
+                        1.0f - std::pow(0.75f, t.min_win2);
+            for (auto& t : game.threats[player].threats)
+                if (t.where && t.singular_dots)
+                    at(mine ? 12 : 13, t.where) =
+                        1.0f - std::pow(0.75f, t.singular_dots);
+        }
+    return data;
+}
+
+class CnnInputTest : public ::testing::TestWithParam<int>
+{
+};
+
+}  // namespace
+
+TEST_P(CnnInputTest, encodesAsReferenceForAllIsometriesAndLayouts)
+{
+    const int planes = GetParam();
+    SgfParser parser(sgf_szkrab9506);
+    auto seq = parser.parseMainVar();
+    for (unsigned move_number : {10u, 21u, 34u, 39u})
+    {
+        Game game(SgfSequence(seq.begin(), seq.begin() + move_number + 1),
+                  1000);
+        const int wx = coord.wlkx;
+        const int wy = coord.wlky;
+        for (unsigned isometry = 0; isometry < 8; ++isometry)
+        {
+            const auto expected = reference(game, planes, isometry);
+            // garbage in the buffer must be overwritten
+            std::vector<float> first(expected.size(), -7.0f);
+            cnn_input::encodePlanes(game, planes, first.data(), isometry);
+            EXPECT_EQ(expected, first)
+                << "move " << move_number << ", isometry " << isometry;
+            std::vector<float> last(expected.size(), -7.0f);
+            cnn_input::encodePlanes(game, planes, last.data(), isometry,
+                                    cnn_input::Layout::PlanesLast);
+            for (int k = 0; k < planes; ++k)
+                for (int i = 0; i < wx * wy; ++i)
+                    ASSERT_EQ(expected[k * wx * wy + i], last[i * planes + k])
+                        << "plane " << k << ", isometry " << isometry;
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(Par, CnnInputTest, testing::Values(7, 10, 20));
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "cnn_native.h"
+
+namespace
+{
+
+std::vector<NativeCnn::Layer> randomLayers(int in_channels,
+                                           std::mt19937& engine)
+{
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+    struct Def
+    {
+        int out_channels, size;
+        bool relu;
+    };
+    const std::vector<Def> defs{{6, 3, true}, {5, 5, true}, {2, 1, false}};
+    std::vector<NativeCnn::Layer> layers;
+    int inch = in_channels;
+    for (const auto& d : defs)
+    {
+        NativeCnn::Layer layer;
+        layer.out_channels = d.out_channels;
+        layer.size = d.size;
+        layer.relu = d.relu;
+        layer.weights.resize(d.out_channels * inch * d.size * d.size);
+        layer.bias.resize(d.out_channels);
+        for (auto& w : layer.weights) w = dist(engine);
+        for (auto& b : layer.bias) b = dist(engine);
+        layers.push_back(layer);
+        inch = d.out_channels;
+    }
+    return layers;
+}
+
+// straightforward convolutions with zero padding, all output channels
+std::vector<float> referenceLogits(int in_channels,
+                                   const std::vector<NativeCnn::Layer>& layers,
+                                   const std::vector<float>& input, int h,
+                                   int w)
+{
+    std::vector<float> act = input;
+    int inch = in_channels;
+    for (const auto& layer : layers)
+    {
+        const int k = layer.size;
+        const int p = k / 2;
+        std::vector<float> out(layer.out_channels * h * w);
+        for (int oc = 0; oc < layer.out_channels; ++oc)
+            for (int y = 0; y < h; ++y)
+                for (int x = 0; x < w; ++x)
+                {
+                    double sum = layer.bias[oc];
+                    for (int ic = 0; ic < inch; ++ic)
+                        for (int ky = 0; ky < k; ++ky)
+                            for (int kx = 0; kx < k; ++kx)
+                            {
+                                const int yy = y + ky - p;
+                                const int xx = x + kx - p;
+                                if (yy < 0 or yy >= h or xx < 0 or xx >= w)
+                                    continue;
+                                sum += layer.weights[((oc * inch + ic) * k +
+                                                      ky) * k + kx] *
+                                       act[(ic * h + yy) * w + xx];
+                            }
+                    if (layer.relu and sum < 0) sum = 0;
+                    out[(oc * h + y) * w + x] = sum;
+                }
+        act = std::move(out);
+        inch = layer.out_channels;
+    }
+    return act;
+}
+
+// softmax of channel 0
+std::vector<float> reference(int in_channels,
+                             const std::vector<NativeCnn::Layer>& layers,
+                             const std::vector<float>& input, int h, int w)
+{
+    const auto act = referenceLogits(in_channels, layers, input, h, w);
+    std::vector<float> result(act.begin(), act.begin() + h * w);
+    double total = 0;
+    for (auto& r : result)
+    {
+        r = std::exp(r);
+        total += r;
+    }
+    for (auto& r : result) r /= total;
+    return result;
+}
+
+}  // namespace
+
+TEST(NativeCnn, matchesReferenceConvolutions)
+{
+    constexpr int planes = 3;
+    std::mt19937 engine(7);
+    const auto layers = randomLayers(planes, engine);
+    NativeCnn cnn;
+    cnn.setLayers(planes, layers);
+    // widths not divisible by the vector width, exercising the masked tails
+    for (auto [h, w] : {std::pair{7, 9}, std::pair{20, 20}, std::pair{13, 17}})
+    {
+        std::vector<float> input(planes * h * w);
+        std::bernoulli_distribution stone(0.3);
+        for (auto& v : input) v = stone(engine);
+        const auto expected = reference(planes, layers, input, h, w);
+        std::vector<float> output(h * w + 1);
+        cnn.get_data(input.data(), h, planes, w, output.data());
+        for (int i = 0; i < h * w; ++i)
+            EXPECT_NEAR(expected[i], output[i], 1e-5) << h << "x" << w;
+        EXPECT_TRUE(std::isnan(output[h * w]));
+        // output may overwrite the input
+        cnn.get_data(input.data(), h, planes, w, input.data());
+        for (int i = 0; i < h * w; ++i) EXPECT_FLOAT_EQ(output[i], input[i]);
+    }
+}
+
+TEST(NativeCnn, savedWeightsLoadToTheSameNet)
+{
+    constexpr int planes = 4;
+    constexpr int size = 10;
+    std::mt19937 engine(3);
+    const auto layers = randomLayers(planes, engine);
+    const auto file =
+        std::filesystem::temp_directory_path() / "kropla-native-test.bin";
+    NativeCnn::save(file, planes, layers, true);
+    NativeCnn loaded;
+    loaded.init(size, "", file, size);
+    std::filesystem::remove(file);
+    ASSERT_TRUE(loaded.is_ready());
+    EXPECT_TRUE(loaded.has_value());
+    NativeCnn direct;
+    direct.setLayers(planes, layers, true);
+    std::vector<float> input(planes * size * size, 0.0f);
+    input[5] = input[123] = input[250] = 1.0f;
+    std::vector<float> out1(size * size + 1), out2(size * size + 1);
+    loaded.get_data(input.data(), size, planes, size, out1.data());
+    direct.get_data(input.data(), size, planes, size, out2.data());
+    EXPECT_EQ(out1, out2);
+}
+
+TEST(NativeCnn, valueHeadIsTanhOfTheMeanOfSecondChannel)
+{
+    constexpr int planes = 3;
+    constexpr int h = 7;
+    constexpr int w = 9;
+    std::mt19937 engine(11);
+    const auto layers = randomLayers(planes, engine);
+    std::vector<float> input(planes * h * w);
+    std::bernoulli_distribution stone(0.3);
+    for (auto& v : input) v = stone(engine);
+    const auto logits = referenceLogits(planes, layers, input, h, w);
+    double value_sum = 0.0;
+    for (int i = 0; i < h * w; ++i) value_sum += logits[h * w + i];
+    NativeCnn cnn;
+    cnn.setLayers(planes, layers, true);
+    ASSERT_TRUE(cnn.has_value());
+    std::vector<float> output(h * w + 1);
+    cnn.get_data(input.data(), h, planes, w, output.data());
+    EXPECT_NEAR(std::tanh(value_sum / (h * w)), output[h * w], 1e-5);
+    const auto policy = reference(planes, layers, input, h, w);
+    for (int i = 0; i < h * w; ++i) EXPECT_NEAR(policy[i], output[i], 1e-5);
+}
+
+TEST(NativeCnn, rejectsWrongFiles)
+{
+    const auto file =
+        std::filesystem::temp_directory_path() / "kropla-native-bad.bin";
+    std::ofstream(file) << "not a net";
+    NativeCnn cnn;
+    EXPECT_THROW(cnn.load("", file, 20), CnnException);
+    std::filesystem::remove(file);
+    EXPECT_FALSE(cnn.is_ready());
+    EXPECT_THROW(cnn.load("", file, 20), CnnException);
+}
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include "cnn_router.h"
+
+namespace
+{
+
+CnnRouter twoModels()
+{
+    // big: 4 ms, 2 workers, up to depth 4; small: 0.5 ms, any depth
+    return CnnRouter({CnnRouter::Model{"big", 4, 4000.0, 2},
+                      CnnRouter::Model{"small", -1, 500.0, 1}});
+}
+
+}  // namespace
+
+TEST(CnnRouter, choosesByDepth)
+{
+    auto router = twoModels();
+    EXPECT_EQ(0, router.choose(0));
+    EXPECT_EQ(0, router.choose(4));
+    EXPECT_EQ(1, router.choose(5));
+    EXPECT_EQ(1, router.choose(100));
+}
+
+TEST(CnnRouter, respectsTimeLeft)
+{
+    auto router = twoModels();
+    EXPECT_EQ(0, router.choose(1, 5000.0));
+    EXPECT_EQ(1, router.choose(1, 3000.0));
+    // nothing fits, the cheapest allowed model answers
+    EXPECT_EQ(1, router.choose(1, 100.0));
+}
+
+TEST(CnnRouter, degradesUnderLoad)
+{
+    auto router = twoModels();
+    router.started(0);
+    router.started(0);
+    // a third query would wait for half a forward on average
+    EXPECT_DOUBLE_EQ(6000.0, router.expectedLatency(0));
+    EXPECT_EQ(0, router.choose(1));
+    router.started(0);
+    router.started(0);
+    EXPECT_DOUBLE_EQ(10000.0, router.expectedLatency(0));
+    EXPECT_EQ(1, router.choose(1));
+    router.finished(0, std::nullopt);
+    router.finished(0, std::nullopt);
+    EXPECT_EQ(2, router.inFlight(0));
+    EXPECT_EQ(0, router.choose(1));
+}
+
+TEST(CnnRouter, learnsForwardTime)
+{
+    CnnRouter router({CnnRouter::Model{"unknown", -1, 0.0, 1}});
+    router.started(0);
+    router.finished(0, 1000.0);
+    EXPECT_DOUBLE_EQ(1000.0, router.costEstimate(0));
+    router.started(0);
+    router.finished(0, 2000.0);
+    EXPECT_DOUBLE_EQ(1000.0 + CnnRouter::ema_weight * 1000.0,
+                     router.costEstimate(0));
+    EXPECT_EQ(0, router.inFlight(0));
+}
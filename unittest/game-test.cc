@@ -540,6 +540,93 @@ TEST(Zobrist, worksForEnclMoves)
     EXPECT_EQ(zobr, game.getZobrist());
 }
 
+TEST(Undo, unmakeMoveRestoresTheGame)
+{
+    auto sgf = constructSgfFromGameBoard(
+        ".ox...."
+        "oxox..."
+        "......."
+        "......."
+        "......."
+        "......."
+        ".......");
+    Game game = constructGameFromSgfWithIsometry(sgf, 0);
+    const Game initial = game;
+    EXPECT_FALSE(game.unmakeMove());
+    game.makeSgfMoveWithUndo("dd", 2);
+    const Game after_first = game;
+    game.makeSgfMoveWithUndo("bc.bccbbaabbc", 1);
+    game.makeSgfMoveWithUndo("ee", 2);
+    EXPECT_EQ(3u, game.undoDepth());
+    const Game before_illegal = game;
+    EXPECT_THROW(game.makeSgfMoveWithUndo("ee", 1), std::runtime_error);
+    EXPECT_EQ(3u, game.undoDepth());
+    EXPECT_TRUE(game.hasSameStateAs(before_illegal));
+
+    ASSERT_TRUE(game.unmakeMove());
+    ASSERT_TRUE(game.unmakeMove());
+    EXPECT_EQ(1u, game.undoDepth());
+    EXPECT_TRUE(game.hasSameStateAs(after_first));
+    EXPECT_EQ(after_first.showString(), game.showString());
+
+    // the enclosure can be made again
+    game.makeSgfMoveWithUndo("bc.bccbbaabbc", 1);
+    Game replayed = after_first;
+    replayed.makeSgfMove("bc.bccbbaabbc", 1);
+    EXPECT_TRUE(game.hasSameStateAs(replayed));
+
+    ASSERT_TRUE(game.unmakeMove());
+    ASSERT_TRUE(game.unmakeMove());
+    EXPECT_FALSE(game.unmakeMove());
+    EXPECT_TRUE(game.hasSameStateAs(initial));
+}
+
+TEST(Undo, unmakeMoveGivesTheGameOfTheReplay)
+{
+    const auto sgf = constructSgfFromGameBoard(std::string(12 * 12, '.'));
+    Game game = constructGameFromSgfWithIsometry(sgf, 0);
+    game.getRandomEngine().seed(7);
+    std::vector<Move> moves;
+    int enclosures = 0;
+    for (std::size_t i = 0; i < Game::max_undo_depth; ++i)
+    {
+        Move m = game.chooseAnyMove(game.whoNowMoves(), 0);
+        if (m.ind == 0) break;
+        m = game.getRandomEncl(m);
+        enclosures += m.enclosures.size();
+        game.makeMoveWithUndo(m);
+        moves.push_back(m);
+    }
+    EXPECT_GT(enclosures, 0);
+    while (not moves.empty())
+    {
+        ASSERT_TRUE(game.unmakeMove());
+        moves.pop_back();
+        Game replayed = constructGameFromSgfWithIsometry(sgf, 0);
+        for (const auto &m : moves) replayed.makeMove(m);
+        ASSERT_TRUE(game.hasSameStateAs(replayed)) << moves.size();
+    }
+    EXPECT_FALSE(game.unmakeMove());
+}
+
+TEST(Undo, journalIsNotCopiedAndIsBounded)
+{
+    Game game = constructGameFromSgfWithIsometry(
+        constructSgfFromGameBoard(std::string(20 * 20, '.')), 0);
+    game.makeSgfMoveWithUndo("aa", 1);
+    Game copy = game;
+    EXPECT_EQ(0u, copy.undoDepth());
+    EXPECT_FALSE(copy.unmakeMove());
+    copy = game;
+    EXPECT_EQ(0u, copy.undoDepth());
+
+    int who = 2;
+    for (std::size_t i = 0; i <= Game::max_undo_depth; ++i, who = 3 - who)
+        game.makeSgfMoveWithUndo(coord.indToSgf(coord.ind(i % 20, i / 20 + 1)),
+                                 who);
+    EXPECT_EQ(Game::max_undo_depth, game.undoDepth());
+}
+
 TEST_P(IsometryFixture, deleteUnnecessaryThreats)
 {
     const unsigned isometry = GetParam();
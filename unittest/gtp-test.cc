@@ -0,0 +1,163 @@
+#include "gtp.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <limits>
+#include <string>
+
+namespace
+{
+
+constexpr auto empty_board = "(;FF[4]GM[40]CA[UTF-8]SZ[9])";
+
+TEST(Gtp, simpleCommandsAndIds)
+{
+    GtpEngine engine(empty_board, 1, 50, 0);
+    EXPECT_EQ("= 2\n\n", engine.execute("protocol_version"));
+    EXPECT_EQ("=7 kropla\n\n", engine.execute("7 name"));
+    EXPECT_EQ("= true\n\n", engine.execute("known_command genmove"));
+    EXPECT_EQ("= false\n\n", engine.execute("known_command fly"));
+    EXPECT_EQ("?3 unknown command\n\n", engine.execute("3 fly"));
+    EXPECT_EQ("", engine.execute("   "));
+    EXPECT_FALSE(engine.hasQuit());
+    EXPECT_EQ("= \n\n", engine.execute("quit"));
+    EXPECT_TRUE(engine.hasQuit());
+}
+
+TEST(Gtp, playAndUndoChangeTheLiveGame)
+{
+    GtpEngine engine(empty_board, 1, 50, 0);
+    const auto start = engine.getGame().getHistory().size();
+    EXPECT_EQ("= \n\n", engine.execute("play b cc"));
+    EXPECT_EQ("= \n\n", engine.execute("play dd"));
+    EXPECT_EQ(start + 2, engine.getGame().getHistory().size());
+    EXPECT_EQ(1, engine.getGame().whoNowMoves());
+    EXPECT_EQ("? illegal move cc\n\n", engine.execute("play b cc"));
+    EXPECT_EQ("? invalid move zz\n\n", engine.execute("play b zz"));
+    EXPECT_EQ("? invalid colour x\n\n", engine.execute("play x ee"));
+
+    EXPECT_EQ("= \n\n", engine.execute("undo"));
+    EXPECT_EQ(start + 1, engine.getGame().getHistory().size());
+    EXPECT_EQ(2, engine.getGame().whoNowMoves());
+    EXPECT_EQ("= \n\n", engine.execute("play w dd"));
+    EXPECT_EQ("= \n\n", engine.execute("clear_board"));
+    EXPECT_EQ(start, engine.getGame().getHistory().size());
+    EXPECT_EQ("? cannot undo\n\n", engine.execute("undo"));
+}
+
+TEST(Gtp, illegalMoveKeepsTheGameAndTheTree)
+{
+    GtpEngine engine(empty_board, 1, 200, 0);
+    EXPECT_EQ("= \n\n", engine.execute("play b ee"));
+    const auto response = engine.execute("genmove w");
+    ASSERT_EQ("= ", response.substr(0, 2)) << response;
+    const Game before = engine.getGame();
+    const auto kept = engine.keptNodes();
+    EXPECT_GT(kept, 0u);
+    EXPECT_EQ("? illegal move ee\n\n", engine.execute("play b ee"));
+    EXPECT_TRUE(engine.getGame().hasSameStateAs(before));
+    EXPECT_EQ(kept, engine.keptNodes());
+    // and undo takes back the last legal move
+    EXPECT_EQ("= \n\n", engine.execute("undo"));
+    EXPECT_EQ(2, engine.getGame().whoNowMoves());
+}
+
+TEST(Gtp, unsupportedSizesAreRejectedAndKeepTheBoard)
+{
+    GtpEngine engine(empty_board, 1, 50, 0);
+    EXPECT_EQ("= \n\n", engine.execute("play b ee"));
+    EXPECT_EQ("? unacceptable size\n\n", engine.execute("boardsize 50"));
+    EXPECT_EQ("? unacceptable size\n\n", engine.execute("boardsize 9 41"));
+    EXPECT_EQ("? unacceptable size\n\n", engine.execute("boardsize 4"));
+    EXPECT_EQ(9, coord.wlkx);
+    EXPECT_EQ("= \n\n", engine.execute("play w ii"));
+    EXPECT_THROW(engine.setPosition("(;FF[4]GM[40]SZ[50])"),
+                 std::runtime_error);
+    EXPECT_EQ(9, coord.wlkx);
+    EXPECT_EQ("= \n\n", engine.execute("boardsize 40"));
+    EXPECT_EQ(40, coord.wlkx);
+    EXPECT_EQ("= \n\n", engine.execute("boardsize 9"));
+}
+
+TEST(Gtp, encirclingMoveIsPlayed)
+{
+    GtpEngine engine(empty_board, 1, 50, 0);
+    for (const auto *move : {"b cb", "w cc", "b bc", "w ee", "b dc", "w ff"})
+        EXPECT_EQ("= \n\n", engine.execute(std::string("play ") + move));
+    EXPECT_EQ("= \n\n", engine.execute("play b cd.cbbccddccb"));
+    EXPECT_EQ("? illegal move cc\n\n", engine.execute("play w cc"));
+}
+
+TEST(Gtp, genmovePlaysTheMoveAndKeepsTheTree)
+{
+    GtpEngine engine(empty_board, 2, 200, 0);
+    const auto start = engine.getGame().getHistory().size();
+    EXPECT_EQ("= \n\n", engine.execute("play b ee"));
+    EXPECT_EQ("? it is not the move of b\n\n", engine.execute("genmove b"));
+    const auto response = engine.execute("genmove w");
+    ASSERT_EQ("= ", response.substr(0, 2)) << response;
+    EXPECT_EQ(start + 2, engine.getGame().getHistory().size());
+    EXPECT_EQ(1, engine.getGame().whoNowMoves());
+
+    // the answer to it, and a search that may start from the kept tree
+    const std::string answer = response.substr(2, 2) == "dd" ? "ff" : "dd";
+    EXPECT_EQ("= \n\n", engine.execute("play b " + answer));
+    const auto response2 = engine.execute("genmove");
+    ASSERT_EQ("= ", response2.substr(0, 2)) << response2;
+    EXPECT_EQ(start + 4, engine.getGame().getHistory().size());
+}
+
+TEST(Gtp, genmoveAfterAnalyzeContinuesTheSearch)
+{
+    GtpEngine engine(empty_board, 2, 300, 0);
+    EXPECT_EQ("= \n\n", engine.execute("play b ee"));
+    const auto analysis = engine.execute("analyze 200");
+    ASSERT_EQ("= [{\"move\": ", analysis.substr(0, 12)) << analysis;
+    const int32_t analyzed = montec::root.t.playouts;
+    EXPECT_GT(analyzed, 0);
+    ASSERT_EQ("= ", engine.execute("genmove").substr(0, 2));
+    EXPECT_GE(montec::root.t.playouts, analyzed + montec::iterations);
+}
+
+TEST(Gtp, komiAndTimeLeft)
+{
+    GtpEngine engine(empty_board, 1, 50, 0);
+    const int saved = global::komi;
+    EXPECT_EQ("= \n\n", engine.execute("set_komi 2.4"));
+    EXPECT_EQ(2, global::komi);
+    EXPECT_EQ("? invalid komi x\n\n", engine.execute("komi x"));
+    global::komi = saved;
+    EXPECT_EQ("= \n\n", engine.execute("time_left b 60 10"));
+    EXPECT_EQ("? invalid number 1m\n\n", engine.execute("time_left b 1m"));
+    // more msec than an int holds
+    EXPECT_EQ("= \n\n", engine.execute("time_left b 3000000"));
+}
+
+TEST(Gtp, eachEngineKeepsItsKomi)
+{
+    GtpEngine first(empty_board, 1, 50, 0);
+    EXPECT_EQ("= \n\n", first.execute("komi 6"));
+    // made after the komi of first was set, as engines of the server are
+    GtpEngine second(empty_board, 1, 50, 0, 2);
+    EXPECT_EQ("= \n\n", second.execute("clear_board"));
+    EXPECT_EQ(2, global::komi);
+    EXPECT_EQ("= \n\n", first.execute("clear_board"));
+    EXPECT_EQ(6, global::komi);
+    global::komi = 0;
+}
+
+TEST(Gtp, genmoveUsesTheClockOfThePlayerToMove)
+{
+    GtpEngine engine(empty_board, 1, std::numeric_limits<int>::max(), 0);
+    // a share of 20 msec for white, of 1000 s for black, which comes last
+    EXPECT_EQ("= \n\n", engine.execute("time_left w 1 50"));
+    EXPECT_EQ("= \n\n", engine.execute("time_left b 1000 1"));
+    EXPECT_EQ("= \n\n", engine.execute("play b ee"));
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ("= ", engine.execute("genmove w").substr(0, 2));
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(20));
+}
+
+}  // namespace
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include "latency_histogram.h"
+
+namespace
+{
+
+TEST(LatencyHistogram, emptyGivesZero)
+{
+    LatencyHistogram h;
+    EXPECT_EQ(0u, h.count());
+    EXPECT_EQ(0.0, h.percentile(0.5));
+    EXPECT_EQ(0.0, h.mean());
+}
+
+TEST(LatencyHistogram, percentilesWithinBucketError)
+{
+    LatencyHistogram h;
+    for (int i = 1; i <= 1000; ++i) h.add(i);
+    EXPECT_EQ(1000u, h.count());
+    EXPECT_NEAR(500.5, h.mean(), 1.0);
+    // reported values are upper bounds of buckets, at most 2^(1/4) too large
+    const double p50 = h.percentile(0.5);
+    EXPECT_GE(p50, 500.0);
+    EXPECT_LE(p50, 500.0 * 1.19);
+    const double p99 = h.percentile(0.99);
+    EXPECT_GE(p99, 990.0);
+    EXPECT_LE(p99, 990.0 * 1.19);
+    EXPECT_LE(p50, p99);
+}
+
+TEST(LatencyHistogram, tailIsVisible)
+{
+    LatencyHistogram h;
+    for (int i = 0; i < 990; ++i) h.add(100.0);
+    for (int i = 0; i < 10; ++i) h.add(100000.0);
+    EXPECT_LE(h.percentile(0.5), 119.0);
+    EXPECT_LE(h.percentile(0.99), 119.0);
+    EXPECT_GE(h.percentile(0.995), 100000.0);
+    h.clear();
+    EXPECT_EQ(0u, h.count());
+}
+
+}  // namespace
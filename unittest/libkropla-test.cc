@@ -0,0 +1,79 @@
+#include "libkropla.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using EnginePtr = std::unique_ptr<kropla_engine, decltype(&kropla_destroy)>;
+
+EnginePtr createEngine()
+{
+    return EnginePtr(kropla_create(nullptr, 2), &kropla_destroy);
+}
+
+TEST(Libkropla, positionPlayAndErrors)
+{
+    EXPECT_EQ(KROPLA_API_VERSION, kropla_api_version());
+    auto engine = createEngine();
+    ASSERT_NE(nullptr, engine);
+    const char *moves[] = {"cb", "cc", "bc", "ee", "dc", "ff", "cd.cbbccddccb"};
+    ASSERT_EQ(KROPLA_OK,
+              kropla_set_position_moves(engine.get(), 9, 9, moves, 7));
+    kropla_stats stats;
+    ASSERT_EQ(KROPLA_OK, kropla_get_stats(engine.get(), &stats));
+    EXPECT_EQ(8, stats.move_number);
+    EXPECT_EQ(KROPLA_WHITE, stats.to_move);
+
+    EXPECT_EQ(KROPLA_ERROR, kropla_play(engine.get(), KROPLA_WHITE, "cc"));
+    EXPECT_EQ(std::string("illegal move cc"), kropla_last_error(engine.get()));
+    EXPECT_EQ(KROPLA_ERROR, kropla_play(engine.get(), 7, "aa"));
+    EXPECT_EQ(KROPLA_OK, kropla_play(engine.get(), KROPLA_TO_MOVE, "aa"));
+    EXPECT_EQ(KROPLA_OK, kropla_undo(engine.get()));
+
+    EXPECT_EQ(KROPLA_OK, kropla_set_position_sgf(
+                             engine.get(), "(;GM[40]FF[4]SZ[7];B[dd];W[de])"));
+    ASSERT_EQ(KROPLA_OK, kropla_get_stats(engine.get(), &stats));
+    EXPECT_EQ(3, stats.move_number);
+    EXPECT_EQ(KROPLA_BLACK, stats.to_move);
+    EXPECT_EQ(KROPLA_ERROR, kropla_undo(engine.get()));
+}
+
+TEST(Libkropla, genmoveAndAnalyzeWithCallback)
+{
+    auto engine = createEngine();
+    ASSERT_NE(nullptr, engine);
+    ASSERT_EQ(KROPLA_OK, kropla_set_position_sgf(
+                             engine.get(), "(;GM[40]FF[4]SZ[9];B[ee])"));
+    std::vector<std::string> lines;
+    ASSERT_EQ(KROPLA_OK,
+              kropla_set_analysis_callback(
+                  engine.get(),
+                  [](const char *json, void *user_data)
+                  {
+                      static_cast<std::vector<std::string> *>(user_data)
+                          ->push_back(json);
+                  },
+                  &lines, 50));
+
+    const char *analysis = kropla_analyze(engine.get(), 200);
+    ASSERT_NE(nullptr, analysis);
+    EXPECT_EQ('[', analysis[0]);
+    ASSERT_FALSE(lines.empty());
+    EXPECT_NE(std::string::npos, lines.back().find("\"final\": true"));
+
+    const char *move = kropla_genmove(engine.get(), 100, 0);
+    ASSERT_NE(nullptr, move);
+    EXPECT_EQ(2u, std::string(move).size());
+    kropla_stats stats;
+    ASSERT_EQ(KROPLA_OK, kropla_get_stats(engine.get(), &stats));
+    EXPECT_GE(stats.iterations, 100);
+    EXPECT_GT(stats.root_visits, 0);
+    EXPECT_EQ(3, stats.move_number);
+}
+
+}  // namespace
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include "logger.h"
+
+namespace
+{
+
+class Logger : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        logger::flush();
+        logger::setSink([this](std::string_view text) { out += text; });
+    }
+    void TearDown() override
+    {
+        logger::flush();
+        logger::setSink(nullptr);
+        logger::setLevel(logger::Level::info);
+    }
+    std::string out;
+};
+
+TEST_F(Logger, linesBelowTheLevelAreNotEvaluated)
+{
+    logger::setLevel(logger::Level::info);
+    int evaluated = 0;
+    const auto count = [&]() { return ++evaluated; };
+    KROPLA_LOG(debug) << "hidden " << count();
+    KROPLA_LOG(info) << "shown " << count();
+    logger::flush();
+    EXPECT_EQ(1, evaluated);
+    EXPECT_EQ("shown 1\n", out);
+}
+
+TEST_F(Logger, linesOfThreadsComeOutWhole)
+{
+    logger::setLevel(logger::Level::debug);
+    const auto work = [](int n)
+    {
+        for (int i = 0; i < 100; ++i)
+            KROPLA_LOG(debug) << "thr " << n << "." << i;
+    };
+    std::thread t1(work, 1), t2(work, 2);
+    t1.join();
+    t2.join();
+    logger::flush();
+    for (int n = 1; n <= 2; ++n)
+    {
+        std::size_t prev = 0;
+        for (int i = 0; i < 100; ++i)
+        {
+            const auto line =
+                "thr " + std::to_string(n) + "." + std::to_string(i) + "\n";
+            const auto pos = out.find(line);
+            ASSERT_NE(std::string::npos, pos) << line;
+            EXPECT_LE(prev, pos);
+            prev = pos;
+        }
+    }
+}
+
+TEST_F(Logger, parsesLevels)
+{
+    EXPECT_EQ(logger::Level::error, logger::parseLevel("error"));
+    EXPECT_EQ(logger::Level::debug, logger::parseLevel("debug"));
+    EXPECT_FALSE(logger::parseLevel("verbose"));
+}
+
+}  // namespace
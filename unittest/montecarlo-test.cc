@@ -0,0 +1,67 @@
+#include "montecarlo.h"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "game.h"
+#include "sgf.h"
+
+namespace
+{
+
+using Determinism = MonteCarlo::Determinism;
+using RootStats = std::vector<std::tuple<std::string, int32_t, float>>;
+
+Game testGame()
+{
+    SgfParser parser("(;FF[4]GM[40]SZ[9];B[ee];W[de];B[dd];W[ed])");
+    return Game(parser.parseMainVar(), std::numeric_limits<int>::max());
+}
+
+RootStats rootStats()
+{
+    RootStats stats;
+    for (const Treenode *ch = montec::root.children; ch != nullptr; ++ch)
+    {
+        stats.emplace_back(ch->getMoveSgf(), ch->t.playouts.load(),
+                           ch->t.value_sum.load());
+        if (ch->isLast()) break;
+    }
+    return stats;
+}
+
+RootStats search(Determinism mode, int threads, int iter_count)
+{
+    Game game = testGame();
+    MonteCarlo mc;
+    mc.setSeed(7);
+    mc.setDeterminism(mode);
+    mc.findBestMoveMT(game, threads, iter_count,
+                      std::numeric_limits<int>::max());
+    EXPECT_EQ(iter_count, montec::iterations);
+    return rootStats();
+}
+
+TEST(MonteCarlo, nodeCountSearchMakesExactlyTheIterations)
+{
+    const auto stats = search(Determinism::node_count, 3, 301);
+    EXPECT_FALSE(stats.empty());
+    EXPECT_EQ(search(Determinism::node_count, 1, 250),
+              search(Determinism::node_count, 1, 250));
+}
+
+TEST(MonteCarlo, lockstepSearchIsReproducible)
+{
+    // more than montec::start_increasing iterations, so that komi may change
+    const auto first = search(Determinism::lockstep, 4, 400);
+    ASSERT_FALSE(first.empty());
+    EXPECT_EQ(first, search(Determinism::lockstep, 4, 400));
+    EXPECT_EQ(search(Determinism::node_count, 1, 300),
+              search(Determinism::lockstep, 1, 300));
+}
+
+}  // namespace
@@ -0,0 +1,127 @@
+#include "playout_board.h"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <random>
+#include <string>
+
+#include "game.h"
+#include "montecarlo.h"
+#include "sgf.h"
+
+namespace
+{
+
+Game gameFromSgf(const std::string &sgf)
+{
+    SgfParser parser(sgf);
+    return Game(parser.parseMainVar(), std::numeric_limits<int>::max());
+}
+
+// the last move of board, with the borders of its enclosures found by game
+// (where the move is not played yet)
+std::string sgfMove(const PlayoutBoard &board, const Game &game, pti ind)
+{
+    auto move = coord.indToSgf(ind);
+    if (board.getLastEnclosures().empty()) return move;
+    Game after_dot = game;
+    const int who = game.whoNowMoves();
+    after_dot.placeDot(coord.x[ind], coord.y[ind], who);
+    for (auto p : board.getLastEnclosures())
+        move += after_dot.findEnclosure(p, SimpleGame::MASK_DOT, who)
+                    .toSgfString();
+    return move;
+}
+
+void expectSameAsGame(const PlayoutBoard &board, const Game &game)
+{
+    EXPECT_EQ(game.whoNowMoves(), board.whoNowMoves());
+    for (pti i = coord.first; i <= coord.last; ++i)
+        ASSERT_EQ(game.whoseDotMarginAt(i), board.whoseDotMarginAt(i))
+            << coord.showPt(i);
+    EXPECT_EQ(game.countTerritory_simple(game.whoNowMoves()),
+              board.countTerritory_simple(board.whoNowMoves()));
+}
+
+TEST(PlayoutBoard, enclosesAndMakesPools)
+{
+    Game game =
+        gameFromSgf("(;FF[4]GM[40]SZ[9];B[cb];W[cc];B[bc];W[ee];B[dc];W[ff])");
+    PlayoutBoard board(game);
+    expectSameAsGame(board, game);
+    const pti cd = coord.sgfToPti("cd");
+    ASSERT_TRUE(board.isPlayable(cd));
+    board.play(cd);
+    ASSERT_EQ(1u, board.getLastEnclosures().size());
+    EXPECT_EQ(cd, board.getLastEnclosures()[0] + coord.nb4[2]);
+    game.makeSgfMove(sgfMove(board, game, cd), 1);
+    expectSameAsGame(board, game);
+
+    // a closed region without white dots becomes a pool of black
+    for (const auto *move : {"ab", "gf", "ac", "fg", "ad", "hg", "ae", "gh"})
+    {
+        const pti ind = coord.sgfToPti(move);
+        ASSERT_TRUE(board.isPlayable(ind)) << move;
+        const int who = board.whoNowMoves();
+        board.play(ind);
+        EXPECT_TRUE(board.getLastEnclosures().empty());
+        game.makeSgfMove(move, who);
+    }
+    EXPECT_EQ(1, board.whosePoolAt(coord.sgfToPti("gg")));
+    EXPECT_FALSE(board.isPlayable(coord.sgfToPti("gg")));
+    expectSameAsGame(board, game);
+}
+
+TEST(PlayoutBoard, playoutsReachTheScoresOfGame)
+{
+    int enclosures = 0;
+    for (unsigned seed = 1; seed <= 12; ++seed)
+    {
+        Game game = gameFromSgf(
+            "(;FF[4]GM[40]SZ[9];B[ee];W[de];B[dd];W[ed];B[fe];W[ef])");
+        PlayoutBoard board(game);
+        std::default_random_engine engine(seed);
+        int moves = 0;
+        while (const pti m = board.chooseMove(engine))
+        {
+            const int who = board.whoNowMoves();
+            board.play(m);
+            game.makeSgfMove(sgfMove(board, game, m), who);
+            ++moves;
+            enclosures += board.getLastEnclosures().size();
+            expectSameAsGame(board, game);
+            if (HasFatalFailure() or HasFailure()) return;
+        }
+        EXPECT_GT(moves, 20);
+        for (pti i = coord.first; i <= coord.last; ++i)
+            EXPECT_FALSE(board.isPlayable(i));
+    }
+    EXPECT_GT(enclosures, 12);
+}
+
+TEST(PlayoutBoard, randomPlayoutLeavesTheGameAndRollsOut)
+{
+    Game game = gameFromSgf("(;FF[4]GM[40]SZ[9];B[ee];W[de])");
+    const auto history_size = game.getHistory().size();
+    std::default_random_engine engine(3);
+    for (int i = 0; i < 20; ++i)
+    {
+        PlayoutBoard board(game);
+        const real_t v = board.randomPlayout(engine);
+        EXPECT_GE(v, 0.0);
+        EXPECT_LE(v, 1.0);
+        EXPECT_GT(board.getHistory().size(), history_size);
+    }
+    EXPECT_EQ(history_size, game.getHistory().size());
+
+    MonteCarlo mc;
+    PlayoutBoard::setEnabled(true);
+    mc.setSeed(5);
+    mc.findBestMoveMT(game, 2, 200, std::numeric_limits<int>::max());
+    PlayoutBoard::setEnabled(false);
+    EXPECT_GE(montec::iterations, 200);
+    EXPECT_GE(montec::root.t.playouts, 200);
+}
+
+}  // namespace
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+#include "profiler.h"
+
+namespace
+{
+
+TEST(Profiler, jsonListsCalledPhasesAndAllCounters)
+{
+    prof::Totals totals;
+    totals.calls[static_cast<int>(prof::Phase::place_dot)] = 3;
+    totals.nanos[static_cast<int>(prof::Phase::place_dot)] = 1500;
+    totals.counters[static_cast<int>(prof::Counter::threats2m_skipped)] = 2;
+    std::ostringstream os;
+    prof::writeJson(os, totals);
+    const auto json = os.str();
+    EXPECT_NE(std::string::npos,
+              json.find("\"place_dot\": {\"calls\": 3, \"nanos\": 1500}"));
+    EXPECT_EQ(std::string::npos, json.find("\"scoring\""));
+    EXPECT_NE(std::string::npos, json.find("\"threats2m_skipped\": 2"));
+    EXPECT_NE(std::string::npos, json.find("\"threats2m_checked\": 0"));
+}
+
+TEST(Profiler, addMergesTotals)
+{
+    prof::Totals a, b;
+    EXPECT_TRUE(a.empty());
+    b.calls[0] = 1;
+    b.nanos[0] = 10;
+    b.counters[1] = 5;
+    a.add(b);
+    a.add(b);
+    EXPECT_FALSE(a.empty());
+    EXPECT_EQ(2u, a.calls[0]);
+    EXPECT_EQ(20u, a.nanos[0]);
+    EXPECT_EQ(10u, a.counters[1]);
+}
+
+TEST(Profiler, threadsAreMergedWhenFlushed)
+{
+    prof::reset();
+    const auto work = []
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            KROPLA_PROFILE_SCOPE(scoring);
+            KROPLA_PROFILE_COUNT(threats2m_encl_points, 2);
+        }
+        prof::flushThread();
+    };
+    std::thread t1(work), t2(work);
+    t1.join();
+    t2.join();
+    const auto totals = prof::collect();
+    const int scoring = static_cast<int>(prof::Phase::scoring);
+    const int points = static_cast<int>(prof::Counter::threats2m_encl_points);
+    if (prof::enabled)
+    {
+        EXPECT_EQ(20u, totals.calls[scoring]);
+        EXPECT_EQ(40u, totals.counters[points]);
+    }
+    else
+    {
+        EXPECT_TRUE(totals.empty());
+    }
+    prof::reset();
+}
+
+}  // namespace
@@ -0,0 +1,99 @@
+#include "regression.h"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+constexpr auto list = R"(# test 1
+
+name=first
+sgf=(;FF[4]GM[40]SZ[9];B[ee];W[de])
+move=ef 10
+# as well as other moves
+move=df 4
+time=500
+end
+
+name=no moves
+sgf=(;FF[4]GM[40]SZ[9])
+end
+
+name=second
+sgf=(;FF[4]GM[40]SZ[9];B[ee])
+move=dd 1
+move=xx
+else=2
+end
+)";
+
+TEST(Regression, listIsParsedAndIncompleteTestsAreSkipped)
+{
+    std::istringstream is(list);
+    std::ostringstream warnings;
+    const auto tests = regression::parseList(is, warnings);
+    ASSERT_EQ(2u, tests.size());
+    EXPECT_EQ("first", tests[0].name);
+    EXPECT_EQ("(;FF[4]GM[40]SZ[9];B[ee];W[de])", tests[0].sgf);
+    EXPECT_EQ(500, tests[0].msec);
+    ASSERT_EQ(2u, tests[0].moves.size());
+    EXPECT_EQ("df", tests[0].moves[1].first);
+    EXPECT_DOUBLE_EQ(4.0, tests[0].moves[1].second);
+    EXPECT_DOUBLE_EQ(0.0, tests[0].default_score);
+
+    EXPECT_EQ("second", tests[1].name);
+    EXPECT_EQ(regression::default_msec, tests[1].msec);
+    EXPECT_EQ(1u, tests[1].moves.size());
+    EXPECT_DOUBLE_EQ(2.0, tests[1].default_score);
+
+    const auto w = warnings.str();
+    EXPECT_NE(std::string::npos, w.find("noncomplete test ending in line 13"));
+    EXPECT_NE(std::string::npos, w.find("invalid line 18: move=xx"));
+}
+
+TEST(Regression, scoreOfMove)
+{
+    regression::Test test;
+    test.moves = {{"ef", 10.0}, {"df.ceddecfdgce", 3.0}};
+    test.default_score = 1.0;
+    EXPECT_DOUBLE_EQ(10.0, test.scoreOf("ef"));
+    EXPECT_DOUBLE_EQ(10.0, test.scoreOf("ef.deeffeedde"));
+    EXPECT_DOUBLE_EQ(3.0, test.scoreOf("df.ceddecfdgce"));
+    EXPECT_DOUBLE_EQ(1.0, test.scoreOf("df"));
+    EXPECT_DOUBLE_EQ(1.0, test.scoreOf(""));
+}
+
+TEST(Regression, runsAreScoredAndReported)
+{
+    regression::Result result;
+    result.test.name = "first";
+    result.test.sgf = "(;FF[4]GM[40]SZ[9];B[ee];W[de])";
+    result.test.msec = 100;
+    const regression::Limits limits{.threads = 2, .iter_count = 100};
+    for (uint64_t seed : {5, 6})
+    {
+        result.runs.push_back(regression::runOnce(result.test, limits, seed));
+        const auto &run = result.runs.back();
+        EXPECT_EQ(seed, run.seed);
+        EXPECT_EQ(2u, run.move.size());
+        EXPECT_GE(run.iterations, 100);
+    }
+    result.test.moves = {{result.runs[0].move, 10.0}};
+    result.runs[0].score = 10.0;
+    result.runs[1].score = result.test.scoreOf(result.runs[1].move);
+    EXPECT_DOUBLE_EQ(result.runs[1].score + 10.0, result.total());
+    EXPECT_DOUBLE_EQ(result.total() / 2, result.mean());
+
+    const auto json = regression::toJson(result);
+    EXPECT_TRUE(json.starts_with(
+        "{\"name\": \"first\", \"msec\": 100, \"repeats\": 2, "))
+        << json;
+    EXPECT_NE(std::string::npos,
+              json.find("\"" + result.runs[0].move + "\": {\"score\": 10.0"));
+    EXPECT_NE(std::string::npos, json.find("\"seed\": 6, \"move\": "));
+}
+
+}  // namespace
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "report.h"
+
+namespace
+{
+
+std::vector<std::string> readLines(const std::filesystem::path &path)
+{
+    std::ifstream file(path);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);) lines.push_back(line);
+    return lines;
+}
+
+TEST(Report, quotedEscapesSpecialCharacters)
+{
+    EXPECT_EQ("\"(;FF[4])\"", report::quoted("(;FF[4])"));
+    EXPECT_EQ("\"a\\\"b\\\\c\\nd\\u0001\"", report::quoted("a\"b\\c\nd\x01"));
+}
+
+TEST(Report, jsonObjectWithAllKindsOfValues)
+{
+    report::JsonObject inner;
+    inner.add("x", 1);
+    report::JsonObject obj;
+    obj.add("s", "text")
+        .add("b", true)
+        .add("i", -3)
+        .add("f", 0.5)
+        .add("nan", NAN)
+        .add("v", std::vector<std::string>{"cd", "ef"})
+        .addRaw("o", inner.str());
+    EXPECT_EQ(
+        "{\"s\": \"text\", \"b\": true, \"i\": -3, \"f\": 0.500000, "
+        "\"nan\": null, \"v\": [\"cd\", \"ef\"], \"o\": {\"x\": 1}}",
+        obj.str());
+    EXPECT_EQ("{}", report::JsonObject().str());
+}
+
+TEST(Report, fileIsRotatedWhenFull)
+{
+    namespace fs = std::filesystem;
+    const auto dir = fs::temp_directory_path() / "kropla-report-test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const auto path = dir / "report.ndjson";
+
+    report::write("before open");  // ignored
+    report::open(path.string(), 100, 2);
+    ASSERT_TRUE(report::isOpen());
+    const std::string line(39, 'x');  // 40 bytes with the newline
+    for (int i = 0; i < 7; ++i) report::write(std::to_string(i) + line);
+    report::flush();
+
+    // 2 lines fit in 100 bytes; the oldest file is removed
+    EXPECT_EQ(std::vector<std::string>{"6" + line}, readLines(path));
+    EXPECT_EQ((std::vector<std::string>{"4" + line, "5" + line}),
+              readLines(dir / "report.ndjson.1"));
+    EXPECT_EQ((std::vector<std::string>{"2" + line, "3" + line}),
+              readLines(dir / "report.ndjson.2"));
+    EXPECT_FALSE(fs::exists(dir / "report.ndjson.3"));
+    fs::remove_all(dir);
+}
+
+}  // namespace
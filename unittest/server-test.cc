@@ -0,0 +1,170 @@
+#include "server.h"
+
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include "game.h"
+#include "montecarlo.h"
+
+namespace
+{
+
+class Server : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        path = (std::filesystem::temp_directory_path() /
+                ("kropla-server-test-" + std::to_string(getpid())))
+                   .string();
+        server = std::make_unique<GameServer>(path, 2, 200, 0, kept_nodes);
+        thread = std::thread([this] { server->run(); });
+    }
+    void TearDown() override
+    {
+        server->stop();
+        thread.join();
+        server.reset();
+        EXPECT_FALSE(std::filesystem::exists(path));
+    }
+
+    int connectClient() const
+    {
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strcpy(addr.sun_path, path.c_str());
+        EXPECT_EQ(0, connect(fd, reinterpret_cast<const sockaddr *>(&addr),
+                             sizeof(addr)));
+        return fd;
+    }
+
+    // sends the command and returns the response, up to the empty line
+    static std::string request(int fd, const std::string &command)
+    {
+        const std::string line = command + "\n";
+        EXPECT_EQ(static_cast<ssize_t>(line.size()),
+                  write(fd, line.data(), line.size()));
+        std::string response;
+        char c;
+        while (response.size() < 2 or
+               response.compare(response.size() - 2, 2, "\n\n") != 0)
+        {
+            if (read(fd, &c, 1) != 1) break;
+            response += c;
+        }
+        return response;
+    }
+
+    // whether a response can be read from fd without waiting
+    static bool hasResponse(int fd)
+    {
+        pollfd pfd{fd, POLLIN, 0};
+        return poll(&pfd, 1, 0) == 1;
+    }
+
+    std::size_t kept_nodes{GameServer::max_kept_nodes};
+    std::string path;
+    std::unique_ptr<GameServer> server;
+    std::thread thread;
+};
+
+TEST_F(Server, eachConnectionIsASeparateGame)
+{
+    const int a = connectClient();
+    const int b = connectClient();
+    EXPECT_EQ("= \n\n", request(a, "boardsize 9"));
+    EXPECT_EQ("= \n\n", request(b, "boardsize 15"));
+    EXPECT_EQ("= \n\n", request(a, "play b ee"));
+    EXPECT_EQ("= \n\n", request(b, "play b oo"));
+    EXPECT_EQ("? invalid move oo\n\n", request(a, "play w oo"));
+    EXPECT_EQ("? illegal move oo\n\n", request(b, "play w oo"));
+    EXPECT_EQ("= \n\n", request(b, "play w ee"));
+    EXPECT_EQ("= \n\n", request(a, "undo"));
+    EXPECT_EQ("? cannot undo\n\n", request(a, "undo"));
+    EXPECT_EQ("= \n\n", request(b, "undo"));
+    EXPECT_EQ("= \n\n", request(b, "quit"));
+    char c;
+    EXPECT_EQ(0, read(b, &c, 1));  // closed by the server
+    close(a);
+    close(b);
+}
+
+TEST_F(Server, searchTreeIsKeptWhileAnotherGameSearches)
+{
+    const int a = connectClient();
+    const int b = connectClient();
+    EXPECT_EQ("= \n\n", request(a, "boardsize 9"));
+    EXPECT_EQ("= \n\n", request(b, "boardsize 11"));
+    EXPECT_EQ("= \n\n", request(a, "play b ee"));
+    EXPECT_EQ("= [", request(a, "analyze 200").substr(0, 3));
+    const int32_t analyzed = montec::root.t.playouts;
+    EXPECT_GT(analyzed, 0);
+    EXPECT_EQ("= \n\n", request(b, "play b ff"));
+    EXPECT_EQ("= ", request(b, "genmove w").substr(0, 2));
+    EXPECT_EQ("= ", request(a, "genmove w").substr(0, 2));
+    EXPECT_GE(montec::root.t.playouts, analyzed + montec::iterations);
+    close(a);
+    close(b);
+}
+
+TEST_F(Server, playDoesNotWaitForTheSearchOfAnotherGame)
+{
+    const int a = connectClient();
+    const int b = connectClient();
+    const int c = connectClient();
+    EXPECT_EQ("= \n\n", request(a, "boardsize 9"));
+    EXPECT_EQ("= \n\n", request(b, "boardsize 9"));
+    EXPECT_EQ("= \n\n", request(c, "boardsize 11"));
+    const std::string analyze = "analyze 3000\n";
+    ASSERT_EQ(static_cast<ssize_t>(analyze.size()),
+              write(a, analyze.data(), analyze.size()));
+    // the same board size as the search
+    EXPECT_EQ("= \n\n", request(b, "play b ee"));
+    EXPECT_EQ("= \n", request(b, "showboard").substr(0, 3));
+    EXPECT_FALSE(hasResponse(a));
+    // another board size: after the search
+    EXPECT_EQ("= \n\n", request(c, "play b ff"));
+    EXPECT_TRUE(hasResponse(a));
+    EXPECT_EQ("= [", request(a, "showboard").substr(0, 3));
+    close(a);
+    close(b);
+    close(c);
+}
+
+class ServerWithSmallTrees : public Server
+{
+   protected:
+    void SetUp() override
+    {
+        kept_nodes = 1;
+        Server::SetUp();
+    }
+};
+
+TEST_F(ServerWithSmallTrees, treesOfOtherGamesAreDroppedBeyondTheLimit)
+{
+    const int a = connectClient();
+    const int b = connectClient();
+    EXPECT_EQ("= \n\n", request(a, "boardsize 9"));
+    EXPECT_EQ("= \n\n", request(b, "boardsize 11"));
+    EXPECT_EQ("= \n\n", request(a, "play b ee"));
+    EXPECT_EQ("= [", request(a, "analyze 200").substr(0, 3));
+    EXPECT_EQ("= \n\n", request(b, "play b ff"));
+    EXPECT_EQ("= ", request(b, "genmove w").substr(0, 2));
+    // the tree of a is gone, so its search starts from scratch
+    EXPECT_EQ("= ", request(a, "genmove w").substr(0, 2));
+    EXPECT_EQ(montec::root.t.playouts, montec::iterations);
+    close(a);
+    close(b);
+}
+
+}  // namespace
@@ -0,0 +1,125 @@
+#include "snapshot.h"
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "game.h"
+#include "utils.h"
+
+namespace
+{
+
+const std::string sgf{
+    "(;SZ[20]PB[kropla_c1db66445b6:7000]PW[kropla:7000];B[kl];W[ki];B[lj];"
+    "W[li];B[mj];W[mi];B[nj]"
+    ";W[ni];B[fk];W[oj];B[ok];W[pk];B[ol];W[pl];B[pm];W[qm];B[pn];W[qn];B["
+    "po];W[pj];B[jk];W[qo]"
+    ";B[pp];W[kj];B[kk];W[qp];B[ij];W[pq];B[oq];W[nq];B[or];W[np];B[op];W["
+    "mr];B[mn];W[no];B[nn]"
+    ";W[hm];B[hl];W[im];B[il];W[gm];B[kn];W[jm];B[km];W[ms];B[qq];W[pr];B["
+    "ps];W[qr];B[rq];W[qs]"
+    ";B[os];W[oo];B[on];W[oh];B[gl];W[fm];B[ql];W[rl];B[qk];W[rk];B[qj];W["
+    "ri];B[qi];W[qh];B[hh])"};
+
+void expectSameGames(const Game &expected, const Game &game)
+{
+    EXPECT_EQ(expected.getZobrist(), game.getZobrist());
+    EXPECT_EQ(expected.getHistory().size(), game.getHistory().size());
+    EXPECT_EQ(expected.whoNowMoves(), game.whoNowMoves());
+    EXPECT_EQ(expected.showString(), game.showString());
+    for (int who = 0; who < 2; ++who)
+    {
+        const auto &thr = expected.threats[who];
+        EXPECT_EQ(thr.threats.size(), game.threats[who].threats.size());
+        EXPECT_EQ(thr.threats2m.size(), game.threats[who].threats2m.size());
+        EXPECT_EQ(thr.is_in_encl, game.threats[who].is_in_encl);
+        EXPECT_EQ(thr.is_in_terr, game.threats[who].is_in_terr);
+        EXPECT_EQ(thr.is_in_border, game.threats[who].is_in_border);
+        EXPECT_EQ(thr.is_in_2m_encl, game.threats[who].is_in_2m_encl);
+        EXPECT_EQ(thr.is_in_2m_miai, game.threats[who].is_in_2m_miai);
+    }
+}
+
+TEST(Snapshot, loadedGameEqualsTheSavedOne)
+{
+    const Game game = constructGameFromSgfWithIsometry(sgf, 0);
+    Game loaded = snapshot::load(snapshot::save(game));
+    expectSameGames(game, loaded);
+    EXPECT_TRUE(loaded.checkWormCorrectness());
+    EXPECT_TRUE(loaded.checkThreatCorrectness());
+    EXPECT_TRUE(loaded.checkThreat2movesCorrectness());
+    EXPECT_TRUE(loaded.checkConnectionsCorrectness());
+    EXPECT_TRUE(loaded.checkSoftSafetyCorrectness());
+    EXPECT_TRUE(loaded.checkPossibleMovesCorrectness());
+    EXPECT_TRUE(loaded.checkPattern3valuesCorrectness());
+}
+
+TEST(Snapshot, gameContinuesTheSameAfterLoading)
+{
+    Game game = constructGameFromSgfWithIsometry(sgf, 0);
+    Game loaded = snapshot::load(snapshot::save(game));
+    for (const auto *move : {"sj", "eh", "pi", "rh"})
+    {
+        const int who = game.whoNowMoves();
+        game.makeSgfMove(move, who);
+        loaded.makeSgfMove(move, who);
+    }
+    expectSameGames(game, loaded);
+    EXPECT_TRUE(loaded.checkThreatCorrectness());
+    EXPECT_TRUE(loaded.checkThreat2movesCorrectness());
+}
+
+TEST(Snapshot, boardSizeAndKomiAreRestored)
+{
+    const Game game = constructGameFromSgfWithIsometry(sgf, 0);
+    global::komi = 4;
+    const auto data = snapshot::save(game);
+    const Game small = constructGameFromSgfWithIsometry(
+        constructSgfFromGameBoard(std::string(9 * 9, '.')), 0);
+    EXPECT_EQ(9, coord.wlkx);
+    EXPECT_EQ(0, global::komi);
+    const Game loaded = snapshot::load(data);
+    EXPECT_EQ(20, coord.wlkx);
+    EXPECT_EQ(20, coord.wlky);
+    EXPECT_EQ(4, global::komi);
+    EXPECT_EQ(game.showString(), loaded.showString());
+    global::komi = 0;
+}
+
+TEST(Snapshot, invalidDataIsRejected)
+{
+    const Game game = constructGameFromSgfWithIsometry(sgf, 0);
+    const auto data = snapshot::save(game);
+    EXPECT_THROW(snapshot::load(""), std::runtime_error);
+    EXPECT_THROW(snapshot::load(data.substr(0, data.size() / 2)),
+                 std::runtime_error);
+    EXPECT_THROW(snapshot::load(data + "x"), std::runtime_error);
+    auto other_magic = data;
+    other_magic[0] = 'X';
+    EXPECT_THROW(snapshot::load(other_magic), std::runtime_error);
+    auto other_version = data;
+    other_version[8] += 1;  // the version follows magic, byte order, pti size
+    EXPECT_THROW(snapshot::load(other_version), std::runtime_error);
+}
+
+TEST(Snapshot, failedLoadKeepsBoardSizeAndKomi)
+{
+    const Game game = constructGameFromSgfWithIsometry(sgf, 0);
+    const auto data = snapshot::save(game);
+    Game small = constructGameFromSgfWithIsometry(
+        constructSgfFromGameBoard(std::string(9 * 9, '.')), 0);
+    small.makeSgfMove("ee", 1);
+    global::komi = 3;
+    EXPECT_THROW(snapshot::load(data.substr(0, data.size() / 2)),
+                 std::runtime_error);
+    EXPECT_EQ(9, coord.wlkx);
+    EXPECT_EQ(9, coord.wlky);
+    EXPECT_EQ(3, global::komi);
+    small.makeSgfMove("ii", 2);
+    EXPECT_EQ(2, small.whoseDotMarginAt(coord.sgfToPti("ii")));
+    global::komi = 0;
+}
+
+}  // namespace
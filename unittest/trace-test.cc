@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "trace.h"
+
+namespace
+{
+
+std::string dump()
+{
+    std::ostringstream os;
+    trace::writeChromeJson(os);
+    return os.str();
+}
+
+int occurrences(const std::string& s, const std::string& what)
+{
+    int n = 0;
+    for (auto pos = s.find(what); pos != std::string::npos;
+         pos = s.find(what, pos + 1))
+        ++n;
+    return n;
+}
+
+TEST(Trace, spansOfThreadsSinceClear)
+{
+    trace::setEnabled(true);
+    {
+        const trace::Span span("before clear");
+    }
+    trace::clear();
+    const auto work = [](int n)
+    {
+        trace::setThreadName("worker " + std::to_string(n));
+        for (int i = 0; i < 3; ++i)
+        {
+            const trace::Span outer("outer");
+            const trace::Span inner("inner");
+        }
+    };
+    std::thread t1(work, 1), t2(work, 2);
+    t1.join();
+    t2.join();
+    trace::setEnabled(false);
+    {
+        const trace::Span span("when off");
+    }
+    const auto json = dump();
+    EXPECT_EQ(0u, json.find("{\"traceEvents\": ["));
+    EXPECT_EQ(6, occurrences(json, "\"name\": \"outer\", \"ph\": \"X\""));
+    EXPECT_EQ(6, occurrences(json, "\"name\": \"inner\", \"ph\": \"X\""));
+    EXPECT_EQ(0, occurrences(json, "before clear"));
+    EXPECT_EQ(0, occurrences(json, "when off"));
+    EXPECT_NE(std::string::npos, json.find("\"overwritten_spans\": 0"));
+    trace::clear();
+}
+
+TEST(Trace, ringKeepsNewestSpans)
+{
+    trace::setEnabled(true);
+    trace::clear();
+    std::thread t(
+        []
+        {
+            for (int i = 0; i < trace::RING_SIZE + 10; ++i)
+                const trace::Span span("span");
+        });
+    t.join();
+    trace::setEnabled(false);
+    const auto json = dump();
+    EXPECT_EQ(trace::RING_SIZE,
+              occurrences(json, "\"name\": \"span\", \"ph\": \"X\""));
+    EXPECT_NE(std::string::npos, json.find("\"overwritten_spans\": 10"));
+    trace::clear();
+}
+
+}  // namespace